@@ -0,0 +1,157 @@
+// Compares the previous NetClient::get_response framing (fixed 1024 byte buffer, leftover substr and
+// one append per byte) with RxBuffer on an in-memory stream of '\0' terminated JSON messages.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "rx_buffer.hpp"
+
+// Stands in for the socket: every recv returns at most segment bytes, like a TCP stream would
+class FakeSocket {
+  public:
+    FakeSocket(const std::string &stream, size_t segment) : stream_(stream), segment_(segment) {
+    }
+
+    ssize_t recv(char *dst, size_t len) {
+        size_t n = std::min({ len, segment_, stream_.size() - pos_ });
+        std::memcpy(dst, stream_.data() + pos_, n);
+        pos_ += n;
+        return static_cast<ssize_t>(n);
+    }
+
+  private:
+    const std::string &stream_;
+    size_t segment_;
+    size_t pos_ = 0;
+};
+
+class LegacyFraming {
+  public:
+    explicit LegacyFraming(FakeSocket &socket) : socket_(socket) {
+    }
+
+    std::string get_response() {
+        if (!leftover_buffer.empty()) {
+            if (std::size_t null_pos; (null_pos = leftover_buffer.find('\0')) != std::string::npos) {
+                std::string prev = leftover_buffer.substr(0, null_pos);
+                leftover_buffer = leftover_buffer.substr(null_pos + 1);
+                return prev;
+            }
+        }
+        std::string response = std::move(leftover_buffer);
+
+        while (true) {
+            ssize_t nread = socket_.recv(buf_, buflen_);
+            if (nread <= 0) {
+                return {};
+            }
+
+            for (ssize_t i = 0; i < nread; ++i) {
+                if (buf_[i] == '\0') {
+                    leftover_buffer.assign(buf_ + i + 1, nread - i - 1);
+                    return response;
+                }
+                response += buf_[i];
+            }
+        }
+    }
+
+  private:
+    FakeSocket &socket_;
+    static constexpr int buflen_ = 1024;
+    char buf_[buflen_];
+    std::string leftover_buffer;
+};
+
+class RxBufferFraming {
+  public:
+    explicit RxBufferFraming(FakeSocket &socket) : socket_(socket) {
+    }
+
+    std::optional<std::string_view> get_frame() {
+        while (true) {
+            if (auto frame = rx_buffer_.next_frame()) {
+                return frame;
+            }
+            char *dst = rx_buffer_.prepare(16 * 1024);
+            ssize_t nread = socket_.recv(dst, rx_buffer_.free_space());
+            if (nread <= 0) {
+                return std::nullopt;
+            }
+            rx_buffer_.commit(nread);
+        }
+    }
+
+  private:
+    FakeSocket &socket_;
+    RxBuffer rx_buffer_{ 64 * 1024 };
+};
+
+std::string make_stream(size_t message_size, size_t messages) {
+    std::string message = "{\"RESULT\":[";
+    while (message.size() < message_size - 2) {
+        message += "{\"axes\":\"XY\",\"pos\":123.456},";
+    }
+    message.resize(message_size - 2);
+    message += "]}";
+
+    std::string stream;
+    stream.reserve((message_size + 1) * messages);
+    for (size_t i = 0; i < messages; i++) {
+        stream += message;
+        stream.push_back('\0');
+    }
+    return stream;
+}
+
+template <typename F> double time_ms(F &&f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+void run(const char *name, size_t message_size, size_t messages, size_t segment) {
+    std::string stream = make_stream(message_size, messages);
+    size_t legacy_bytes = 0;
+    size_t rx_bytes = 0;
+
+    double legacy_ms = time_ms([&] {
+        FakeSocket socket(stream, segment);
+        LegacyFraming framing(socket);
+        for (size_t i = 0; i < messages; i++) {
+            legacy_bytes += framing.get_response().size();
+        }
+    });
+
+    double rx_ms = time_ms([&] {
+        FakeSocket socket(stream, segment);
+        RxBufferFraming framing(socket);
+        for (size_t i = 0; i < messages; i++) {
+            rx_bytes += framing.get_frame()->size();
+        }
+    });
+
+    double mb = static_cast<double>(stream.size()) / (1024 * 1024);
+    std::printf(
+        "%-28s legacy %9.2f ms (%8.1f MB/s)   rx_buffer %9.2f ms (%8.1f MB/s)   x%.1f%s\n",
+        name,
+        legacy_ms,
+        mb / (legacy_ms / 1000),
+        rx_ms,
+        mb / (rx_ms / 1000),
+        legacy_ms / rx_ms,
+        legacy_bytes == rx_bytes ? "" : "  MISMATCH");
+}
+
+int main() {
+    run("small commands (128 B)", 128, 200000, 16 * 1024);
+    run("small commands, 1 per recv", 128, 200000, 129);
+    run("medium replies (4 KiB)", 4 * 1024, 20000, 16 * 1024);
+    run("large replies (256 KiB)", 256 * 1024, 400, 16 * 1024);
+    return 0;
+}
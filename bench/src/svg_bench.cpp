@@ -0,0 +1,259 @@
+// Compares the previous HX::generate_svg (a rapidxml DOM filled with std::to_string numbers, printed through an
+// ostringstream) with the SvgWriter one, on the tubesheets shipped in HXs/ and on a large steam generator made by
+// tiling the biggest of them. Run from the repository root, where HX::hxs_path points.
+
+#include <chrono>
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "HX.hpp"
+#include "rapidxml_ext.hpp"
+
+static inline void append_attributes(
+    rapidxml::xml_document<char> *doc,
+    rapidxml::xml_node<char> *node,
+    std::vector<std::pair<std::string, std::string>> attrs) {
+    if (node) {
+        for (auto attr : attrs) {
+            node->append_attribute(doc->allocate_attribute(
+                doc->allocate_string(attr.first.c_str()), doc->allocate_string(attr.second.c_str())));
+        }
+    }
+}
+
+static inline rapidxml::xml_node<char> *
+add_dashed_line(rapidxml::xml_document<char> *doc, float x1, float y1, float x2, float y2, float font_size) {
+    float stroke_width = font_size / 10;
+    float line = font_size / 2;
+    float space = line / 2;
+
+    auto line_node = doc->allocate_node(rapidxml::node_type::node_element, "line");
+    append_attributes(
+        doc,
+        line_node,
+        {
+            { "x1", std::to_string(x1) },
+            { "y1", std::to_string(y1) },
+            { "x2", std::to_string(x2) },
+            { "y2", std::to_string(y2) },
+            { "stroke", "gray" },
+            { "stroke-width", std::to_string(stroke_width) },
+            { "stroke-dasharray", std::to_string(line) + ", " + std::to_string(space) },
+        });
+
+    return line_node;
+}
+
+static inline rapidxml::xml_node<char> *
+add_label(rapidxml::xml_document<char> *doc, float x, float y, const char *label) {
+    auto label_node = doc->allocate_node(rapidxml::node_type::node_element, "text", doc->allocate_string(label));
+    append_attributes(
+        doc,
+        label_node,
+        {
+            { "x", std::to_string(x) },
+            { "y", std::to_string(y) },
+            { "class", "label" },
+        });
+    return label_node;
+}
+
+static inline rapidxml::xml_node<char> *
+add_tube(rapidxml::xml_document<char> *doc, TubeEntry tube, std::string id, float radius) {
+    auto tube_group_node = doc->allocate_node(rapidxml::node_type::node_element, "g");
+    append_attributes(
+        doc,
+        tube_group_node,
+        { { "id", doc->allocate_string(id.c_str()) }, { "data-col", tube.x_label }, { "data-row", tube.y_label } });
+
+    auto tube_node = doc->allocate_node(rapidxml::node_type::node_element, "circle");
+    append_attributes(
+        doc,
+        tube_node,
+        {
+            { "cx", std::to_string(tube.coords.x) },
+            { "cy", std::to_string(tube.coords.y) },
+            { "r", std::to_string(radius) },
+            { "class", "tube" },
+        });
+
+    auto tooltip_node = doc->allocate_node(rapidxml::node_type::node_element, "title");
+    tooltip_node->value(
+        doc->allocate_string((std::string("Id=") + id + " Col=" + tube.x_label + " Row=" + tube.y_label).c_str()));
+    tube_group_node->append_node(tooltip_node);
+    tube_group_node->append_node(tube_node);
+    auto number_node =
+        doc->allocate_node(rapidxml::node_type::node_element, "text", doc->allocate_string(id.substr(3).c_str()));
+    append_attributes(
+        doc,
+        number_node,
+        {
+            { "class", "tube_num" },
+            { "x", std::to_string(tube.coords.x) },
+            { "y", std::to_string(tube.coords.y) },
+            { "transform-origin", std::to_string(tube.coords.x) + " " + std::to_string(tube.coords.y) },
+            { "transform", "scale(1,-1)" },
+        });
+
+    tube_group_node->append_node(number_node);
+    return tube_group_node;
+}
+
+std::string legacy_generate_svg(const HX &hx) {
+    const auto &svg = hx.svg;
+    float tube_r = hx.tube_od / 2;
+
+    rapidxml::xml_document<char> document;
+    rapidxml::xml_document<char> *doc = &document;
+    auto *svg_node = doc->allocate_node(rapidxml::node_type::node_element, "svg");
+    append_attributes(
+        doc,
+        svg_node,
+        {
+            { "xmlns", "http://www.w3.org/2000/svg" },
+            { "version", "1.1" },
+            { "id", "tubesheet_svg" },
+            { "viewBox",
+              std::to_string(svg.min_x) + " " + std::to_string(svg.min_y) + " " + std::to_string(svg.width) + " " +
+                  std::to_string(svg.height) },
+        });
+
+    auto *style_node = doc->allocate_node(rapidxml::node_type::node_element, "style");
+    append_attributes(doc, style_node, { { "type", "text/css" } });
+
+    float stroke_width = stof(svg.font_size) / 10;
+    std::string style =
+        ".tube {stroke: black; stroke-width: " + std::to_string(stroke_width) + " ; fill: white;} " +
+        ".tube_num { text-anchor: middle; alignment-baseline: middle; font-family: sans-serif; font-size: " +
+        svg.font_size +
+        "px; fill: black;}"
+        ".label { text-anchor: middle; alignment-baseline: middle; font-family: sans-serif; font-size: " +
+        svg.font_size + "; fill: red;}";
+    style_node->value(style.c_str());
+
+    svg_node->append_node(style_node);
+    doc->append_node(svg_node);
+
+    auto *cartesian_g_node = doc->allocate_node(rapidxml::node_type::node_element, "g");
+    append_attributes(doc, cartesian_g_node, { { "id", "cartesian" }, { "transform", "scale(1,-1)" } });
+    svg_node->append_node(cartesian_g_node);
+
+    cartesian_g_node->append_node(add_dashed_line(doc, 0, svg.min_y, 0, svg.min_y + svg.height, stof(svg.font_size)));
+    cartesian_g_node->append_node(add_dashed_line(doc, svg.min_x, 0, svg.min_x + svg.width, 0, stof(svg.font_size)));
+
+    for (const auto &config_coord : svg.config_x_labels_coords) {
+        for (auto [label, coord] : svg.x_labels) {
+            auto *label_x = add_label(doc, coord, std::stof(config_coord), label.c_str());
+            append_attributes(
+                doc,
+                label_x,
+                {
+                    { "transform-origin", std::to_string(coord) + " " + config_coord },
+                    { "transform", "scale(1, -1) rotate(270)" },
+                });
+            cartesian_g_node->append_node(label_x);
+        }
+    }
+
+    for (const auto &config_coord : svg.config_y_labels_coords) {
+        for (auto [label, coord] : svg.y_labels) {
+            auto *label_y = add_label(doc, std::stof(config_coord), coord, label.c_str());
+            append_attributes(
+                doc,
+                label_y,
+                {
+                    { "transform-origin", config_coord + " " + std::to_string(coord) },
+                    { "transform", "scale(1, -1)" },
+                });
+            cartesian_g_node->append_node(label_y);
+        }
+    }
+
+    for (TubeTable::TubeId tube = 0; tube < hx.tubes.size(); tube++) {
+        cartesian_g_node->append_node(add_tube(doc, hx.tubes.entry(tube), hx.tubes.id(tube), tube_r));
+    }
+
+    std::ostringstream stream;
+    stream << document;
+    return stream.str();
+}
+
+// The biggest tubesheet repeated copies times side by side, ids renumbered
+HX make_large(const HX &base, int copies) {
+    HX hx = base;
+    hx.tubes.clear();
+    float step = base.svg.width;
+    size_t n = 0;
+    for (int copy = 0; copy < copies; copy++) {
+        for (TubeTable::TubeId tube = 0; tube < base.tubes.size(); tube++) {
+            Point3D coords = base.tubes.coords(tube);
+            coords.x += copy * step;
+            std::string id = base.tubes.id(tube).substr(0, 3) + std::to_string(++n);
+            hx.tubes.add(id, base.tubes.x_label(tube), base.tubes.y_label(tube), coords);
+        }
+    }
+    hx.svg.width *= copies;
+    return hx;
+}
+
+template <typename F> double time_ms(F &&f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+void run(const std::string &name, HX &hx, int iterations) {
+    size_t legacy_bytes = 0;
+    size_t writer_bytes = 0;
+
+    double legacy_ms = time_ms([&] {
+        for (int i = 0; i < iterations; i++) {
+            legacy_bytes = legacy_generate_svg(hx).size();
+        }
+    });
+
+    double writer_ms = time_ms([&] {
+        for (int i = 0; i < iterations; i++) {
+            hx.generate_svg();
+            writer_bytes = hx.tubesheet_svg.size();
+        }
+    });
+
+    legacy_ms /= iterations;
+    writer_ms /= iterations;
+    std::printf(
+        "%-32s %6zu tubes   rapidxml %8.2f ms (%5zu KiB)   SvgWriter %7.2f ms (%5zu KiB)   x%.1f\n",
+        name.c_str(),
+        hx.tubes.size(),
+        legacy_ms,
+        legacy_bytes / 1024,
+        writer_ms,
+        writer_bytes / 1024,
+        legacy_ms / writer_ms);
+}
+
+int main() {
+    spdlog::set_level(spdlog::level::warn);
+
+    HX largest;
+    for (const auto &name : HX::list()) {
+        HX hx;
+        hx.load_config_from_disk(name);
+        hx.process_csv_from_disk(name);
+        run(name, hx, 20);
+        if (hx.tubes.size() > largest.tubes.size()) {
+            largest = hx;
+        }
+    }
+
+    if (!largest.tubes.empty()) {
+        HX large = make_large(largest, 3);
+        run("steam generator (tiled x3)", large, 20);
+    } else {
+        std::printf("No tubesheets found in %s, run from the repository root\n", HX::hxs_path.c_str());
+    }
+    return 0;
+}
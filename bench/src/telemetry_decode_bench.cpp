@@ -0,0 +1,112 @@
+// Compares the previous telemetry decoding (nlohmann::json::from_msgpack into a DOM, then the NLOHMANN adapters)
+// with msgpack_decode() straight into the structs, on frames like the ones the RTU sends.
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+#include "msgpack_decoder.hpp"
+#include "nlohmann/json.hpp"
+#include "telemetry.hpp"
+
+struct temps {
+    double x, y, z;
+};
+MSGPACK_DEFINE_TYPE_NON_INTRUSIVE(temps, x, y, z)
+
+std::vector<uint8_t> make_frame(int i, bool with_temps) {
+    struct telemetry t {};
+    t.coords = Point3D(100.0 + i * 0.25, -35.5 + i * 0.125, 12.0);
+    t.targets = Point3D(250.0, -35.5, 12.0);
+    t.on_condition.x_y = i % 2;
+    t.limits.probe = i % 3 == 0;
+    t.control_enabled = true;
+    t.stall_control = true;
+    t.brakes_mode = 1;
+
+    nlohmann::json frame;
+    frame["telemetry"] = t;
+    if (with_temps) {
+        frame["temps"] = temps{ 25.5, 26.25, 24.75 };
+    }
+    return nlohmann::json::to_msgpack(frame);
+}
+
+template <typename F> double time_ms(F &&f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+void run(const char *name, size_t frames, bool with_temps) {
+    std::vector<std::vector<uint8_t>> stream;
+    for (size_t i = 0; i < 256; i++) {
+        stream.push_back(make_frame(static_cast<int>(i), with_temps));
+    }
+
+    double dom_sum = 0;
+    double direct_sum = 0;
+
+    double dom_ms = time_ms([&] {
+        for (size_t i = 0; i < frames; i++) {
+            nlohmann::json json = nlohmann::json::from_msgpack(stream[i % stream.size()]);
+            if (json.contains("telemetry")) {
+                struct telemetry t = json["telemetry"];
+                dom_sum += t.coords.x + t.brakes_mode;
+            }
+            if (json.contains("temps")) {
+                struct temps temps = json["temps"];
+                dom_sum += temps.x;
+            }
+        }
+    });
+
+    double direct_ms = time_ms([&] {
+        for (size_t i = 0; i < frames; i++) {
+            const auto &frame = stream[i % stream.size()];
+            MsgpackReader reader(frame.data(), frame.size());
+            struct telemetry t {};
+            struct temps temps {};
+            bool has_telemetry = false;
+            bool has_temps = false;
+            size_t entries = reader.read_map_header();
+            for (size_t e = 0; e < entries; e++) {
+                std::string_view key = reader.read_str();
+                if (key == "telemetry") {
+                    msgpack_decode(reader, t);
+                    has_telemetry = true;
+                } else if (key == "temps") {
+                    msgpack_decode(reader, temps);
+                    has_temps = true;
+                } else {
+                    reader.skip();
+                }
+            }
+            if (has_telemetry) {
+                direct_sum += t.coords.x + t.brakes_mode;
+            }
+            if (has_temps) {
+                direct_sum += temps.x;
+            }
+        }
+    });
+
+    std::printf(
+        "%-26s %zu B/frame   from_msgpack %8.2f ms (%9.0f frames/s)   msgpack_decode %8.2f ms (%9.0f frames/s)   "
+        "x%.1f%s\n",
+        name,
+        stream[0].size(),
+        dom_ms,
+        frames / (dom_ms / 1000),
+        direct_ms,
+        frames / (direct_ms / 1000),
+        dom_ms / direct_ms,
+        dom_sum == direct_sum ? "" : "  MISMATCH");
+}
+
+int main() {
+    run("telemetry", 200000, false);
+    run("telemetry + temps", 200000, true);
+    return 0;
+}
@@ -31,6 +31,13 @@ option(${PROJECT_NAME}_USE_GOOGLE_MOCK "Use the GoogleMock project for extending
 
 option(${PROJECT_NAME}_USE_CATCH2 "Use the Catch2 project for creating unit tests." OFF)
 
+#
+# Benchmarks
+#
+
+option(${PROJECT_NAME}_ENABLE_BENCHMARKS "Build the micro benchmarks (from the `bench` subfolder)." OFF)
+option(${PROJECT_NAME}_BUILD_SIMULATOR "Build the RTU simulator (from the `sim` subfolder)." OFF)
+
 #
 # Static analyzers
 #
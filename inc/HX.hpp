@@ -9,12 +9,16 @@
 #include "nlohmann/json.hpp"
 #include "points.hpp"
 #include "svg.hpp"
-#include "tube_entry.hpp"
+#include "tube_table.hpp"
 
 class HX {
   public:
     static const std::filesystem::path hxs_path;
 
+    // Config, tubes and SVG of an HX directory, from the compiled cache when it is up to date (see hx_cache.hpp)
+    void load_from_disk(std::string hx_name);
+
+    // Tubes and labels from tubesheet.csv, the config must be loaded first (load_config_from_disk)
     void process_csv_from_disk(std::string hx_name);
 
     void process_csv(std::string hx_name, std::istream &stream);
@@ -36,7 +40,7 @@ class HX {
     std::string leg = "both";
     std::string unit = "inch";
     double scale = 1;
-    std::map<std::string, TubeEntry> tubes;
+    TubeTable tubes;
     struct {
         float min_x, width;
         float min_y, height;
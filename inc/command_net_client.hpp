@@ -1,18 +1,213 @@
 #pragma once
 
+#include "io_reactor.hpp"
 #include "net_client.hpp"
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <deque>
+#include <functional>
+#include <future>
 #include <iostream>
+#include <mutex>
 #include <restbed>
 #include <spdlog/spdlog.h>
+#include <stdexcept>
 #include <string>
-#include <thread>
+#include <vector>
 
+#include "tl/expected.hpp"
+
+// Pipelined command channel to the RTU.
+// Every request gets an ID and a deadline and is queued as pending before it is written to the socket.
+// The RTU answers commands in the same order it receives them on the stream, so responses are matched
+// to the oldest pending request. A request that times out keeps its slot in the queue, so a late
+// response is consumed and discarded instead of being delivered to the next request. As a response that
+// never comes would shift every later one onto the wrong request, the link is also closed on a timeout:
+// the pending requests fail and the link supervisor reconnects with an empty queue.
 class CommandNetClient : public NetClient {
   public:
+    using Response = tl::expected<std::string, std::string>;
+    using ResponseCallback = std::function<void(Response)>;
+
+    static constexpr std::chrono::milliseconds DefaultTimeout = std::chrono::milliseconds(5000);
+
     CommandNetClient() {
+        timeout_timer = io_reactor.add_timer([this] { expire_requests(); });
     }
 
     ~CommandNetClient() {
+        close();
+        io_reactor.remove_timer(timeout_timer);
+    }
+
+    int connect(std::string host, int port, int nsec = 0) override {
+        nsec = (nsec == 0 ? ConnectionTimeout : nsec);
+        return NetClient::connect(host, port, nsec);
+    }
+
+    void close() override {
+        NetClient::close();
+        fail_all_pending("Connection to REMA closed");
+    }
+
+    // Sends a request and calls on_response from the I/O reactor thread with the matching response,
+    // or with an error if the request timed out or the connection was lost. Returns the request ID.
+    uint64_t send_command(
+        const std::string &request, ResponseCallback on_response, std::chrono::milliseconds timeout = DefaultTimeout) {
+        uint64_t id;
+        {
+            std::lock_guard<std::mutex> tx_lock(tx_mtx); // Keeps the pending queue in the same order as the wire
+            id = ++last_request_id;
+            {
+                std::lock_guard<std::mutex> lock(pending_mtx);
+                auto deadline = std::chrono::steady_clock::now() + timeout;
+                pending.push_back({ id, deadline, std::move(on_response), false });
+                if (deadline < armed_deadline) {
+                    armed_deadline = deadline;
+                    io_reactor.arm_timer(timeout_timer, timeout);
+                }
+            }
+
+            SPDLOG_DEBUG("Sending request #{} to REMA", id);
+            if (send_request(request)) {
+                return id;
+            }
+        }
+
+        ResponseCallback cb = take_pending(id);
+        if (cb) {
+            cb(tl::make_unexpected("Unable to send command to REMA"));
+        }
+        return id;
+    }
+
+    std::future<std::string> send_command(const std::string &request, std::chrono::milliseconds timeout = DefaultTimeout) {
+        auto promise = std::make_shared<std::promise<std::string>>();
+        std::future<std::string> future = promise->get_future();
+        send_command(
+            request,
+            [promise](Response response) {
+                if (response) {
+                    promise->set_value(std::move(*response));
+                } else {
+                    promise->set_exception(std::make_exception_ptr(std::runtime_error(response.error())));
+                }
+            },
+            timeout);
+        return future;
+    }
+
+    size_t pending_count() {
+        std::lock_guard<std::mutex> lock(pending_mtx);
+        return pending.size();
+    }
+
+    int ConnectionTimeout = 5;
+
+  private:
+    struct PendingRequest {
+        uint64_t id;
+        std::chrono::steady_clock::time_point deadline;
+        ResponseCallback on_response;
+        bool expired;
+    };
+
+    // Runs on the I/O reactor thread, every complete frame answers the oldest pending request
+    void on_data() override {
+        while (auto frame = rx_buffer_.next_frame()) {
+            dispatch_response(std::string(*frame));
+        }
     }
+
+    void dispatch_response(std::string response) {
+        PendingRequest head;
+        {
+            std::lock_guard<std::mutex> lock(pending_mtx);
+            if (pending.empty()) {
+                SPDLOG_WARN("Unsolicited response from REMA discarded: {}", response);
+                return;
+            }
+            head = std::move(pending.front());
+            pending.pop_front();
+        }
+
+        if (head.expired) {
+            SPDLOG_WARN("Late response for request #{} discarded", head.id);
+            return;
+        }
+
+        if (head.on_response) {
+            head.on_response(std::move(response));
+        }
+    }
+
+    // Runs on the I/O reactor thread when the earliest deadline is reached
+    void expire_requests() {
+        std::vector<PendingRequest> expired;
+        {
+            std::lock_guard<std::mutex> lock(pending_mtx);
+            auto now = std::chrono::steady_clock::now();
+            armed_deadline = std::chrono::steady_clock::time_point::max();
+            for (auto &req : pending) {
+                if (req.expired) {
+                    continue;
+                }
+                if (req.deadline <= now) {
+                    req.expired = true;
+                    expired.push_back({ req.id, req.deadline, std::move(req.on_response), true });
+                } else {
+                    armed_deadline = std::min(armed_deadline, req.deadline);
+                }
+            }
+
+            if (armed_deadline != std::chrono::steady_clock::time_point::max()) {
+                io_reactor.arm_timer(timeout_timer, armed_deadline - now);
+            }
+        }
+
+        for (auto &req : expired) {
+            SPDLOG_WARN("Request #{} to REMA timed out", req.id);
+            if (req.on_response) {
+                req.on_response(tl::make_unexpected("Timeout waiting for REMA response"));
+            }
+        }
+
+        if (!expired.empty() && is_connected) {
+            SPDLOG_WARN("Closing the command link to REMA to match responses again");
+            close();
+        }
+    }
+
+    ResponseCallback take_pending(uint64_t id) {
+        std::lock_guard<std::mutex> lock(pending_mtx);
+        auto it = std::find_if(pending.begin(), pending.end(), [id](const PendingRequest &req) { return req.id == id; });
+        if (it == pending.end()) {
+            return {};
+        }
+        ResponseCallback cb = std::move(it->on_response);
+        pending.erase(it);
+        return cb;
+    }
+
+    void fail_all_pending(const std::string &reason) {
+        std::deque<PendingRequest> failed;
+        {
+            std::lock_guard<std::mutex> lock(pending_mtx);
+            failed.swap(pending);
+        }
+
+        for (auto &req : failed) {
+            if (!req.expired && req.on_response) {
+                req.on_response(tl::make_unexpected(reason));
+            }
+        }
+    }
+
+    std::mutex tx_mtx;
+    std::mutex pending_mtx;
+    std::deque<PendingRequest> pending;
+    std::atomic<uint64_t> last_request_id = 0;
+    int timeout_timer = -1;
+    std::chrono::steady_clock::time_point armed_deadline = std::chrono::steady_clock::time_point::max();
 };
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <filesystem>
+
+#include "HX.hpp"
+
+// Compiled form of an HX directory in HXs/{hx}/tubesheet.cache: the tube table, the label sets and the rendered SVG,
+// so loading a session does not parse tubesheet.csv nor build the SVG again. The file records the size and write
+// time of tubesheet.csv and config.json it was made from and is ignored once either changes. It is written in the
+// native byte order, for the machine that wrote it.
+
+// Fills tubes, svg labels and tubesheet_svg from the cache. False when there is no valid cache, hx is left untouched
+// then.
+bool load_hx_cache(HX &hx, const std::filesystem::path &hx_dir);
+
+// Failures are only logged, the HX is compiled again next time
+void store_hx_cache(const HX &hx, const std::filesystem::path &hx_dir);
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// Single epoll based I/O thread shared by every RTU connection.
+// Sockets are registered with a handler that runs on the reactor thread whenever the fd becomes ready.
+// Timers are timerfds driven by the same loop, and post() runs arbitrary work on the reactor thread.
+// Handlers for one fd never run concurrently, so they can use the connection state without locking.
+class IoReactor {
+  public:
+    using Handler = std::function<void(uint32_t events)>;
+    using Task = std::function<void()>;
+
+    IoReactor();
+
+    ~IoReactor();
+
+    IoReactor(const IoReactor &) = delete;
+    IoReactor &operator=(const IoReactor &) = delete;
+
+    void add(int fd, uint32_t events, Handler handler);
+
+    // Unregisters fd. Once this returns on the reactor thread (or the posted removal ran) the handler is never called again
+    void remove(int fd);
+
+    // Removes fd from the reactor and closes it on the reactor thread, so no handler can observe a reused fd number
+    void remove_and_close(int fd);
+
+    int add_timer(Task on_expired);
+
+    void arm_timer(int timer_fd, std::chrono::nanoseconds timeout);
+
+    void disarm_timer(int timer_fd);
+
+    void remove_timer(int timer_fd);
+
+    void post(Task task);
+
+    bool in_reactor_thread() const;
+
+  private:
+    struct Registration {
+        int fd;
+        std::shared_ptr<Handler> handler;
+    };
+
+    void loop(std::stop_token stop_token);
+
+    void wake();
+
+    void run_posted_tasks();
+
+    int epoll_fd = -1;
+    int wakeup_fd = -1;
+    std::mutex mtx;
+    uint64_t last_registration_id = 0;
+    std::map<uint64_t, Registration> registrations; // Keyed by the id stored in epoll_event.data
+    std::map<int, uint64_t> registration_by_fd;
+    std::deque<Task> posted_tasks;
+    std::jthread thd;
+};
+
+inline IoReactor io_reactor;
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "net_client.hpp"
+#include "nlohmann/json.hpp"
+
+enum class LinkState { DISCONNECTED, CONNECTING, CONNECTED };
+
+NLOHMANN_JSON_SERIALIZE_ENUM(
+    LinkState,
+    {
+        { LinkState::DISCONNECTED, "DISCONNECTED" },
+        { LinkState::CONNECTING, "CONNECTING" },
+        { LinkState::CONNECTED, "CONNECTED" },
+    })
+
+// Keeps the RTU links (command, telemetry, logs) connected from a background thread.
+// Links that are down are connected in parallel, each one retrying with exponential backoff,
+// so neither a missing RTU nor a flaky network ever blocks the callers of connect()/reconnect().
+class LinkSupervisor {
+  public:
+    struct Link {
+        std::string name;
+        NetClient *client;
+        int port_offset;                   // Added to the RTU base port
+        std::function<void()> on_connected; // Runs on the supervisor thread after every successful connection
+        LinkState state = LinkState::DISCONNECTED;
+        std::chrono::milliseconds backoff = InitialBackoff;
+        std::chrono::steady_clock::time_point next_attempt;
+    };
+
+    static constexpr std::chrono::milliseconds InitialBackoff = std::chrono::milliseconds(500);
+    static constexpr std::chrono::milliseconds MaxBackoff = std::chrono::seconds(30);
+    static constexpr std::chrono::milliseconds PollInterval = std::chrono::milliseconds(250);
+
+    LinkSupervisor() = default;
+
+    ~LinkSupervisor();
+
+    void add_link(const std::string &name, NetClient *client, int port_offset, std::function<void()> on_connected = nullptr);
+
+    // Sets the RTU address and starts supervising. Returns immediately.
+    void start(const std::string &host, int port);
+
+    // Drops every link and reconnects as soon as possible, without waiting for the backoff
+    void reconnect_all();
+
+    nlohmann::json links_state();
+
+    // True once after any link changed state, used to publish the change over SSE
+    bool take_state_changed();
+
+  private:
+    void loop(std::stop_token stop_token);
+
+    void set_state(Link &link, LinkState state);
+
+    std::mutex mtx;
+    std::condition_variable_any cv;
+    std::vector<Link> links;
+    std::string host_;
+    int port_ = 0;
+    bool wake_up = false;
+    std::atomic<bool> state_changed = false;
+    std::jthread thd;
+};
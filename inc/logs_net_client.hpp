@@ -2,13 +2,10 @@
 
 #include "net_client.hpp"
 #include <chrono>
-#include <condition_variable>
 #include <iostream>
 #include <memory>
 #include <spdlog/spdlog.h>
 #include <string>
-#include <thread>
-#include <watchdog_timer.hpp>
 
 class LogsNetClient : public NetClient {
   public:
@@ -18,13 +15,6 @@ class LogsNetClient : public NetClient {
         onReceiveCb = onReceiveCallback;
     }
 
-    void start() {
-        if (!alreadyStarted) {
-            thd = std::jthread(&LogsNetClient::loop, this);
-            alreadyStarted = true;
-        }
-    }
-
     int connect(std::string host, int port, int nsec = 0) override {
         nsec = (nsec == 0 ? ConnectionTimeout : nsec);
         if (int n; (n = NetClient::connect(host, port, nsec)) < 0) {
@@ -33,19 +23,16 @@ class LogsNetClient : public NetClient {
         return 0;
     }
 
-    void loop(std::stop_token stop_token) {
-        while (!stop_token.stop_requested()) {
-            if (is_connected) {
-                std::string line = get_response();
-                if (!line.empty()) {
-                    onReceiveCb(line);
-                }
+    // Runs on the I/O reactor thread, one callback per '\0' terminated log line
+    void on_data() override {
+        while (auto frame = rx_buffer_.next_frame()) {
+            std::string line(*frame);
+            if (!line.empty() && onReceiveCb) {
+                onReceiveCb(line);
             }
         }
     }
 
     std::function<void(std::string&)> onReceiveCb;
-    std::jthread thd;
-    bool alreadyStarted = false;
     int ConnectionTimeout = 5;
 };
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "nlohmann/json.hpp"
+#include "tl/expected.hpp"
+
+enum class MotionJobState { QUEUED, RUNNING, SUCCEEDED, FAILED, CANCELLED };
+
+NLOHMANN_JSON_SERIALIZE_ENUM(
+    MotionJobState,
+    {
+        { MotionJobState::QUEUED, "QUEUED" },
+        { MotionJobState::RUNNING, "RUNNING" },
+        { MotionJobState::SUCCEEDED, "SUCCEEDED" },
+        { MotionJobState::FAILED, "FAILED" },
+        { MotionJobState::CANCELLED, "CANCELLED" },
+    })
+
+// Runs motion sequences (tube center and tubesheet determination, go to tube...) on a worker thread of its own,
+// so the HTTP request that starts one returns a job ID right away instead of holding a restbed worker until the
+// axes stop. Every change of a job (state, step progress, result or error) is queued as an event for /sse.
+// There is only one set of axes: starting a job cancels the one in progress, like a new sequence always did.
+class MotionJobs {
+  public:
+    // Handed to the job body to report progress and to learn that the job was cancelled
+    class Context {
+      public:
+        bool cancelled() const {
+            return cancel_requested.load();
+        }
+
+        void progress(const nlohmann::json &progress);
+
+      private:
+        friend class MotionJobs;
+        Context(MotionJobs &jobs_, uint64_t id_) : jobs(jobs_), id(id_) {
+        }
+
+        MotionJobs &jobs;
+        uint64_t id;
+        std::atomic<bool> cancel_requested = false;
+    };
+
+    using Body = std::function<tl::expected<nlohmann::json, std::string>(Context &)>;
+
+    static constexpr size_t MaxFinishedJobs = 32; // Finished jobs kept for GET jobs/{id}
+    static constexpr size_t MaxPendingEvents = 256;
+
+    MotionJobs() = default;
+
+    ~MotionJobs();
+
+    // Called from cancel() while a job runs, to stop the axes (REMA::cancel_sequence_in_progress)
+    void set_cancel_running_callback(std::function<void()> callback);
+
+    // Queues the job and returns its ID. The job in progress, if any, is cancelled.
+    uint64_t submit(const std::string &name, const nlohmann::json &params, Body body);
+
+    std::optional<nlohmann::json> get(uint64_t id);
+
+    nlohmann::json list();
+
+    // False if the job does not exist or has already finished
+    bool cancel(uint64_t id);
+
+    // Job updates since the last call, oldest first, for /sse
+    nlohmann::json take_events();
+
+  private:
+    struct Job {
+        uint64_t id;
+        std::string name;
+        nlohmann::json params;
+        Body body;
+        MotionJobState state = MotionJobState::QUEUED;
+        nlohmann::json progress;
+        nlohmann::json result;
+        std::string error;
+        std::unique_ptr<Context> context;
+    };
+
+    void loop(std::stop_token stop_token);
+
+    bool cancel_locked(Job &job, const std::string &reason);
+
+    void finish_locked(Job &job, MotionJobState state);
+
+    void publish_locked(const Job &job);
+
+    Job *find_locked(uint64_t id);
+
+    static nlohmann::json to_json(const Job &job);
+
+    std::mutex mtx;
+    std::condition_variable_any cv;
+    std::list<Job> jobs; // Oldest first: finished, then running, then queued
+    std::deque<Job *> queue;
+    std::vector<nlohmann::json> events;
+    std::function<void()> cancel_running;
+    uint64_t last_id = 0;
+    std::jthread thd;
+};
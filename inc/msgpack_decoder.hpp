@@ -0,0 +1,317 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+#include <string_view>
+
+#include "nlohmann/json.hpp"
+
+// Thrown when the input ends in the middle of a value, i.e. the rest of a frame has not been received yet
+class MsgpackIncompleteError : public std::runtime_error {
+  public:
+    MsgpackIncompleteError() : std::runtime_error("msgpack: unexpected end of input") {
+    }
+};
+
+// Streaming msgpack reader that decodes straight into C++ values, with no DOM and no allocations.
+// Malformed input throws std::runtime_error, like nlohmann::json::from_msgpack does, and truncated input
+// throws MsgpackIncompleteError.
+class MsgpackReader {
+  public:
+    MsgpackReader(const uint8_t *data, size_t size) : data_(data), end_(data + size) {
+    }
+
+    size_t read_map_header() {
+        uint8_t type = next();
+        if ((type & 0xf0) == 0x80) {
+            return type & 0x0f;
+        }
+        switch (type) {
+        case 0xde:
+            return read_be<uint16_t>();
+        case 0xdf:
+            return read_be<uint32_t>();
+        default:
+            throw std::runtime_error("msgpack: map expected");
+        }
+    }
+
+    // The view points into the input buffer
+    std::string_view read_str() {
+        uint8_t type = next();
+        size_t length;
+        if ((type & 0xe0) == 0xa0) {
+            length = type & 0x1f;
+        } else if (type == 0xd9) {
+            length = read_be<uint8_t>();
+        } else if (type == 0xda) {
+            length = read_be<uint16_t>();
+        } else if (type == 0xdb) {
+            length = read_be<uint32_t>();
+        } else {
+            throw std::runtime_error("msgpack: string expected");
+        }
+        const uint8_t *str = take(length);
+        return std::string_view(reinterpret_cast<const char *>(str), length);
+    }
+
+    bool read_bool() {
+        uint8_t type = next();
+        if (type == 0xc2 || type == 0xc3) {
+            return type == 0xc3;
+        }
+        throw std::runtime_error("msgpack: bool expected");
+    }
+
+    // Integers and floats are accepted for any numeric field, whatever width the sender chose
+    double read_number() {
+        uint8_t type = peek();
+        if (type == 0xca) {
+            data_++;
+            return std::bit_cast<float>(read_be<uint32_t>());
+        }
+        if (type == 0xcb) {
+            data_++;
+            return std::bit_cast<double>(read_be<uint64_t>());
+        }
+        return static_cast<double>(read_integer());
+    }
+
+    int64_t read_integer() {
+        uint8_t type = next();
+        if (type <= 0x7f) {
+            return type;
+        }
+        if (type >= 0xe0) {
+            return static_cast<int8_t>(type);
+        }
+        switch (type) {
+        case 0xcc:
+            return read_be<uint8_t>();
+        case 0xcd:
+            return read_be<uint16_t>();
+        case 0xce:
+            return read_be<uint32_t>();
+        case 0xcf:
+            return static_cast<int64_t>(read_be<uint64_t>());
+        case 0xd0:
+            return static_cast<int8_t>(read_be<uint8_t>());
+        case 0xd1:
+            return static_cast<int16_t>(read_be<uint16_t>());
+        case 0xd2:
+            return static_cast<int32_t>(read_be<uint32_t>());
+        case 0xd3:
+            return static_cast<int64_t>(read_be<uint64_t>());
+        default:
+            throw std::runtime_error("msgpack: number expected");
+        }
+    }
+
+    // Skips one complete value, whatever its type
+    void skip() {
+        uint8_t type = next();
+        if (type <= 0x7f || type >= 0xe0 || type == 0xc0 || type == 0xc2 || type == 0xc3) {
+            return;
+        }
+        if ((type & 0xe0) == 0xa0) {
+            take(type & 0x1f);
+            return;
+        }
+        if ((type & 0xf0) == 0x80) {
+            skip_values(2 * static_cast<size_t>(type & 0x0f));
+            return;
+        }
+        if ((type & 0xf0) == 0x90) {
+            skip_values(type & 0x0f);
+            return;
+        }
+
+        switch (type) {
+        case 0xcc:
+        case 0xd0:
+            take(1);
+            return;
+        case 0xcd:
+        case 0xd1:
+            take(2);
+            return;
+        case 0xca:
+        case 0xce:
+        case 0xd2:
+            take(4);
+            return;
+        case 0xcb:
+        case 0xcf:
+        case 0xd3:
+            take(8);
+            return;
+        case 0xc4:
+        case 0xd9:
+            take(read_be<uint8_t>());
+            return;
+        case 0xc5:
+        case 0xda:
+            take(read_be<uint16_t>());
+            return;
+        case 0xc6:
+        case 0xdb:
+            take(read_be<uint32_t>());
+            return;
+        case 0xd4: // fixext 1, 2, 4, 8, 16: type byte + data
+            take(2);
+            return;
+        case 0xd5:
+            take(3);
+            return;
+        case 0xd6:
+            take(5);
+            return;
+        case 0xd7:
+            take(9);
+            return;
+        case 0xd8:
+            take(17);
+            return;
+        case 0xc7:
+            take(1 + static_cast<size_t>(read_be<uint8_t>()));
+            return;
+        case 0xc8:
+            take(1 + static_cast<size_t>(read_be<uint16_t>()));
+            return;
+        case 0xc9:
+            take(1 + static_cast<size_t>(read_be<uint32_t>()));
+            return;
+        case 0xdc:
+            skip_values(read_be<uint16_t>());
+            return;
+        case 0xdd:
+            skip_values(read_be<uint32_t>());
+            return;
+        case 0xde:
+            skip_values(2 * static_cast<size_t>(read_be<uint16_t>()));
+            return;
+        case 0xdf:
+            skip_values(2 * static_cast<size_t>(read_be<uint32_t>()));
+            return;
+        default:
+            throw std::runtime_error("msgpack: invalid type");
+        }
+    }
+
+    static bool is_map_header(uint8_t type) {
+        return (type & 0xf0) == 0x80 || type == 0xde || type == 0xdf;
+    }
+
+    bool is_nil() const {
+        return data_ < end_ && *data_ == 0xc0;
+    }
+
+    size_t remaining() const {
+        return static_cast<size_t>(end_ - data_);
+    }
+
+  private:
+    uint8_t peek() const {
+        if (data_ >= end_) {
+            throw MsgpackIncompleteError();
+        }
+        return *data_;
+    }
+
+    uint8_t next() {
+        uint8_t byte = peek();
+        data_++;
+        return byte;
+    }
+
+    const uint8_t *take(size_t n) {
+        if (remaining() < n) {
+            throw MsgpackIncompleteError();
+        }
+        const uint8_t *start = data_;
+        data_ += n;
+        return start;
+    }
+
+    template <typename T> T read_be() {
+        T value;
+        std::memcpy(&value, take(sizeof(T)), sizeof(T));
+        if constexpr (std::endian::native == std::endian::little && sizeof(T) > 1) {
+            value = byteswap(value);
+        }
+        return value;
+    }
+
+    template <typename T> static T byteswap(T value) {
+        if constexpr (sizeof(T) == 2) {
+            return static_cast<T>(__builtin_bswap16(value));
+        } else if constexpr (sizeof(T) == 4) {
+            return static_cast<T>(__builtin_bswap32(value));
+        } else {
+            return static_cast<T>(__builtin_bswap64(value));
+        }
+    }
+
+    void skip_values(size_t n) {
+        for (size_t i = 0; i < n; i++) {
+            skip();
+        }
+    }
+
+    const uint8_t *data_;
+    const uint8_t *end_;
+};
+
+inline void msgpack_decode(MsgpackReader &reader, bool &value) {
+    value = reader.read_bool();
+}
+
+inline void msgpack_decode(MsgpackReader &reader, int &value) {
+    value = static_cast<int>(reader.read_integer());
+}
+
+inline void msgpack_decode(MsgpackReader &reader, double &value) {
+    value = reader.read_number();
+}
+
+#define MSGPACK_DECODE_FIELD(field)                                                                                    \
+    if (key == #field) {                                                                                               \
+        msgpack_decode(reader, value.field);                                                                           \
+        decoded |= field_bit;                                                                                          \
+        continue;                                                                                                      \
+    }                                                                                                                  \
+    field_bit <<= 1;
+
+#define MSGPACK_FIELD_NAME(field) #field,
+
+// Defines msgpack_decode() for a struct encoded as a map of its fields, the same layout the NLOHMANN macros use.
+// Every field is required, like NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE's from_json: a field missing from the map or
+// sent as nil throws std::runtime_error. Unknown keys are skipped.
+#define MSGPACK_DEFINE_DECODER(Type, ...)                                                                              \
+    inline void msgpack_decode(MsgpackReader &reader, Type &value) {                                                   \
+        static constexpr const char *field_names[] = { NLOHMANN_JSON_EXPAND(                                           \
+            NLOHMANN_JSON_PASTE(MSGPACK_FIELD_NAME, __VA_ARGS__)) };                                                   \
+        static_assert(std::size(field_names) < 64);                                                                    \
+        constexpr uint64_t all_fields = (uint64_t(1) << std::size(field_names)) - 1;                                   \
+        uint64_t decoded = 0;                                                                                          \
+        size_t fields = reader.read_map_header();                                                                      \
+        for (size_t i = 0; i < fields; i++) {                                                                          \
+            std::string_view key = reader.read_str();                                                                  \
+            if (!reader.is_nil()) {                                                                                    \
+                uint64_t field_bit = 1;                                                                                \
+                NLOHMANN_JSON_EXPAND(NLOHMANN_JSON_PASTE(MSGPACK_DECODE_FIELD, __VA_ARGS__))                           \
+            }                                                                                                          \
+            reader.skip();                                                                                             \
+        }                                                                                                              \
+        if (decoded != all_fields) {                                                                                   \
+            throw std::runtime_error("msgpack: " #Type " field missing");                                              \
+        }                                                                                                              \
+    }
+
+// NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE plus the msgpack decoder, from a single list of fields
+#define MSGPACK_DEFINE_TYPE_NON_INTRUSIVE(Type, ...)                                                                   \
+    NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(Type, __VA_ARGS__)                                                              \
+    MSGPACK_DEFINE_DECODER(Type, __VA_ARGS__)
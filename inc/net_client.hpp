@@ -2,6 +2,7 @@
 
 #include <errno.h>
 #include <netdb.h>
+#include <netinet/in.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -9,9 +10,18 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <atomic>
+#include <mutex>
 #include <fstream>
 #include <iostream>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <vector>
+
+#include "nlohmann/json.hpp"
+#include "rx_buffer.hpp"
+#include "socket_options.hpp"
 
 class NetClient {
   public:
@@ -24,11 +34,15 @@ class NetClient {
 
     virtual void reconnect();
 
+    // False when the request could not be written. The connection is then closed as lost, so its fd leaves the
+    // reactor and the link supervisor reconnects.
     bool send_request(std::string);
 
-    std::string get_response();
-    
-    std::vector<uint8_t> get_response_binary();
+    // Called on the I/O reactor thread after new bytes were appended to rx_buffer_
+    virtual void on_data() {
+    }
+
+    virtual void on_connection_lost();
 
     int get_port() {
         return port_;
@@ -38,13 +52,33 @@ class NetClient {
         return host_;
     }
 
+    // Used from the next connection on
+    void set_socket_options(const SocketOptions &options);
+
+    // Options as read back from the current socket, empty when not connected
+    nlohmann::json get_effective_socket_options();
+
+    static bool resolve(const std::string &host, in_addr &addr);
+
     volatile bool is_connected = false;
 
+  protected:
+    RxBuffer rx_buffer_{ 64 * 1024 };
+
   private:
+    void apply_socket_options(int fd);
+
+    nlohmann::json read_socket_options(int fd);
+
+    void on_socket_event(uint32_t events);
+
+    bool receive();
+
     std::string host_;
     int port_;
-    volatile int socket_;
-    int buflen_ = 1024;
-    char* buf_ = new char[buflen_];
-    std::string leftover_buffer; // Buffer for data after '\0'
+    std::atomic<int> socket_ = -1;
+    std::mutex options_mtx;
+    SocketOptions socket_options_;
+    nlohmann::json effective_socket_options_;
+    static constexpr size_t MinRecvSize = 16 * 1024;
 };
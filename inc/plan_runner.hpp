@@ -0,0 +1,88 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+
+#include "motion_jobs.hpp"
+#include "nlohmann/json.hpp"
+#include "tl/expected.hpp"
+
+class Session;
+
+enum class PlanRunnerState { IDLE, MOVING, INSPECTING, PAUSED };
+
+NLOHMANN_JSON_SERIALIZE_ENUM(
+    PlanRunnerState,
+    {
+        { PlanRunnerState::IDLE, "IDLE" },
+        { PlanRunnerState::MOVING, "MOVING" },
+        { PlanRunnerState::INSPECTING, "INSPECTING" },
+        { PlanRunnerState::PAUSED, "PAUSED" },
+    })
+
+struct PlanRunOptions {
+    int dwell_ms = 0;             // Time spent on every tube once the axes stop
+    bool wait_trigger = false;    // Stay on every tube until inspection_done() instead of dwelling
+    bool skip_executed = true;    // Tubes already marked executed are not visited again
+};
+NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE_WITH_DEFAULT(PlanRunOptions, dwell_ms, wait_trigger, skip_executed)
+
+// Walks a plan of the current session in SEQ order as a motion job: moves to every tube, waits there for the dwell
+// time or the "inspection done" trigger, marks the tube executed and goes on with the next one right away.
+// Pause holds the runner before its next move and stops the dwell clock on the current tube, skip abandons the
+// current tube (its move or its inspection) without marking it. Tubes of the plan missing from the HX are skipped
+// without moving. The run fails before its next tube once another session is activated. Cancel the job to stop the
+// run.
+class PlanRunner {
+  public:
+    static constexpr std::chrono::milliseconds PollInterval = std::chrono::milliseconds(100);
+
+    // Body of the run_plan job
+    tl::expected<nlohmann::json, std::string> run(
+        MotionJobs::Context &job, const std::string &plan, const PlanRunOptions &options);
+
+    void pause();
+
+    void resume();
+
+    void skip();
+
+    void inspection_done();
+
+    nlohmann::json status();
+
+  private:
+    struct Status {
+        PlanRunnerState state = PlanRunnerState::IDLE;
+        std::string plan;
+        std::string tube_id;
+        size_t index = 0;
+        size_t total = 0;
+        size_t executed = 0;
+        size_t skipped = 0;
+    };
+
+    enum class Outcome { DONE, SKIPPED, CANCELLED };
+
+    tl::expected<Outcome, std::string> visit(
+        MotionJobs::Context &job, Session &session, const std::string &tube_id, const PlanRunOptions &options);
+
+    Outcome wait_on_tube(MotionJobs::Context &job, const PlanRunOptions &options);
+
+    bool wait_while_paused(MotionJobs::Context &job);
+
+    void set_state(MotionJobs::Context &job, PlanRunnerState state);
+
+    nlohmann::json status_locked() const;
+
+    std::mutex mtx;
+    std::condition_variable cv;
+    Status status_;
+    bool paused = false;
+    bool skip_requested = false;
+    bool inspection_done_ = false;
+};
+
+inline PlanRunner plan_runner;
@@ -1,15 +1,25 @@
 #pragma once
 
+#include <chrono>
+#include <condition_variable>
 #include <filesystem>
+#include <functional>
+#include <future>
 #include <mutex>
+#include <optional>
+#include <span>
 #include <string>
 
 #include "command_net_client.hpp"
+#include "link_supervisor.hpp"
+#include "motion_jobs.hpp"
 #include "nlohmann/json.hpp"
 #include "telemetry_net_client.hpp"
 #include "logs_net_client.hpp"
+#include "msgpack_decoder.hpp"
 #include "tl/expected.hpp"
 #include "points.hpp"
+#include "seqlock.hpp"
 #include "session.hpp"
 #include "tool.hpp"
 #include "telemetry.hpp"
@@ -23,7 +33,31 @@ inline const std::filesystem::path logs_dir = "logs";
 struct temps {
     double x, y, z;
 };
-NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(temps, x, y, z)
+MSGPACK_DEFINE_TYPE_NON_INTRUSIVE(temps, x, y, z)
+
+// Latest telemetry frame, published as a whole to every reader. sequence counts the frames received, so a reader
+// can tell whether a new sample arrived since its last look (0 means nothing was received yet).
+struct TelemetrySnapshot {
+    uint64_t sequence = 0;
+    struct telemetry telemetry {};
+    struct telemetry ui_telemetry {}; // The same frame in UI coordinates, for the tool selected when it arrived
+};
+
+struct TempsSnapshot {
+    uint64_t sequence = 0;
+    struct temps temps {};
+};
+
+// How execute_step() decides that a move is over, from config.json "REMA" > "motion"
+struct MotionSettings {
+    double settle_velocity = 0.05; // Below this speed (RTU units per second) the axes are considered still
+    int settle_frames = 2;         // Consecutive telemetry frames below settle_velocity
+    int settle_timeout_ms = 1000;  // Upper bound for settling, the step completes anyway
+    int ack_timeout_ms = 1000;     // If telemetry never shows the stop flags cleared, watch them anyway after this
+    int telemetry_timeout_ms = 2000;
+};
+NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE_WITH_DEFAULT(
+    MotionSettings, settle_velocity, settle_frames, settle_timeout_ms, ack_timeout_ms, telemetry_timeout_ms)
 
 struct movement_cmd {
     std::string axes;
@@ -48,7 +82,9 @@ class REMA {
 
     void reconnect();
 
-    void update_telemetry(std::vector<uint8_t>& stream);
+    void apply_socket_options();
+
+    bool update_telemetry(std::span<const uint8_t> stream);
     
     void save_logs(std::string &stream);
     
@@ -70,23 +106,47 @@ class REMA {
 
     nlohmann::json send_startup_commands();
 
+    static nlohmann::json make_command(const std::string &cmd_name, const nlohmann::json &pars);
+
+    static std::string make_command_frame(const std::string &cmd_name, const nlohmann::json &pars);
+
     void execute_command_no_wait(const std::string cmd_name, const nlohmann::json command);
 
+    std::future<std::string> execute_command_async(const std::string cmd_name, const nlohmann::json pars = {});
+
     nlohmann::json execute_command(const std::string cmd_name, const nlohmann::json pars = {});
 
+    nlohmann::json execute_commands(const nlohmann::json &commands);
+
+    static nlohmann::json move_closed_loop_command(const movement_cmd &cmd);
+
     nlohmann::json move_closed_loop(movement_cmd cmd);
 
     void axes_hard_stop_all();
 
     void axes_soft_stop_all();
 
+    nlohmann::json axes_soft_stop_all_and_execute(const std::string cmd_name, const nlohmann::json pars = {});
+
     void cancel_sequence_in_progress();
 
-    tl::expected<void, std::string> execute_step(movement_cmd& step);
+    // Next telemetry frame after after_sequence, empty on timeout
+    std::optional<TelemetrySnapshot> wait_for_telemetry(uint64_t after_sequence, std::chrono::milliseconds timeout);
+
+    // The same for execute_step(), which is also woken up, with nothing new, when the sequence is cancelled
+    std::optional<TelemetrySnapshot> wait_for_step_telemetry(uint64_t after_sequence, std::chrono::milliseconds timeout);
+
+    tl::expected<void, std::string> execute_step(
+        movement_cmd& step, const nlohmann::json &preceding_commands = nlohmann::json::array());
+
+    // Called before every step with the number of steps already executed, and once more after the last one.
+    // Returning false before a step cancels the rest of the sequence.
+    using SequenceObserver = std::function<bool(size_t steps_done)>;
 
-    tl::expected<void, std::string> execute_sequence(movement_cmd& step);
+    tl::expected<void, std::string> execute_sequence(movement_cmd& step, const SequenceObserver &observer = nullptr);
 
-    tl::expected<void, std::string> execute_sequence(std::vector<movement_cmd>& sequence);
+    tl::expected<void, std::string> execute_sequence(
+        std::vector<movement_cmd>& sequence, const SequenceObserver &observer = nullptr);
 
     void set_home_xyz(Point3D coords);
 
@@ -118,23 +178,27 @@ class REMA {
     CommandNetClient command_client;
     TelemetryNetClient telemetry_client;
     LogsNetClient logs_client;
+    LinkSupervisor link_supervisor; // Declared after the clients so it stops before they are destroyed
     volatile bool is_sequence_in_progress;
     volatile bool cancel_sequence;
     nlohmann::json config;
 
-    // Telemetry values
-    std::mutex mtx;
-    struct telemetry telemetry;
-    struct telemetry ui_telemetry;
+    // Telemetry values, written by the I/O reactor thread only
+    Seqlock<TelemetrySnapshot> telemetry_snapshot;
+    Seqlock<TempsSnapshot> temps_snapshot;
+    std::mutex telemetry_wait_mtx;
+    std::condition_variable telemetry_cv; // Notified for every telemetry frame and when a sequence is cancelled
     struct telemetry old_telemetry;
-    struct temps temps;
-    volatile bool new_temps_available;
+    uint64_t telemetry_sequence = 0;
+    uint64_t temps_sequence = 0;
 
     std::vector<std::string> logs_vector;
     std::ofstream logs_ofstream;
     std::string rtu_host_;
     int rtu_port_;
-    std::mutex rtu_mutex;
+    std::chrono::milliseconds command_timeout = CommandNetClient::DefaultTimeout;
+    MotionSettings motion_settings;
+    MotionJobs motion_jobs; // Declared last so its worker stops before anything a job uses is destroyed
 };
 
 inline std::map<std::string, Tool> REMA::tools;
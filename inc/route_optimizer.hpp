@@ -0,0 +1,40 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "nlohmann/json.hpp"
+#include "points.hpp"
+
+// Visiting order of a set of tubes that keeps the XY travel short.
+// NONE builds a route with nearest neighbour and improves it with 2-opt and Or-opt moves, limited to the closest
+// tubes of every tube so 2000+ tube plans take a few milliseconds. ROWS and COLS keep the plan a sequence of sweeps:
+// one row (column) after the other, each one travelled in the opposite direction of the previous one.
+enum class RouteSweep { NONE, ROWS, COLS };
+
+NLOHMANN_JSON_SERIALIZE_ENUM(
+    RouteSweep,
+    {
+        { RouteSweep::NONE, "none" },
+        { RouteSweep::ROWS, "rows" },
+        { RouteSweep::COLS, "cols" },
+    })
+
+struct RouteOptions {
+    RouteSweep sweep = RouteSweep::NONE;
+    std::chrono::milliseconds time_limit = std::chrono::milliseconds(500); // Improvement stops here, if not before
+};
+
+struct RouteStop {
+    Point3D coords;
+    std::string row;
+    std::string col;
+};
+
+// Length of the open path visiting the stops in the given order, in XY
+double route_length(const std::vector<RouteStop> &stops, const std::vector<size_t> &order);
+
+// Returns the indexes of the stops in visiting order. The route starts at the end closest to the first stop, so a
+// plan keeps starting where it used to.
+std::vector<size_t> optimize_route(const std::vector<RouteStop> &stops, const RouteOptions &options = {});
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+// Receive buffer for delimiter framed streams (the RTU ends every JSON message with '\0').
+// recv() writes straight into the free tail of one contiguous buffer and frames are found with memchr,
+// then handed out as string_views into the buffer, so bytes are only copied if the caller keeps a frame.
+// Space consumed at the head is reclaimed by compaction and the buffer doubles when a frame does not fit.
+// A returned frame stays valid until the next call to prepare().
+class RxBuffer {
+  public:
+    explicit RxBuffer(size_t initial_capacity = 4096, char delimiter = '\0')
+        : buf_(initial_capacity), delimiter_(delimiter) {
+    }
+
+    // Writable region of at least min_free bytes at the tail of the buffer
+    char *prepare(size_t min_free) {
+        if (read_pos_ == write_pos_) {
+            read_pos_ = scan_pos_ = write_pos_ = 0; // Everything consumed, start over without moving anything
+        }
+
+        if (free_space() < min_free) {
+            compact();
+            if (free_space() < min_free) {
+                buf_.resize(std::max(buf_.size() * 2, write_pos_ + min_free));
+            }
+        }
+        return buf_.data() + write_pos_;
+    }
+
+    void commit(size_t n) {
+        write_pos_ += n;
+    }
+
+    std::optional<std::string_view> next_frame() {
+        const void *found = std::memchr(buf_.data() + scan_pos_, delimiter_, write_pos_ - scan_pos_);
+        if (!found) {
+            scan_pos_ = write_pos_; // Do not scan the same bytes again on the next recv
+            return std::nullopt;
+        }
+
+        size_t end = static_cast<const char *>(found) - buf_.data();
+        std::string_view frame(buf_.data() + read_pos_, end - read_pos_);
+        read_pos_ = scan_pos_ = end + 1;
+        return frame;
+    }
+
+    // Every received byte not consumed yet, for streams that are not delimiter framed
+    std::string_view pending() const {
+        return std::string_view(buf_.data() + read_pos_, pending_bytes());
+    }
+
+    void consume(size_t n) {
+        read_pos_ += n;
+        scan_pos_ = std::max(scan_pos_, read_pos_);
+    }
+
+    size_t free_space() const {
+        return buf_.size() - write_pos_;
+    }
+
+    size_t pending_bytes() const {
+        return write_pos_ - read_pos_;
+    }
+
+    size_t capacity() const {
+        return buf_.size();
+    }
+
+    void clear() {
+        read_pos_ = scan_pos_ = write_pos_ = 0;
+    }
+
+  private:
+    void compact() {
+        if (read_pos_ == 0) {
+            return;
+        }
+        size_t pending = pending_bytes();
+        std::memmove(buf_.data(), buf_.data() + read_pos_, pending);
+        scan_pos_ -= read_pos_;
+        write_pos_ = pending;
+        read_pos_ = 0;
+    }
+
+    std::vector<char> buf_;
+    char delimiter_;
+    size_t read_pos_ = 0;  // Start of the first unconsumed frame
+    size_t scan_pos_ = 0;  // Bytes before this were already searched for the delimiter
+    size_t write_pos_ = 0; // End of received data
+};
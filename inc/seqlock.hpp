@@ -0,0 +1,58 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// Single writer / multiple readers snapshot of a trivially copyable value.
+// store() never waits and readers never block the writer nor each other: a reader copies the value and retries
+// only if a store() overlapped the copy. The value is kept as an array of atomic words, so the concurrent copies
+// are well defined without any lock.
+template <typename T> class Seqlock {
+    static_assert(std::is_trivially_copyable_v<T>, "Seqlock values are copied byte by byte");
+
+  public:
+    Seqlock() {
+        store(T{});
+    }
+
+    // Only one thread may call store()
+    void store(const T &value) {
+        std::array<uint64_t, Words> words{};
+        std::memcpy(words.data(), &value, sizeof(T));
+
+        uint64_t seq = seq_.load(std::memory_order_relaxed);
+        seq_.store(seq + 1, std::memory_order_relaxed); // Odd while writing
+        std::atomic_thread_fence(std::memory_order_release);
+        for (size_t i = 0; i < Words; i++) {
+            data_[i].store(words[i], std::memory_order_relaxed);
+        }
+        seq_.store(seq + 2, std::memory_order_release);
+    }
+
+    T load() const {
+        std::array<uint64_t, Words> words;
+        uint64_t before;
+        uint64_t after;
+        do {
+            before = seq_.load(std::memory_order_acquire);
+            for (size_t i = 0; i < Words; i++) {
+                words[i] = data_[i].load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            after = seq_.load(std::memory_order_relaxed);
+        } while (before != after || (before & 1));
+
+        T value;
+        std::memcpy(static_cast<void *>(&value), words.data(), sizeof(T));
+        return value;
+    }
+
+  private:
+    static constexpr size_t Words = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    std::atomic<uint64_t> seq_ = 0;
+    std::array<std::atomic<uint64_t>, Words> data_{};
+};
@@ -1,15 +1,20 @@
 #pragma once
 
 #include <filesystem>
+#include <memory>
+#include <mutex>
 #include <set>
 #include <string>
 #include <Eigen/Eigen>
 
 #include "nlohmann/json.hpp"
+#include "tl/expected.hpp"
 #include "HX.hpp"
 #include "points.hpp"
+#include "route_optimizer.hpp"
 #include "tool.hpp"
-#include "tube_entry.hpp"
+#include "tube_table.hpp"
+#include "tube_index.hpp"
 #include "misc_fns.hpp"
 
 inline std::filesystem::path sessions_dir = std::filesystem::path("sessions");
@@ -33,7 +38,7 @@ class CalPointEntry {
 };
 NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(CalPointEntry, col, row, ideal_coords, determined_coords, determined)
 
-class Session {
+class Session : public std::enable_shared_from_this<Session> {
   public:
     Session();
 
@@ -51,6 +56,11 @@ class Session {
 
     void plan_remove(const std::string& plan);
 
+    // Reorders the plan to shorten the XY travel. Returns the route length before and after, in HX units.
+    // The new order is only written to SEQ when apply is true.
+    tl::expected<nlohmann::json, std::string> plan_optimize_route(
+        const std::string& plan, const RouteOptions& options, bool apply);
+
     void cal_points_add_update(
         const std::string& tube_id,
         const std::string& col,
@@ -72,9 +82,25 @@ class Session {
 
     double from_ui_to_rema(double meassure);
 
-    static std::vector<Session> sessions_list() ;
+    // Writes the whole session and empties its journal. The session is serialized with mtx held, the file is written
+    // without it.
+    void save_to_disk();
+
+    // Flags an unsaved change, described by a journal record, called with mtx held. The record of a change to a
+    // session owned by session_cache, current or not, is appended to that session's journal by session_saver.
+    void mark_changed(nlohmann::json record);
+
+    // A plan replaced as a whole, e.g. uploaded or reordered
+    void plan_changed(const std::string& plan);
+
+    // Journal records are JSON lines, each one applied over the session file and the records before it
+    void apply_journal_record(const nlohmann::json& record);
+
+    void append_to_journal(const std::vector<nlohmann::json>& records);
 
-    void save_to_disk() const;
+    std::filesystem::path file_path() const;
+
+    std::filesystem::path journal_path() const;
 
     void set_selected_plan(std::string& plan);
 
@@ -88,27 +114,38 @@ class Session {
 
     static void delete_session(std::string session_name);
 
-    std::map<std::string, TubeEntry> calculate_aligned_tubes();
+    TubeTable calculate_aligned_tubes();
 
     Point3D transform_point_if_aligned(Point3D point, bool inverse = false);
 
+    // Spatial index over the aligned tube positions, rebuilt when the HX or its alignment changes
+    std::shared_ptr<const TubeIndex> get_tube_index();
+
+    // Called with mtx held
     nlohmann::json to_json_to_disk() const;
 
     void from_json_from_disk(const nlohmann::json& json);
 
+    void replay_journal();
+
     std::string name;
     std::filesystem::path hx_dir;
     HX hx;
     std::string last_selected_plan;
     std::string last_write_time;
     bool is_loaded = false;
-    bool is_changed = false;
+    // Guards plans, cal_points, last_selected_plan, is_changed and journal_size: the REST workers and the plan runner
+    // change them while session_saver writes the session from its own thread
+    mutable std::mutex mtx;
+    bool is_changed = false; // Changed since the last save_to_disk()
+    uintmax_t journal_size = 0; // Bytes appended since the last save_to_disk()
     bool is_aligned = false;
     Eigen::Matrix4d transformation_matrix;
     Eigen::Matrix4d inverse_transformation_matrix;
     std::map<std::string, CalPointEntry> cal_points;
     std::map<std::string, std::map<std::string, struct PlanEntry>> plans;
-    
+    SharedTubeIndex tube_index;
+
 };
 
 NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE_WITH_DEFAULT(
@@ -122,5 +159,3 @@ NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE_WITH_DEFAULT(
     cal_points,    
     is_aligned,
     is_loaded)
-
-inline Session current_session;
\ No newline at end of file
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "session.hpp"
+
+// Owns the current session and the sessions recently switched away from, fully built (HX, SVG, alignment, tube
+// index), so switching back to one of them is a pointer swap instead of reading and building it again. The session
+// switched away from is flushed by session_saver first, so a cached session never holds unsaved changes. A cached
+// session whose files changed since (session, journal or HX sources) is loaded again.
+//
+// The current session is published through an atomic shared_ptr: readers on other threads (telemetry, SSE, motion
+// jobs, the saver) take a snapshot with current() and keep using that session even if another one is activated
+// meanwhile.
+class SessionCache {
+  public:
+    static constexpr size_t Capacity = 4;
+
+    SessionCache() : current_(std::make_shared<Session>()) {
+    }
+
+    // Never null, an empty Session (is_loaded false) until the first one is activated
+    std::shared_ptr<Session> current() const {
+        return current_.load();
+    }
+
+    // Makes session_name the current session. True when it came from the cache.
+    bool activate(const std::string &session_name);
+
+    // Makes a just created session the current one
+    void activate(std::shared_ptr<Session> session);
+
+    // The session file is gone or replaced
+    void evict(const std::string &session_name);
+
+  private:
+    struct Entry {
+        std::shared_ptr<Session> session;
+        std::vector<int64_t> stamp;
+    };
+
+    static std::vector<int64_t> stamp_of(const Session &session);
+
+    // Publishes session as the current one and keeps the previous one in the cache, called with mtx held
+    void switch_to_locked(std::shared_ptr<Session> session);
+
+    std::mutex mtx; // Serializes activate() and evict(), readers only touch current_
+    std::list<Entry> entries; // Most recently used first, the current session is not among them
+    std::atomic<std::shared_ptr<Session>> current_;
+};
+
+inline SessionCache session_cache;
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "nlohmann/json.hpp"
+
+class Session;
+
+// What the Sessions page shows of a session, without loading it
+struct SessionSummary {
+    std::string name;
+    std::string hx_dir;
+    nlohmann::json hx = nlohmann::json::object(); // tube_od, leg, unit and scale of the HX, without tubes nor SVG
+    int total_tubes_in_plans = 0;
+    int total_tubes_executed = 0;
+    std::string last_write_time;
+    int64_t file_time = 0;    // Write time of the .json file the summary was made from
+    int64_t journal_time = 0; // Same for the journal, 0 without one
+};
+NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE_WITH_DEFAULT(
+    SessionSummary,
+    name,
+    hx_dir,
+    hx,
+    total_tubes_in_plans,
+    total_tubes_executed,
+    last_write_time,
+    file_time,
+    journal_time)
+
+// Summaries of every session in sessions_dir, kept in sessions/.sessions_index. The current session updates its
+// summary on every save; any other summary whose files changed behind the index, or that is missing, is made again by
+// scan() when listing, so the index can also be deleted to rebuild it.
+class SessionIndex {
+  public:
+    static inline const std::string IndexFile = ".sessions_index";
+
+    // Sorted by name
+    std::vector<SessionSummary> list();
+
+    // After session was written
+    void update(const Session &session);
+
+    void remove(const std::string &name);
+
+    // Reads only hx_dir and the executed flags of the plans from the session file, with a SAX parser, then applies
+    // the journal records that change them. The HX fields come from its config.json.
+    static SessionSummary scan(const std::filesystem::path &session_file);
+
+  private:
+    void load_locked();
+
+    void store_locked();
+
+    bool loaded = false;
+    bool dirty = false;
+    std::mutex mtx;
+    std::map<std::string, SessionSummary> summaries;
+};
+
+inline SessionIndex session_index;
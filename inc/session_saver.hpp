@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stop_token>
+#include <vector>
+
+#include "nlohmann/json.hpp"
+
+class Session;
+
+// When a session is written after a change, from config.json "REMA_PROXY" > "session_save"
+struct SessionSaverSettings {
+    int debounce_ms = 500;        // Quiet time after the last change
+    int max_delay_ms = 5000;      // Upper bound from the first unsaved change, for changes that keep coming
+    int compact_journal_kb = 256; // Past this size the journal is folded into a full save of the session
+};
+NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE_WITH_DEFAULT(SessionSaverSettings, debounce_ms, max_delay_ms, compact_journal_kb)
+
+// Saves sessions from its own thread, so disk writes never delay the REST workers nor the SSE stream. Changes are
+// appended to the journal of the session they were made to, as small records; a burst of them (a plan run marking
+// tubes, calibration points edited one after the other) ends up in a single append. Records keep their session, so
+// a change still pending when another session is activated never lands in the new one. Once the journal has grown past
+// compact_journal_kb the next save writes the whole session instead, which empties the journal.
+class SessionSaver {
+  public:
+    // Called for every change of a session, with its journal record
+    void changed(std::shared_ptr<Session> session, nlohmann::json record);
+
+    // Writes the pending changes right away, before the current session is replaced by another one
+    void flush();
+
+    // True once after every write, for the "Session Saved" message
+    bool take_saved() {
+        return saved.exchange(false);
+    }
+
+    void run(std::stop_token stop_token, const SessionSaverSettings &settings);
+
+  private:
+    // Records of one session, in the order they were made
+    struct Batch {
+        std::shared_ptr<Session> session;
+        std::vector<nlohmann::json> records;
+    };
+
+    void save();
+
+    // Writes one batch to its session, false when it failed
+    bool save(const Batch &batch, uintmax_t compact_at);
+
+    void arm();
+
+    std::mutex mtx;
+    std::condition_variable_any cv;
+    std::optional<std::chrono::steady_clock::time_point> first_change; // Empty when nothing is pending
+    std::chrono::steady_clock::time_point last_change;
+    std::vector<Batch> pending; // Journal records not written yet, consecutive ones of a session in one batch
+    uintmax_t compact_bytes = SessionSaverSettings{}.compact_journal_kb * 1024;
+    std::mutex save_mtx; // One write at a time, from run() or flush()
+    std::atomic<bool> saved = false;
+};
+
+inline SessionSaver session_saver;
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "nlohmann/json.hpp"
+
+// TCP tuning applied to an RTU socket before connecting, read from config.json "REMA" > "network" > "socket_options".
+// Zero means "leave the kernel default" for the numeric options.
+struct SocketOptions {
+    bool tcp_nodelay = true;      // Do not hold small JSON commands back waiting for the ACK of the previous one
+    bool keepalive = true;
+    int keepalive_idle_s = 5;     // Idle time before the first probe
+    int keepalive_interval_s = 1; // Time between probes
+    int keepalive_count = 3;      // Unanswered probes before the connection is dropped
+    int user_timeout_ms = 3000;   // Max time sent data may stay unacknowledged before the connection is dropped
+    int rcvbuf = 0;
+    int sndbuf = 0;
+    int busy_poll_us = 0;         // SO_BUSY_POLL, trades CPU for receive latency
+};
+NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE_WITH_DEFAULT(
+    SocketOptions,
+    tcp_nodelay,
+    keepalive,
+    keepalive_idle_s,
+    keepalive_interval_s,
+    keepalive_count,
+    user_timeout_ms,
+    rcvbuf,
+    sndbuf,
+    busy_poll_us)
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <restbed>
+#include <string>
+#include <vector>
+
+#include "nlohmann/json.hpp"
+
+// Fans the /sse messages out to every subscribed browser. A message is serialized once and the same immutable
+// buffer is queued to every subscriber; each subscriber has at most one write in flight, so a slow browser only
+// grows its own queue and never holds back the others nor the publisher.
+// Telemetry goes stale: a subscriber keeps at most one telemetry message waiting, a newer keyframe replaces it and a
+// newer delta makes it skip the deltas until the next keyframe (see take_keyframe_request()). Lagging subscribers
+// get one at most every LaggingKeyframeInterval, so they do not turn every message into a keyframe.
+// Events are never dropped; a subscriber that lets MaxQueuedEvents pile up is disconnected, the browser reconnects
+// and starts over.
+class SseBroadcaster {
+  public:
+    enum class Kind { EVENT, TELEMETRY_KEYFRAME, TELEMETRY_DELTA };
+
+    static constexpr size_t MaxQueuedEvents = 64;
+    static constexpr std::chrono::milliseconds LaggingKeyframeInterval = std::chrono::milliseconds(1000);
+
+    void subscribe(const std::shared_ptr<restbed::Session> &session);
+
+    void publish(Kind kind, const nlohmann::json &message);
+
+    bool has_subscribers();
+
+    // Whether the next telemetry message should be a keyframe, because a subscriber joined or skipped a delta
+    bool take_keyframe_request();
+
+  private:
+    struct Message {
+        Kind kind;
+        std::shared_ptr<const std::string> data;
+    };
+
+    struct Subscriber {
+        std::shared_ptr<restbed::Session> session;
+        std::deque<Message> queue;
+        size_t queued_events = 0;
+        bool writing = false;
+        bool needs_keyframe = true;
+    };
+
+    // False when the subscriber is too far behind and must be disconnected. Called with mtx held.
+    bool enqueue(Subscriber &subscriber, const Message &message);
+
+    static bool drop_telemetry(Subscriber &subscriber);
+
+    void write_next(const std::shared_ptr<Subscriber> &subscriber);
+
+    std::mutex mtx;
+    std::vector<std::shared_ptr<Subscriber>> subscribers;
+    bool keyframe_requested = false;         // By a new subscriber, right away
+    bool lagging_keyframe_requested = false; // By a subscriber that skipped a delta
+    std::chrono::steady_clock::time_point last_lagging_keyframe;
+};
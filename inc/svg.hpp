@@ -1,105 +1,165 @@
 #pragma once
 
 #include "csv.hpp"
-#include "rapidxml_ext.hpp"
-#include "tube_entry.hpp"
 #include <algorithm>
 #include <boost/algorithm/string.hpp>
-#include <boost/program_options.hpp>
+#include <charconv>
 #include <cmath>
+#include <cstring>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
 #include <map>
+#include <string>
+#include <string_view>
 #include <utility>
 
-static inline void append_attributes(
-    rapidxml::xml_document<char>* doc,
-    rapidxml::xml_node<char>* node,
-    std::vector<std::pair<std::string, std::string>> attrs) {
-    if (node) {
+// Writes the tubesheet SVG straight into one string, without building a DOM. Numbers are formatted with
+// std::to_chars (shortest form that reads back to the same float) and text is escaped only when it has to be.
+class SvgWriter {
+  public:
+    explicit SvgWriter(size_t reserve = 0) {
+        out.reserve(reserve);
+    }
+
+    SvgWriter &raw(std::string_view text) {
+        out.append(text);
+        return *this;
+    }
+
+    // Character data or attribute value, escaped like rapidxml::print did
+    SvgWriter &text(std::string_view text) {
+        if (!needs_escape(text)) {
+            out.append(text);
+            return *this;
+        }
+        for (char c : text) {
+            switch (c) {
+            case '&': out.append("&amp;"); break;
+            case '<': out.append("&lt;"); break;
+            case '>': out.append("&gt;"); break;
+            case '"': out.append("&quot;"); break;
+            case '\'': out.append("&apos;"); break;
+            default: out.push_back(c);
+            }
+        }
+        return *this;
+    }
+
+    SvgWriter &number(float value) {
+        return raw(Number(value));
+    }
+
+    SvgWriter &attr(std::string_view name, std::string_view value) {
+        out.push_back(' ');
+        out.append(name);
+        out.append("=\"");
+        text(value);
+        out.push_back('"');
+        return *this;
+    }
+
+    SvgWriter &attr(std::string_view name, float value) {
+        out.push_back(' ');
+        out.append(name);
+        out.append("=\"");
+        number(value);
+        out.push_back('"');
+        return *this;
+    }
+
+    // Two numbers separated by a space, as transform-origin takes them
+    SvgWriter &attr(std::string_view name, float first, float second) {
+        out.push_back(' ');
+        out.append(name);
+        out.append("=\"");
+        number(first);
+        out.push_back(' ');
+        number(second);
+        out.push_back('"');
+        return *this;
+    }
+
+    void dashed_line(float x1, float y1, float x2, float y2, float font_size) {
+        float stroke_width = font_size / 10;
+        float line = font_size / 2;
+        float space = line / 2;
+
+        raw("<line").attr("x1", x1).attr("y1", y1).attr("x2", x2).attr("y2", y2);
+        raw(" stroke=\"gray\"").attr("stroke-width", stroke_width);
+        raw(" stroke-dasharray=\"").number(line).raw(", ").number(space).raw("\"/>\n");
+    }
 
-        for (auto attr : attrs) {
-            node->append_attribute(doc->allocate_attribute(
-                doc->allocate_string(attr.first.c_str()), doc->allocate_string(attr.second.c_str())));
+    void label(float x, float y, std::string_view label, std::string_view transform) {
+        raw("<text").attr("x", x).attr("y", y).raw(" class=\"label\"");
+        attr("transform-origin", x, y).attr("transform", transform).raw(">");
+        text(label).raw("</text>\n");
+    }
+
+    // x and y go three times into every tube, they are formatted once. Tubes whose id and labels need no escaping,
+    // all of them in practice, are put together on the stack and appended at once.
+    void tube(std::string_view id, std::string_view x_label, std::string_view y_label, float x, float y, float radius) {
+        Number cx(x), cy(y);
+        if (radius != tube_radius) {
+            tube_radius = radius;
+            tube_r = Number(radius);
         }
+
+        constexpr size_t Markup = 256; // Everything in a tube but the id, labels and numbers
+        char line[1024];
+        char *p = line;
+        auto put = [&p](std::string_view text) {
+            std::memcpy(p, text.data(), text.size());
+            p += text.size();
+        };
+        bool plain = !needs_escape(id) && !needs_escape(x_label) && !needs_escape(y_label);
+        if (plain && 3 * (id.size() + x_label.size() + y_label.size()) + 7 * sizeof(Number) + Markup <= sizeof(line)) {
+            put("<g id=\""), put(id), put("\" data-col=\""), put(x_label), put("\" data-row=\""), put(y_label);
+            put("\"><title>Id="), put(id), put(" Col="), put(x_label), put(" Row="), put(y_label);
+            put("</title><circle cx=\""), put(cx), put("\" cy=\""), put(cy), put("\" r=\""), put(tube_r);
+            put("\" class=\"tube\"/><text class=\"tube_num\" x=\""), put(cx), put("\" y=\""), put(cy);
+            put("\" transform-origin=\""), put(cx), put(" "), put(cy);
+            put("\" transform=\"scale(1,-1)\">"), put(id.substr(3)), put("</text></g>\n");
+            out.append(line, p);
+            return;
+        }
+
+        raw("<g").attr("id", id).attr("data-col", x_label).attr("data-row", y_label).raw(">");
+        raw("<title>Id=").text(id).raw(" Col=").text(x_label).raw(" Row=").text(y_label).raw("</title>");
+        raw("<circle cx=\"").raw(cx).raw("\" cy=\"").raw(cy).raw("\" r=\"").raw(tube_r).raw("\" class=\"tube\"/>");
+        raw("<text class=\"tube_num\" x=\"").raw(cx).raw("\" y=\"").raw(cy);
+        raw("\" transform-origin=\"").raw(cx).raw(" ").raw(cy);
+        raw("\" transform=\"scale(1,-1)\">").text(id.substr(3)).raw("</text></g>\n");
+    }
+
+    size_t size() const {
+        return out.size();
+    }
+
+    std::string str() && {
+        return std::move(out);
     }
-}
-
-static inline rapidxml::xml_node<char>* 
-add_dashed_line(rapidxml::xml_document<char>* doc, float x1, float y1, float x2, float y2, float font_size) {
-    float stroke_width = font_size / 10;
-    float line = font_size / 2;
-    float space = line / 2;
-
-    auto line_node = doc->allocate_node(rapidxml::node_type::node_element, "line");
-    append_attributes(
-        doc,
-        line_node,
-        {
-            { "x1", std::to_string(x1) },
-            { "y1", std::to_string(y1) },
-            { "x2", std::to_string(x2) },
-            { "y2", std::to_string(y2) },
-            { "stroke", "gray" },
-            { "stroke-width", std::to_string(stroke_width) },
-            { "stroke-dasharray", std::to_string(line) + ", " + std::to_string(space) },
-        });
-
-    return line_node;
-}
-
-static inline rapidxml::xml_node<char>* add_label(rapidxml::xml_document<char>* doc, float x, float y, const char* label) {
-    auto label_node = doc->allocate_node(rapidxml::node_type::node_element, "text", doc->allocate_string(label));
-
-    append_attributes(
-        doc,
-        label_node,
-        {
-            { "x", std::to_string(x) },
-            { "y", std::to_string(y) },
-            { "class", "label" },
-        });
-
-    return label_node;
-}
-
-static inline rapidxml::xml_node<char>* 
-add_tube(rapidxml::xml_document<char>* doc, TubeEntry tube, std::string id, float radius) {
-    auto tube_group_node = doc->allocate_node(rapidxml::node_type::node_element, "g");
-    append_attributes(
-        doc,
-        tube_group_node,
-        { { "id", doc->allocate_string(id.c_str()) }, { "data-col", tube.x_label }, { "data-row", tube.y_label } });
-
-    auto tube_node = doc->allocate_node(rapidxml::node_type::node_element, "circle");
-    append_attributes(
-        doc,
-        tube_node,
-        {
-            { "cx", std::to_string(tube.coords.x) },
-            { "cy", std::to_string(tube.coords.y) },
-            { "r", std::to_string(radius) },
-            { "class", "tube" },
-        });
-
-    auto tooltip_node = doc->allocate_node(rapidxml::node_type::node_element, "title");
-    tooltip_node->value(doc->allocate_string((std::string("Id=") + id + " Col=" + tube.x_label + " Row=" + tube.y_label).c_str()));
-    tube_group_node->append_node(tooltip_node);
-    tube_group_node->append_node(tube_node);
-    auto number_node = doc->allocate_node(rapidxml::node_type::node_element, "text", doc->allocate_string(id.substr(3).c_str()));
-    // number_node->value();
-    append_attributes(
-        doc,
-        number_node,
-        {
-            { "class", "tube_num" },
-            { "x", std::to_string(tube.coords.x) },
-            { "y", std::to_string(tube.coords.y) },
-            { "transform-origin", std::to_string(tube.coords.x) + " " + std::to_string(tube.coords.y) },
-            { "transform", "scale(1,-1)" },
-        });
-
-    tube_group_node->append_node(number_node);
-    return tube_group_node;
-}
+
+  private:
+    static bool needs_escape(std::string_view text) {
+        return text.find_first_of("&<>\"'") != std::string_view::npos;
+    }
+
+    struct Number {
+        Number() = default;
+
+        explicit Number(float value) : len(std::to_chars(buf, buf + sizeof(buf), value).ptr - buf) {
+        }
+
+        operator std::string_view() const {
+            return { buf, len };
+        }
+
+        char buf[32];
+        size_t len = 0;
+    };
+
+    std::string out;
+    float tube_radius = NAN;
+    Number tube_r;
+};
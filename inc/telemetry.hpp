@@ -4,12 +4,17 @@
 
 #include <points.hpp>
 
+#include "msgpack_decoder.hpp"
+
+// The RTU sends these structs as msgpack maps, decoded in place by msgpack_decode()
+MSGPACK_DEFINE_DECODER(Point3D, x, y, z)
+
 struct individual_axes {
     bool x;
     bool y;
     bool z;
 };
-NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(individual_axes, x, y, z)
+MSGPACK_DEFINE_TYPE_NON_INTRUSIVE(individual_axes, x, y, z)
 
 struct limits {
     bool left;
@@ -20,13 +25,13 @@ struct limits {
     bool out;
     bool probe;
 };
-NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(limits, left, right, up, down, in, out, probe)
+MSGPACK_DEFINE_TYPE_NON_INTRUSIVE(limits, left, right, up, down, in, out, probe)
 
 struct compound_axes {
     bool x_y = false;
     bool z = false;
 };
-NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(compound_axes, x_y, z)
+MSGPACK_DEFINE_TYPE_NON_INTRUSIVE(compound_axes, x_y, z)
 
 struct telemetry {
     struct Point3D coords;
@@ -40,7 +45,7 @@ struct telemetry {
     int brakes_mode;
     bool probe_protected;
 };
-NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(
+MSGPACK_DEFINE_TYPE_NON_INTRUSIVE(
     telemetry,
     coords,
     targets,
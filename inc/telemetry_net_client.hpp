@@ -1,27 +1,27 @@
 #pragma once
 
+#include "msgpack_decoder.hpp"
 #include "net_client.hpp"
+#include <atomic>
 #include <chrono>
-#include <condition_variable>
 #include <iostream>
 #include <memory>
 #include <restbed>
+#include <span>
 #include <spdlog/spdlog.h>
 #include <string>
-#include <thread>
 #include <watchdog_timer.hpp>
 
 class TelemetryNetClient : public NetClient {
   public:    
     TelemetryNetClient() = default;
 
-    void set_on_receive_callback(std::function<void(std::vector<uint8_t>&)> onReceiveCallback) {
+    void set_on_receive_callback(std::function<bool(std::span<const uint8_t>)> onReceiveCallback) {
         onReceiveCb = onReceiveCallback;
     }
 
     void start() {
         if (!alreadyStarted && onReceiveCb) {
-            thd = std::jthread(&TelemetryNetClient::loop, this);
             disconnect_watchdog.onTimeoutCallback = [&] { 
                 SPDLOG_WARN("Telemetry watchdog timer expired. Closing connection");
                 close(); 
@@ -40,32 +40,77 @@ class TelemetryNetClient : public NetClient {
         if (int n; (n = NetClient::connect(host, port, nsec)) < 0) {
             return n;
         }
+        resyncing = false; // The new stream starts on a frame boundary
         disconnect_watchdog.resume();
-        cv.notify_all();      // NetClient::connect will change is_connected to true if successful
         return 0;
     }
 
-    void loop(std::stop_token stop_token) {
-        while (!stop_token.stop_requested()) {
-            {
-                std::unique_lock<std::mutex> lock(mtx);
-                cv.wait(lock, [this] { return is_connected; });
+    // Runs on the I/O reactor thread. The RTU sends one msgpack map per sample with nothing in between,
+    // so TCP may split a frame across reads or deliver several at once: every complete frame is handed to the
+    // callback and a partial one stays in rx_buffer_ until the rest arrives. Bytes that cannot start or belong to
+    // a frame are skipped one at a time until the stream lines up with a frame again.
+    void on_data() override {
+        while (rx_buffer_.pending_bytes() > 0) {
+            std::string_view pending = rx_buffer_.pending();
+            const auto *bytes = reinterpret_cast<const uint8_t *>(pending.data());
+
+            size_t frame_length = 0;
+            bool resync = !MsgpackReader::is_map_header(bytes[0]);
+            if (!resync) {
+                try {
+                    MsgpackReader reader(bytes, pending.size());
+                    reader.skip();
+                    frame_length = pending.size() - reader.remaining();
+                } catch (MsgpackIncompleteError &) {
+                    // A frame can not be this big, the length in the header must be garbage
+                    resync = pending.size() > MaxFrameSize;
+                    if (!resync) {
+                        break; // Wait for the rest of the frame
+                    }
+                } catch (std::exception &) {
+                    resync = true;
+                }
+            }
+
+            if (resync) {
+                if (!resyncing) {
+                    SPDLOG_WARN("Telemetry stream out of sync, skipping bytes");
+                    frames_dropped++;
+                    resyncing = true;
+                }
+                bytes_resynced++;
+                rx_buffer_.consume(1);
+                continue;
             }
 
-            std::vector<uint8_t> line = get_response_binary();
-            if (!line.empty()) {
-                // std::cout << "t" << std::flush;
-                onReceiveCb(line);
-                disconnect_watchdog.reset();
+            resyncing = false;
+            if (onReceiveCb && onReceiveCb(std::span<const uint8_t>(bytes, frame_length))) {
+                frames_decoded++;
+            } else {
+                frames_dropped++;
             }
+            rx_buffer_.consume(frame_length);
         }
+        disconnect_watchdog.reset();
     }
 
-    std::function<void(std::vector<uint8_t>&)> onReceiveCb;
-    std::jthread thd;
-    std::mutex mtx;
-    std::condition_variable cv;    
+    nlohmann::json get_stats() const {
+        return {
+            { "frames_decoded", frames_decoded.load() },
+            { "frames_dropped", frames_dropped.load() },
+            { "bytes_resynced", bytes_resynced.load() },
+        };
+    }
+
+    std::function<bool(std::span<const uint8_t>)> onReceiveCb;
     bool alreadyStarted = false;
     int ConnectionTimeout = 5;
     WatchdogTimer disconnect_watchdog;
+    std::atomic<uint64_t> frames_decoded = 0;
+    std::atomic<uint64_t> frames_dropped = 0; // Frames that failed to decode, plus one per resync
+    std::atomic<uint64_t> bytes_resynced = 0;
+
+  private:
+    static constexpr size_t MaxFrameSize = 16 * 1024;
+    bool resyncing = false;
 };
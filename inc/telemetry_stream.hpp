@@ -0,0 +1,39 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+
+#include "nlohmann/json.hpp"
+
+// How the SSE stream sends telemetry, from config.json "REMA_PROXY" > "sse"
+struct TelemetryStreamSettings {
+    int max_rate_hz = 20;            // Frames arriving faster than this are coalesced into one message
+    int keyframe_interval_ms = 5000; // Full TELEMETRY object at least this often, deltas in between
+    int idle_poll_ms = 100;          // Without telemetry the stream still wakes up for jobs, link state, etc.
+};
+NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE_WITH_DEFAULT(TelemetryStreamSettings, max_rate_hz, keyframe_interval_ms, idle_poll_ms)
+
+// RFC 7386 merge patch turning from into to: changed members only, nested objects patched member by member,
+// removed members set to null. Members whose new value is null cannot be told apart from removed ones.
+nlohmann::json json_merge_diff(const nlohmann::json &from, const nlohmann::json &to);
+
+// Encodes the telemetry sent on the SSE stream as a keyframe ("TELEMETRY", the whole object) followed by deltas
+// ("TELEMETRY_DELTA", a merge patch against the previous message). Nothing is added when nothing changed.
+class TelemetryDeltaEncoder {
+  public:
+    explicit TelemetryDeltaEncoder(std::chrono::milliseconds keyframe_interval_) : keyframe_interval(keyframe_interval_) {
+    }
+
+    void encode(nlohmann::json &res, const nlohmann::json &telemetry);
+
+    // The next message is a keyframe, for clients that just connected
+    void request_keyframe() {
+        keyframe_requested = true;
+    }
+
+  private:
+    std::chrono::milliseconds keyframe_interval;
+    std::chrono::steady_clock::time_point last_keyframe;
+    nlohmann::json last_sent;
+    std::atomic<bool> keyframe_requested = true;
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <restbed>
+#include <stop_token>
+#include <vector>
+
+#include "rema.hpp"
+
+// Binary telemetry frame sent on /ws/telemetry, little endian, UI coordinates:
+//   0  uint64 sequence       telemetry frames received from the RTU, gaps are frames not sent
+//   8  float64 x 3           coords
+//  32  float64 x 3           targets
+//  56  uint16 flags          bit 0 on_condition.x_y, 1 on_condition.z, 2 probe.x_y, 3 probe.z, 4 stalled.x,
+//                            5 stalled.y, 6 stalled.z, 7 control_enabled, 8 stall_control, 9 probe_protected,
+//                            10 sequence in progress (the SSE show_target)
+//  58  uint8 limits          bit 0 left, 1 right, 2 up, 3 down, 4 in, 5 out, 6 probe
+//  59  int8 brakes_mode
+constexpr size_t TelemetryFrameSize = 60;
+
+std::array<uint8_t, TelemetryFrameSize> encode_telemetry_frame(
+    const TelemetrySnapshot &snapshot, bool sequence_in_progress);
+
+// WebSocket alternative to the JSON telemetry of /sse for remote viewers on slow links: every frame is the fixed
+// 60 bytes above, with no JSON encoding on the server. A client receives one frame out of every `decimation`
+// (?decimation=N when connecting, or a {"decimation": N} text message later). A client still sending the previous
+// frame skips the new one instead of queueing it.
+class TelemetryWebSocket {
+  public:
+    void upgrade(const std::shared_ptr<restbed::Session> &session);
+
+    // Sends the frames as they arrive, until stop is requested
+    void run(std::stop_token stop_token);
+
+  private:
+    struct Client {
+        std::shared_ptr<restbed::WebSocket> socket;
+        uint64_t decimation = 1;
+        uint64_t last_sent_sequence = 0;
+        bool sending = false;
+    };
+
+    void on_message(
+        const std::shared_ptr<Client> &client,
+        const std::shared_ptr<restbed::WebSocket> &socket,
+        const std::shared_ptr<restbed::WebSocketMessage> &message);
+
+    void broadcast(const TelemetrySnapshot &snapshot);
+
+    std::mutex mtx;
+    std::vector<std::shared_ptr<Client>> clients;
+};
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <Eigen/Eigen>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "nlohmann/json.hpp"
+#include "points.hpp"
+#include "tube_table.hpp"
+
+// Static 2-d tree over the tube positions in XY. Built once, then answers nearest tube and range queries in
+// O(log n) on average without walking the tube table.
+class TubeIndex {
+  public:
+    struct Hit {
+        std::string tube_id;
+        Point3D coords;
+        double distance;
+    };
+
+    // What the index was built from, to tell whether it is still valid
+    struct Key {
+        std::string hx_dir;
+        size_t tubes = 0;
+        bool aligned = false;
+        Eigen::Matrix4d transformation = Eigen::Matrix4d::Identity();
+
+        bool operator==(const Key &other) const {
+            return hx_dir == other.hx_dir && tubes == other.tubes && aligned == other.aligned &&
+                   (!aligned || transformation == other.transformation);
+        }
+    };
+
+    // tubes are already transformed when the key is aligned
+    TubeIndex(Key key, TubeTable tubes);
+
+    std::optional<Hit> nearest(const Point3D &point) const;
+
+    // Sorted by distance
+    std::vector<Hit> within_radius(const Point3D &point, double radius) const;
+
+    // Distances are measured from the center of the box
+    std::vector<Hit> within_box(const Point3D &min, const Point3D &max) const;
+
+    const Key &key() const {
+        return key_;
+    }
+
+    size_t size() const {
+        return nodes.size();
+    }
+
+  private:
+    struct Node {
+        double x, y;
+        TubeTable::TubeId tube;
+    };
+
+    void build(size_t begin, size_t end, int axis);
+
+    void nearest(size_t begin, size_t end, int axis, double x, double y, size_t &best, double &best_d2) const;
+
+    template <typename Visit>
+    void range(size_t begin, size_t end, int axis, const double lo[2], const double hi[2], Visit &visit) const;
+
+    Hit make_hit(size_t node, double distance) const;
+
+    Key key_;
+    TubeTable tubes;
+    std::vector<Node> nodes; // Implicit tree: the median of every range is its root
+};
+
+// Holds the index shared by the REST workers and the SSE thread. Copies of a session share the index, not the lock.
+class SharedTubeIndex {
+  public:
+    SharedTubeIndex() = default;
+
+    SharedTubeIndex(const SharedTubeIndex &other) : index(other.load()) {
+    }
+
+    SharedTubeIndex &operator=(const SharedTubeIndex &other) {
+        store(other.load());
+        return *this;
+    }
+
+    std::shared_ptr<const TubeIndex> load() const {
+        std::lock_guard<std::mutex> lock(mtx);
+        return index;
+    }
+
+    void store(std::shared_ptr<const TubeIndex> new_index) {
+        std::lock_guard<std::mutex> lock(mtx);
+        index = std::move(new_index);
+    }
+
+  private:
+    mutable std::mutex mtx;
+    std::shared_ptr<const TubeIndex> index;
+};
+
+inline void to_json(nlohmann::json &j, const TubeIndex::Hit &hit) {
+    j = { { "tube_id", hit.tube_id }, { "coords", hit.coords }, { "distance", hit.distance } };
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "nlohmann/json.hpp"
+#include "points.hpp"
+#include "tube_entry.hpp"
+
+// Tubes of an HX as columns indexed by a dense TubeId, their position in the table. Coordinates are kept in one array
+// per axis and the row and column labels, shared by many tubes, are interned once, so walking every tube reads
+// contiguous memory. The external ids ("CL_123") stay the JSON keys; by_id maps them to TubeIds.
+class TubeTable {
+  public:
+    using TubeId = uint32_t;
+    using LabelId = uint32_t;
+
+    // A tube already in the table keeps its first entry, like inserting into a map
+    TubeId add(const std::string &id, const std::string &x_label, const std::string &y_label, const Point3D &coords);
+
+    std::optional<TubeId> find(const std::string &id) const {
+        if (auto iter = by_id.find(id); iter != by_id.end()) {
+            return iter->second;
+        }
+        return std::nullopt;
+    }
+
+    bool contains(const std::string &id) const {
+        return by_id.contains(id);
+    }
+
+    size_t size() const {
+        return ids.size();
+    }
+
+    bool empty() const {
+        return ids.empty();
+    }
+
+    void clear();
+
+    void reserve(size_t tubes);
+
+    const std::string &id(TubeId tube) const {
+        return ids[tube];
+    }
+
+    Point3D coords(TubeId tube) const {
+        return { xs[tube], ys[tube], zs[tube] };
+    }
+
+    const std::string &x_label(TubeId tube) const {
+        return labels[x_labels[tube]];
+    }
+
+    const std::string &y_label(TubeId tube) const {
+        return labels[y_labels[tube]];
+    }
+
+    TubeEntry entry(TubeId tube) const {
+        return { x_label(tube), y_label(tube), coords(tube) };
+    }
+
+    // Same tubes with every position passed through transform
+    template <typename Transform> TubeTable transformed(Transform transform) const {
+        TubeTable res = *this;
+        for (TubeId tube = 0; tube < size(); tube++) {
+            Point3D point = transform(coords(tube));
+            res.xs[tube] = point.x;
+            res.ys[tube] = point.y;
+            res.zs[tube] = point.z;
+        }
+        return res;
+    }
+
+    const std::vector<double> &x() const {
+        return xs;
+    }
+
+    const std::vector<double> &y() const {
+        return ys;
+    }
+
+  private:
+    LabelId intern(const std::string &label);
+
+    std::vector<std::string> ids;
+    std::vector<double> xs, ys, zs;
+    std::vector<LabelId> x_labels, y_labels;
+    std::vector<std::string> labels;
+    std::unordered_map<std::string, LabelId> label_ids;
+    std::unordered_map<std::string, TubeId> by_id;
+};
+
+// The same object keyed by tube id the API has always used: { "CL_1": { x_label, y_label, coords }, ... }
+void to_json(nlohmann::json &j, const TubeTable &tubes);
+
+void from_json(const nlohmann::json &j, TubeTable &tubes);
@@ -2,23 +2,35 @@
 
 #include <atomic>
 #include <chrono>
-#include <condition_variable>
 #include <functional>
 #include <iostream>
-#include <thread>
+#include <mutex>
 
+#include "io_reactor.hpp"
+
+// Calls onTimeoutCallback when reset() was not called for longer than timeout.
+// Runs on a timerfd of the shared I/O reactor instead of a thread of its own. reset() is called once per
+// received frame, so it only records the time; the timer re-arms itself for the remaining time when it fires.
 class WatchdogTimer {
-  public:  
+  public:
     WatchdogTimer() = default;
 
     WatchdogTimer(std::chrono::duration<double> timeout_, std::function<void()> timeoutCallback)
-        : timeout(timeout_), onTimeoutCallback(timeoutCallback){
-            start();
+        : timeout(timeout_), onTimeoutCallback(timeoutCallback) {
+        start();
+    }
+
+    ~WatchdogTimer() {
+        io_reactor.remove_timer(timer_fd);
     }
 
+    WatchdogTimer(const WatchdogTimer &) = delete;
+    WatchdogTimer &operator=(const WatchdogTimer &) = delete;
+
     void start() {
-        if (onTimeoutCallback && timeout != std::chrono::duration<double>::zero()) {
-            watchdogThread = std::jthread(&WatchdogTimer::watchdogLoop, this);
+        if (onTimeoutCallback && timeout != std::chrono::duration<double>::zero() && timer_fd < 0) {
+            timer_fd = io_reactor.add_timer([this] { on_timer(); });
+            resume();
         }
     }
 
@@ -28,50 +40,55 @@ class WatchdogTimer {
     }
 
     void reset() {
-        std::unique_lock<std::mutex> lock(mtx);
-        resetFlag = true;
-        cv.notify_one();
+        last_reset = std::chrono::steady_clock::now().time_since_epoch().count();
     }
 
     void pause() {
-        std::unique_lock<std::mutex> lock(mtx);
-        pauseFlag = true;
-        cv.notify_one();
+        std::lock_guard<std::mutex> lock(mtx);
+        paused = true;
+        if (timer_fd >= 0) {
+            io_reactor.disarm_timer(timer_fd);
+        }
     }
 
     void resume() {
-        std::unique_lock<std::mutex> lock(mtx);
-        resetFlag = true;
-        pauseFlag = false;
-        cv.notify_one();
+        std::lock_guard<std::mutex> lock(mtx);
+        reset();
+        paused = false;
+        if (timer_fd >= 0) {
+            io_reactor.arm_timer(timer_fd, timeout_ns());
+        }
     }
 
   private:
-    void watchdogLoop(std::stop_token stop_token) {
-        while (!stop_token.stop_requested()) {
-            std::unique_lock<std::mutex> lock(mtx);
-            if (cv.wait_for(lock, timeout, [this] { return resetFlag; })) {
-                // Timer was reset
-                resetFlag = false;
-            } else {
-                if (pauseFlag) {
-                    continue;
-                }
-                // Timeout expired without reset
-                pauseFlag = true; // Once it expired stay paused, until resumed
-                onTimeoutCallback();
+    std::chrono::nanoseconds timeout_ns() const {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(timeout);
+    }
+
+    void on_timer() {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            if (paused) {
+                return;
             }
+
+            auto since_reset = std::chrono::steady_clock::now().time_since_epoch() -
+                               std::chrono::steady_clock::duration(last_reset.load());
+            if (since_reset < timeout_ns()) {
+                io_reactor.arm_timer(timer_fd, timeout_ns() - since_reset); // Was reset meanwhile, wait for the rest
+                return;
+            }
+            paused = true; // Once it expired stay paused, until resumed
         }
+        onTimeoutCallback();
     }
 
-    std::chrono::duration<double> timeout;
-    bool resetFlag;
-    bool pauseFlag;
+    std::chrono::duration<double> timeout = std::chrono::duration<double>::zero();
+    std::atomic<std::chrono::steady_clock::rep> last_reset = 0;
+    bool paused = true;
+    int timer_fd = -1;
     std::mutex mtx;
-    std::condition_variable cv;
-    std::jthread watchdogThread;
 
-public:
+  public:
     std::function<void()> onTimeoutCallback;
-
-};
\ No newline at end of file
+};
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "nlohmann/json.hpp"
+#include "points.hpp"
+#include "telemetry.hpp"
+
+// Behaviour of the REMA RTU as seen from the proxy: executes the JSON commands and moves the axes over time.
+// XY and Z are independent axis groups, each one moving in a straight line at a constant speed.
+// Closed loop moves can be made to stop early on the touch probe or to stall, at random, to exercise the
+// proxy's error paths.
+class RtuModel {
+  public:
+    struct Settings {
+        double speed = 100.0;            // Units per second, for both axis groups
+        double travel = 1000.0;          // Every axis can move between -travel and +travel
+        double probe_probability = 0.0;  // Chance that a closed loop move ends on the touch probe
+        double stall_probability = 0.0;  // Chance that a closed loop move stalls
+        unsigned int seed = 1;
+    };
+
+    explicit RtuModel(Settings settings);
+
+    // Result of one command, i.e. the value stored under the command name in the response
+    nlohmann::json execute(const std::string &cmd_name, const nlohmann::json &pars);
+
+    // Advances the simulation dt seconds
+    void step(double dt);
+
+    const struct telemetry &get_telemetry() const {
+        return telemetry_;
+    }
+
+    nlohmann::json get_temps() const;
+
+    // Log lines produced since the last call
+    std::vector<std::string> take_logs();
+
+  private:
+    enum class Group { XY, Z };
+
+    struct Motion {
+        bool active = false;
+        bool closed_loop = false;
+        double distance = 0;       // From the start of the move
+        double travelled = 0;
+        double stop_after = -1;    // Travelled distance at which the move ends on probe or stall, -1 for never
+        bool stop_on_probe = false;
+    };
+
+    nlohmann::json move(Group group, Point3D target, bool closed_loop, const std::string &cmd_name);
+
+    void step(Group group, double dt);
+
+    void finish(Group group, const std::string &reason);
+
+    void stop_all(const std::string &reason);
+
+    void update_limits();
+
+    void log(const std::string &line);
+
+    static Group parse_group(const nlohmann::json &pars);
+
+    Settings settings_;
+    struct telemetry telemetry_ {};
+    Motion motion_xy_;
+    Motion motion_z_;
+    bool probe_extended_ = false;
+    double elapsed_ = 0;
+    std::mt19937 rng_;
+    std::vector<std::string> logs_;
+};
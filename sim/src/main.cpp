@@ -0,0 +1,292 @@
+// Stand-in for the REMA RTU, so the proxy can be run, load tested and benchmarked without the hardware.
+// Listens on the same three ports as the RTU:
+//  - port:     JSON command arrays (sent back to back, not delimited), answered with one '\0' terminated JSON object
+//  - port + 1: msgpack telemetry frames at a fixed rate, with the temperatures every few frames
+//  - port + 2: '\0' terminated log lines
+// Everything runs on a single poll() loop.
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <boost/program_options.hpp>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <spdlog/spdlog.h>
+#include <string>
+#include <vector>
+
+#include "log_pattern.hpp"
+#include "nlohmann/json.hpp"
+#include "rtu_model.hpp"
+#include "rx_buffer.hpp"
+
+namespace po = boost::program_options;
+
+namespace {
+enum class Endpoint { COMMAND, TELEMETRY, LOGS };
+
+struct Client {
+    int fd;
+    Endpoint endpoint;
+    RxBuffer rx_buffer{ 4096 };
+};
+
+volatile std::sig_atomic_t stop_requested = 0;
+
+int listen_on(const std::string &host, int port) {
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+
+    int one = 1;
+    ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (::inet_pton(AF_INET, host.c_str(), &addr.sin_addr) != 1 ||
+        ::bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 || ::listen(fd, 4) < 0) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool send_all(int fd, const void *data, size_t size) {
+    const char *ptr = static_cast<const char *>(data);
+    while (size > 0) {
+        ssize_t n = ::send(fd, ptr, size, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        ptr += n;
+        size -= n;
+    }
+    return true;
+}
+
+// The proxy does not delimit its command frames, so a frame ends where its top level JSON array closes.
+// Returns the length of the first complete frame in bytes (including anything skipped before it), or 0.
+size_t complete_frame_length(std::string_view bytes) {
+    int depth = 0;
+    bool in_string = false;
+    bool escaped = false;
+    for (size_t i = 0; i < bytes.size(); i++) {
+        char c = bytes[i];
+        if (in_string) {
+            if (escaped) {
+                escaped = false;
+            } else if (c == '\\') {
+                escaped = true;
+            } else if (c == '"') {
+                in_string = false;
+            }
+        } else if (c == '"') {
+            in_string = true;
+        } else if (c == '[' || c == '{') {
+            depth++;
+        } else if ((c == ']' || c == '}') && --depth == 0) {
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+// Executes every command of the frame and answers with a single object keyed by command name, like the RTU
+std::string execute_frame(RtuModel &model, std::string_view frame) {
+    nlohmann::json response = nlohmann::json::object();
+    frame.remove_prefix(std::min(frame.size(), frame.find_first_not_of(std::string_view(" \t\r\n\0", 5))));
+    try {
+        nlohmann::json commands = nlohmann::json::parse(frame);
+        for (const auto &command : commands) {
+            std::string cmd_name = command.at("cmd");
+            response[cmd_name] = model.execute(cmd_name, command.value("pars", nlohmann::json()));
+        }
+    } catch (std::exception &e) {
+        SPDLOG_WARN("Malformed command frame: {}", e.what());
+        response["error"] = e.what();
+    }
+    return response.dump();
+}
+} // namespace
+
+int main(int argc, char *argv[]) {
+    spdlog::set_pattern(log_pattern);
+
+    std::string host;
+    int port;
+    double telemetry_hz;
+    int temps_every;
+    RtuModel::Settings settings;
+
+    po::options_description options("REMA RTU simulator");
+    options.add_options()("help,h", "Show this help")(
+        "host", po::value(&host)->default_value("127.0.0.1"), "Address to listen on")(
+        "port", po::value(&port)->default_value(5020), "Command port, telemetry and logs use the next two")(
+        "telemetry-hz", po::value(&telemetry_hz)->default_value(20.0), "Telemetry frames per second")(
+        "temps-every", po::value(&temps_every)->default_value(10), "Include the temperatures every N telemetry frames")(
+        "speed", po::value(&settings.speed)->default_value(settings.speed), "Axis speed, in units per second")(
+        "travel", po::value(&settings.travel)->default_value(settings.travel), "Limit switches are at +/- travel")(
+        "probe-probability",
+        po::value(&settings.probe_probability)->default_value(settings.probe_probability),
+        "Chance that a closed loop move stops on the touch probe (when extended)")(
+        "stall-probability",
+        po::value(&settings.stall_probability)->default_value(settings.stall_probability),
+        "Chance that a closed loop move stalls (when stall control is enabled)")(
+        "seed", po::value(&settings.seed)->default_value(settings.seed), "Random seed for the probe and stall faults");
+
+    po::variables_map vm;
+    try {
+        po::store(po::parse_command_line(argc, argv, options), vm);
+        po::notify(vm);
+    } catch (std::exception &e) {
+        std::cerr << e.what() << "\n" << options << "\n";
+        return 1;
+    }
+    if (vm.count("help")) {
+        std::cout << options << "\n";
+        return 0;
+    }
+
+    std::signal(SIGINT, [](int) { stop_requested = 1; });
+    std::signal(SIGTERM, [](int) { stop_requested = 1; });
+
+    std::vector<std::pair<int, Endpoint>> listeners;
+    for (auto [offset, endpoint] : { std::pair{ 0, Endpoint::COMMAND },
+                                     std::pair{ 1, Endpoint::TELEMETRY },
+                                     std::pair{ 2, Endpoint::LOGS } }) {
+        int fd = listen_on(host, port + offset);
+        if (fd < 0) {
+            SPDLOG_ERROR("Unable to listen on {}:{}: {}", host, port + offset, std::strerror(errno));
+            return 1;
+        }
+        listeners.emplace_back(fd, endpoint);
+    }
+    SPDLOG_INFO("RTU simulator listening on {}:{}-{}", host, port, port + 2);
+
+    RtuModel model(settings);
+    std::vector<std::unique_ptr<Client>> clients;
+    const auto telemetry_period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(1.0 / telemetry_hz));
+    auto last_step = std::chrono::steady_clock::now();
+    auto next_telemetry = last_step + telemetry_period;
+    int telemetry_frames = 0;
+
+    auto drop_client = [&](Client &client) {
+        SPDLOG_INFO("Client {} disconnected", client.fd);
+        ::close(client.fd);
+        client.fd = -1;
+    };
+
+    auto broadcast = [&](Endpoint endpoint, const void *data, size_t size) {
+        for (auto &client : clients) {
+            if (client->fd >= 0 && client->endpoint == endpoint && !send_all(client->fd, data, size)) {
+                drop_client(*client);
+            }
+        }
+    };
+
+    while (!stop_requested) {
+        std::vector<pollfd> pfds;
+        for (auto [fd, endpoint] : listeners) {
+            pfds.push_back({ fd, POLLIN, 0 });
+        }
+        for (auto &client : clients) {
+            pfds.push_back({ client->fd, POLLIN, 0 });
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        int timeout_ms = static_cast<int>(
+            std::max<int64_t>(0, std::chrono::ceil<std::chrono::milliseconds>(next_telemetry - now).count()));
+        if (::poll(pfds.data(), pfds.size(), timeout_ms) < 0 && errno != EINTR) {
+            SPDLOG_ERROR("poll: {}", std::strerror(errno));
+            break;
+        }
+
+        for (size_t i = 0; i < listeners.size(); i++) {
+            if (pfds[i].revents & POLLIN) {
+                int fd = ::accept(listeners[i].first, nullptr, nullptr);
+                if (fd >= 0) {
+                    int one = 1;
+                    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                    SPDLOG_INFO("Client {} connected to port {}", fd, port + static_cast<int>(i));
+                    clients.push_back(std::make_unique<Client>(Client{ fd, listeners[i].second }));
+                }
+            }
+        }
+
+        for (size_t i = listeners.size(); i < pfds.size(); i++) {
+            if (!pfds[i].revents) {
+                continue;
+            }
+            Client &client = *clients[i - listeners.size()];
+            char *dst = client.rx_buffer.prepare(4096);
+            ssize_t n = ::recv(client.fd, dst, client.rx_buffer.free_space(), MSG_DONTWAIT);
+            if (n <= 0) {
+                if (n == 0 || (errno != EAGAIN && errno != EINTR)) {
+                    drop_client(client);
+                }
+                continue;
+            }
+            client.rx_buffer.commit(n);
+            if (client.endpoint != Endpoint::COMMAND) {
+                client.rx_buffer.clear(); // Nothing is expected from telemetry and logs clients
+                continue;
+            }
+
+            while (size_t length = complete_frame_length(client.rx_buffer.pending())) {
+                std::string response = execute_frame(model, client.rx_buffer.pending().substr(0, length));
+                client.rx_buffer.consume(length);
+                if (!send_all(client.fd, response.c_str(), response.size() + 1)) { // Including the '\0'
+                    drop_client(client);
+                    break;
+                }
+            }
+        }
+
+        now = std::chrono::steady_clock::now();
+        model.step(std::chrono::duration<double>(now - last_step).count());
+        last_step = now;
+
+        if (now >= next_telemetry) {
+            nlohmann::json frame;
+            frame["telemetry"] = model.get_telemetry();
+            if (temps_every > 0 && ++telemetry_frames % temps_every == 0) {
+                frame["temps"] = model.get_temps();
+            }
+            std::vector<uint8_t> msgpack = nlohmann::json::to_msgpack(frame);
+            broadcast(Endpoint::TELEMETRY, msgpack.data(), msgpack.size());
+
+            next_telemetry += telemetry_period;
+            if (next_telemetry < now) {
+                next_telemetry = now + telemetry_period; // Fell behind, do not send a burst to catch up
+            }
+        }
+
+        for (const auto &line : model.take_logs()) {
+            broadcast(Endpoint::LOGS, line.c_str(), line.size() + 1);
+        }
+
+        std::erase_if(clients, [](const std::unique_ptr<Client> &client) { return client->fd < 0; });
+    }
+
+    for (auto &client : clients) {
+        ::close(client->fd);
+    }
+    for (auto [fd, endpoint] : listeners) {
+        ::close(fd);
+    }
+    SPDLOG_INFO("RTU simulator stopped");
+    return 0;
+}
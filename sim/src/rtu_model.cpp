@@ -0,0 +1,252 @@
+#include <algorithm>
+#include <cmath>
+#include <spdlog/spdlog.h>
+
+#include "rtu_model.hpp"
+
+namespace {
+nlohmann::json ack() {
+    return { { "ACK", true } };
+}
+
+nlohmann::json error(const std::string &message) {
+    return { { "error", message } };
+}
+} // namespace
+
+RtuModel::RtuModel(Settings settings) : settings_(settings), rng_(settings.seed) {
+    telemetry_.control_enabled = true;
+}
+
+RtuModel::Group RtuModel::parse_group(const nlohmann::json &pars) {
+    return pars.value("axes", "XY") == "Z" ? Group::Z : Group::XY;
+}
+
+nlohmann::json RtuModel::execute(const std::string &cmd_name, const nlohmann::json &pars) {
+    if (cmd_name == "AXES_SOFT_STOP_ALL" || cmd_name == "AXES_HARD_STOP_ALL") {
+        stop_all(cmd_name);
+        return ack();
+    }
+
+    if (cmd_name == "MOVE_CLOSED_LOOP" || cmd_name == "MOVE_JOYSTICK" || cmd_name == "MOVE_INCREMENTAL") {
+        if (!telemetry_.control_enabled) {
+            return error("CONTROL IS DISABLED");
+        }
+
+        Group group = parse_group(pars);
+        bool incremental = cmd_name == "MOVE_INCREMENTAL";
+        const char *first = incremental ? "first_axis_delta" : "first_axis_setpoint";
+        const char *second = incremental ? "second_axis_delta" : "second_axis_setpoint";
+
+        // Axes without a setpoint keep their position (a joystick move only names the axis being jogged)
+        Point3D target = cmd_name == "MOVE_CLOSED_LOOP" ? telemetry_.targets : telemetry_.coords;
+        if (group == Group::XY) {
+            target.x = incremental ? telemetry_.coords.x + pars.value(first, 0.0) : pars.value(first, target.x);
+            target.y = incremental ? telemetry_.coords.y + pars.value(second, 0.0) : pars.value(second, target.y);
+        } else {
+            target.z = incremental ? telemetry_.coords.z + pars.value(first, 0.0) : pars.value(first, target.z);
+        }
+        return move(group, target, cmd_name != "MOVE_JOYSTICK", cmd_name);
+    }
+
+    if (cmd_name == "SET_COORDS") {
+        telemetry_.coords.x = telemetry_.targets.x = pars.value("position_X", telemetry_.coords.x);
+        telemetry_.coords.y = telemetry_.targets.y = pars.value("position_Y", telemetry_.coords.y);
+        telemetry_.coords.z = telemetry_.targets.z = pars.value("position_Z", telemetry_.coords.z);
+        update_limits();
+        return ack();
+    }
+
+    if (cmd_name == "TOUCH_PROBE") {
+        probe_extended_ = pars.value("position", "RETRACT") == "EXTEND";
+        log(fmt::format("Touch probe {}", probe_extended_ ? "extended" : "retracted"));
+        return ack();
+    }
+
+    if (cmd_name == "STALL_CONTROL_SETTINGS") {
+        telemetry_.stall_control = pars.value("enabled", telemetry_.stall_control);
+        return ack();
+    }
+
+    if (cmd_name == "AXES_SETTINGS" || cmd_name == "TOUCH_PROBE_SETTINGS") {
+        return ack();
+    }
+
+    if (cmd_name == "NETWORK_SETTINGS") {
+        if (pars.is_null()) {
+            return { { "ipaddr", "127.0.0.1" }, { "port", 5020 }, { "gw", "127.0.0.1" }, { "netmask", "255.0.0.0" } };
+        }
+        log("Network settings are not applied by the simulator");
+        return ack();
+    }
+
+    return error("UNKNOWN COMMAND");
+}
+
+nlohmann::json RtuModel::move(Group group, Point3D target, bool closed_loop, const std::string &cmd_name) {
+    Motion &motion = group == Group::XY ? motion_xy_ : motion_z_;
+    motion = Motion();
+    motion.active = true;
+    motion.closed_loop = closed_loop;
+
+    if (group == Group::XY) {
+        telemetry_.targets.x = target.x;
+        telemetry_.targets.y = target.y;
+        telemetry_.on_condition.x_y = false;
+        telemetry_.probe.x_y = false;
+        telemetry_.stalled.x = telemetry_.stalled.y = false;
+        motion.distance = telemetry_.coords.distance_xy(target);
+    } else {
+        telemetry_.targets.z = target.z;
+        telemetry_.on_condition.z = false;
+        telemetry_.probe.z = false;
+        telemetry_.stalled.z = false;
+        motion.distance = std::fabs(target.z - telemetry_.coords.z);
+    }
+    telemetry_.limits.probe = false;
+
+    if (closed_loop) {
+        std::uniform_real_distribution<double> chance(0.0, 1.0);
+        std::uniform_real_distribution<double> where(0.2, 0.9);
+        if (probe_extended_ && chance(rng_) < settings_.probe_probability) {
+            motion.stop_after = motion.distance * where(rng_);
+            motion.stop_on_probe = true;
+        } else if (telemetry_.stall_control && chance(rng_) < settings_.stall_probability) {
+            motion.stop_after = motion.distance * where(rng_);
+        }
+    }
+
+    log(fmt::format(
+        "{} {} to ({}, {}, {})",
+        cmd_name,
+        group == Group::XY ? "XY" : "Z",
+        telemetry_.targets.x,
+        telemetry_.targets.y,
+        telemetry_.targets.z));
+    return ack();
+}
+
+void RtuModel::step(double dt) {
+    elapsed_ += dt;
+    step(Group::XY, dt);
+    step(Group::Z, dt);
+}
+
+void RtuModel::step(Group group, double dt) {
+    Motion &motion = group == Group::XY ? motion_xy_ : motion_z_;
+    if (!motion.active) {
+        return;
+    }
+
+    double remaining = motion.distance - motion.travelled;
+    double advance = settings_.speed * dt;
+    bool fault = false;
+    if (motion.stop_after >= 0 && motion.travelled + advance >= motion.stop_after) {
+        advance = motion.stop_after - motion.travelled;
+        fault = true;
+    }
+    bool arrived = !fault && advance >= remaining;
+    advance = std::min(advance, remaining);
+
+    Point3D &coords = telemetry_.coords;
+    const Point3D &targets = telemetry_.targets;
+    double fraction = remaining > 0 ? advance / remaining : 1.0;
+    if (group == Group::XY) {
+        coords.x += (targets.x - coords.x) * fraction;
+        coords.y += (targets.y - coords.y) * fraction;
+    } else {
+        coords.z += (targets.z - coords.z) * fraction;
+    }
+    motion.travelled += advance;
+
+    // The limit switches stop the group before it leaves the travel range
+    Point3D clamped(
+        std::clamp(coords.x, -settings_.travel, settings_.travel),
+        std::clamp(coords.y, -settings_.travel, settings_.travel),
+        std::clamp(coords.z, -settings_.travel, settings_.travel));
+    bool on_limit = clamped != coords;
+    coords = clamped;
+    update_limits();
+
+    if (on_limit) {
+        finish(group, "limit switch");
+    } else if (fault && motion.stop_on_probe) {
+        (group == Group::XY ? telemetry_.probe.x_y : telemetry_.probe.z) = true;
+        telemetry_.limits.probe = true;
+        finish(group, "touch probe");
+    } else if (fault) {
+        if (group == Group::XY) {
+            (std::fabs(targets.x - coords.x) >= std::fabs(targets.y - coords.y) ? telemetry_.stalled.x
+                                                                                 : telemetry_.stalled.y) = true;
+        } else {
+            telemetry_.stalled.z = true;
+        }
+        finish(group, "stall");
+    } else if (arrived) {
+        if (motion.closed_loop) {
+            (group == Group::XY ? telemetry_.on_condition.x_y : telemetry_.on_condition.z) = true;
+        }
+        finish(group, "setpoint reached");
+    }
+}
+
+void RtuModel::finish(Group group, const std::string &reason) {
+    Motion &motion = group == Group::XY ? motion_xy_ : motion_z_;
+    motion.active = false;
+
+    // A stopped group holds its position
+    if (group == Group::XY) {
+        telemetry_.targets.x = telemetry_.coords.x;
+        telemetry_.targets.y = telemetry_.coords.y;
+    } else {
+        telemetry_.targets.z = telemetry_.coords.z;
+    }
+
+    log(fmt::format(
+        "{} stopped on {} at ({}, {}, {})",
+        group == Group::XY ? "XY" : "Z",
+        reason,
+        telemetry_.coords.x,
+        telemetry_.coords.y,
+        telemetry_.coords.z));
+}
+
+void RtuModel::stop_all(const std::string &reason) {
+    if (motion_xy_.active) {
+        finish(Group::XY, reason);
+    }
+    if (motion_z_.active) {
+        finish(Group::Z, reason);
+    }
+}
+
+void RtuModel::update_limits() {
+    const Point3D &coords = telemetry_.coords;
+    telemetry_.limits.left = coords.x <= -settings_.travel;
+    telemetry_.limits.right = coords.x >= settings_.travel;
+    telemetry_.limits.down = coords.y <= -settings_.travel;
+    telemetry_.limits.up = coords.y >= settings_.travel;
+    telemetry_.limits.out = coords.z <= -settings_.travel;
+    telemetry_.limits.in = coords.z >= settings_.travel;
+}
+
+// Slow drift around room temperature, the motors warm up while moving
+nlohmann::json RtuModel::get_temps() const {
+    double base = 25.0 + std::sin(elapsed_ / 60.0);
+    return {
+        { "x", base + (motion_xy_.active ? 2.0 : 0.0) },
+        { "y", base + (motion_xy_.active ? 2.0 : 0.0) },
+        { "z", base + (motion_z_.active ? 2.0 : 0.0) },
+    };
+}
+
+std::vector<std::string> RtuModel::take_logs() {
+    std::vector<std::string> logs;
+    logs.swap(logs_);
+    return logs;
+}
+
+void RtuModel::log(const std::string &line) {
+    SPDLOG_INFO(line);
+    logs_.push_back(line);
+}
@@ -2,12 +2,23 @@
 #include <map>
 
 #include "HX.hpp"
+#include "hx_cache.hpp"
 #include "spdlog/spdlog.h"
 
 const std::filesystem::path HX::hxs_path = "./HXs";
 
-void HX::process_csv_from_disk(std::string hx) {
+void HX::load_from_disk(std::string hx) {
     load_config_from_disk(hx);
+    if (load_hx_cache(*this, hx)) {
+        SPDLOG_INFO("HX {} loaded from its cache, {} tubes", hx, tubes.size());
+        return;
+    }
+    process_csv_from_disk(hx);
+    generate_svg();
+    store_hx_cache(*this, hx);
+}
+
+void HX::process_csv_from_disk(std::string hx) {
     std::filesystem::path csv_file = hxs_path / hx / "tubesheet.csv";
     SPDLOG_INFO("Reading {}", csv_file.string());
 
@@ -22,15 +33,18 @@ void HX::process_csv(std::string hx_name, std::istream &stream) {
     std::string x_label, y_label;
     float cl_x, cl_y, hl_x, hl_y;
     std::string tube_id;
+    tubes.clear(); // Nothing left from a previous load survives into the cache
+    svg.x_labels.clear();
+    svg.y_labels.clear();
     while (in.read_row(x_label, y_label, cl_x, cl_y, hl_x, hl_y, tube_id)) {
         if (leg == "cold" || leg == "both") {
-            tubes.insert({ std::string("CL_") + tube_id.substr(5), { x_label, y_label, { cl_x, cl_y, 0 } } });
+            tubes.add(std::string("CL_") + tube_id.substr(5), x_label, y_label, { cl_x, cl_y, 0 });
             svg.x_labels.insert(std::make_pair(x_label, cl_x));
             svg.y_labels.insert(std::make_pair(y_label, cl_y));
         }
 
         if (leg == "hot" || leg == "both") {
-            tubes.insert({ std::string("HL_") + tube_id.substr(5), { x_label, y_label, { hl_x, hl_y, 0 } } });
+            tubes.add(std::string("HL_") + tube_id.substr(5), x_label, y_label, { hl_x, hl_y, 0 });
             svg.x_labels.insert(std::make_pair(x_label, hl_x));
             svg.y_labels.insert(std::make_pair(y_label, hl_y));
         }
@@ -41,94 +55,54 @@ void HX::generate_svg() {
     SPDLOG_INFO("Generating SVG...");
 
     float tube_r = tube_od / 2;
-
-    // Create the SVG document
-    rapidxml::xml_document<char> document;
-    rapidxml::xml_document<char>* doc = &document;
-    auto* svg_node = doc->allocate_node(rapidxml::node_type::node_element, "svg");
-
-    append_attributes(
-        doc,
-        svg_node,
-        {
-            { "xmlns", "http://www.w3.org/2000/svg" },
-            { "version", "1.1" },
-            { "id", "tubesheet_svg" },
-            { "viewBox",
-              std::to_string(svg.min_x) + " " + std::to_string(svg.min_y) + " " + std::to_string(svg.width) + " " +
-                  std::to_string(svg.height) },
-        });
-
-    auto* style_node = doc->allocate_node(rapidxml::node_type::node_element, "style");
-    append_attributes(doc, style_node, { { "type", "text/css" } });
-
-    float stroke_width = stof(svg.font_size) / 10;
-
-    std::string style =
-        ".tube {stroke: black; stroke-width: " + std::to_string(stroke_width) + " ; fill: white;} " +
-        ".tube_num { text-anchor: middle; alignment-baseline: middle; font-family: sans-serif; font-size: " + svg.font_size +
-        "px; fill: black;}"
-        ".label { text-anchor: middle; alignment-baseline: middle; font-family: sans-serif; font-size: " +
-        svg.font_size + "; fill: red;}";
-
-    style_node->value(style.c_str());
-
-    svg_node->append_node(style_node);
-    doc->append_node(svg_node);
-
-    auto* cartesian_g_node = doc->allocate_node(rapidxml::node_type::node_element, "g");
-    append_attributes(doc, cartesian_g_node, { { "id", "cartesian" }, { "transform", "scale(1,-1)" } });
-    svg_node->append_node(cartesian_g_node);
-
-    auto* x_axis = add_dashed_line(doc, 0, svg.min_y, 0, svg.min_y + svg.height, stof(svg.font_size));
-    auto* y_axis = add_dashed_line(doc, svg.min_x, 0, svg.min_x + svg.width, 0, stof(svg.font_size));
-    cartesian_g_node->append_node(x_axis);
-    cartesian_g_node->append_node(y_axis);
+    float font_size = std::stof(svg.font_size);
+    float stroke_width = font_size / 10;
+
+    size_t labels = svg.config_x_labels_coords.size() * svg.x_labels.size() +
+                    svg.config_y_labels_coords.size() * svg.y_labels.size();
+    SvgWriter writer(1024 + tubes.size() * 320 + labels * 128);
+
+    writer.raw("<svg xmlns=\"http://www.w3.org/2000/svg\" version=\"1.1\" id=\"tubesheet_svg\" viewBox=\"");
+    writer.number(svg.min_x).raw(" ").number(svg.min_y).raw(" ").number(svg.width).raw(" ").number(svg.height);
+    writer.raw("\">\n<style type=\"text/css\">");
+    writer.raw(".tube {stroke: black; stroke-width: ").number(stroke_width).raw(" ; fill: white;} ");
+    writer.raw(".tube_num { text-anchor: middle; alignment-baseline: middle; font-family: sans-serif; font-size: ");
+    writer.text(svg.font_size).raw("px; fill: black;}");
+    writer.raw(".label { text-anchor: middle; alignment-baseline: middle; font-family: sans-serif; font-size: ");
+    writer.text(svg.font_size).raw("; fill: red;}</style>\n");
+
+    writer.raw("<g id=\"cartesian\" transform=\"scale(1,-1)\">\n");
+    writer.dashed_line(0, svg.min_y, 0, svg.min_y + svg.height, font_size);
+    writer.dashed_line(svg.min_x, 0, svg.min_x + svg.width, 0, font_size);
 
     for (const auto &config_coord : svg.config_x_labels_coords) {
-        for (auto [label, coord] : svg.x_labels) {
-            auto* label_x = add_label(doc, coord, std::stof(config_coord), label.c_str());
-            append_attributes(
-                doc,
-                label_x,
-                {
-                    { "transform-origin", std::to_string(coord) + " " + config_coord },
-                    { "transform", "scale(1, -1) rotate(270)" },
-                });
-            cartesian_g_node->append_node(label_x);
+        float y = std::stof(config_coord);
+        for (const auto &[label, coord] : svg.x_labels) {
+            writer.label(coord, y, label, "scale(1, -1) rotate(270)");
         }
     }
 
     for (const auto &config_coord : svg.config_y_labels_coords) {
-        for (auto [label, coord] : svg.y_labels) {
-            auto* label_y = add_label(doc, std::stof(config_coord), coord, label.c_str());
-            append_attributes(
-                doc,
-                label_y,
-                {
-                    { "transform-origin", config_coord + " " + std::to_string(coord) },
-                    { "transform", "scale(1, -1)" },
-                });
-            cartesian_g_node->append_node(label_y);
+        float x = std::stof(config_coord);
+        for (const auto &[label, coord] : svg.y_labels) {
+            writer.label(x, coord, label, "scale(1, -1)");
         }
     }
 
-    // Create an SVG circle element for each tube in the CSV data
-    for (const auto &tube_pair : tubes) {
-        auto tube = tube_pair.second;
-
-        auto* tube_node = add_tube(doc, tube, tube_pair.first, tube_r);
-        cartesian_g_node->append_node(tube_node);
+    // One group per tube: tooltip, circle and number
+    const auto &xs = tubes.x();
+    const auto &ys = tubes.y();
+    for (TubeTable::TubeId tube = 0; tube < tubes.size(); tube++) {
+        writer.tube(tubes.id(tube),
+                    tubes.x_label(tube),
+                    tubes.y_label(tube),
+                    static_cast<float>(xs[tube]),
+                    static_cast<float>(ys[tube]),
+                    tube_r);
     }
 
-    // Write the SVG document to a file
-    // std::filesystem::path svg_path = hxs_path / hx / "tubesheet.svg";
-    // std::ofstream file(svg_path);
-    // file << document;
-
-    std::ostringstream stream;
-    stream << document;
-    tubesheet_svg = stream.str();
+    writer.raw("</g>\n</svg>\n");
+    tubesheet_svg = std::move(writer).str();
 }
 
 void HX::load_config_from_disk(std::string hx) {
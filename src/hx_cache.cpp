@@ -0,0 +1,216 @@
+#include <cstring>
+#include <fstream>
+#include <spdlog/spdlog.h>
+#include <string_view>
+#include <vector>
+
+#include "hx_cache.hpp"
+
+namespace {
+constexpr char Magic[8] = { 'R', 'E', 'M', 'A', 'H', 'X', 'C', '1' };
+constexpr uint32_t Version = 2; // Bump when the layout or generate_svg() output changes
+
+struct SourceStamp {
+    int64_t write_time = 0;
+    uint64_t size = 0;
+
+    bool operator==(const SourceStamp &) const = default;
+};
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order; // 0x01020304 as written
+    SourceStamp csv;
+    SourceStamp config;
+    uint64_t tubes;
+    uint64_t x_labels;
+    uint64_t y_labels;
+    uint64_t strings_size;
+    uint64_t svg_size;
+};
+
+struct StringRef {
+    uint32_t offset;
+    uint32_t length;
+};
+
+struct TubeRecord {
+    StringRef id;
+    StringRef x_label;
+    StringRef y_label;
+    uint32_t padding;
+    double x, y, z;
+};
+
+struct LabelRecord {
+    StringRef label;
+    float coord;
+    uint32_t padding;
+};
+
+// Header, tube records, x label records, y label records, strings, SVG
+static_assert(sizeof(Header) % 8 == 0 && sizeof(TubeRecord) % 8 == 0 && sizeof(LabelRecord) % 8 == 0);
+
+std::filesystem::path cache_path(const std::filesystem::path &hx_dir) {
+    return HX::hxs_path / hx_dir / "tubesheet.cache";
+}
+
+SourceStamp stamp(const std::filesystem::path &file) {
+    std::error_code ec;
+    SourceStamp res;
+    res.size = std::filesystem::file_size(file, ec);
+    if (!ec) {
+        res.write_time = std::filesystem::last_write_time(file, ec).time_since_epoch().count();
+    }
+    return ec ? SourceStamp{} : res;
+}
+
+// Everything in the cache is copied into the HX (the tube table owns its strings), so it is read with plain reads:
+// a mapping would save nothing. Empty when the file is missing or could not be read whole.
+std::string read_file(const std::filesystem::path &file) {
+    std::error_code ec;
+    auto size = std::filesystem::file_size(file, ec);
+    std::ifstream in(file, std::ios::binary);
+    if (ec || !in) {
+        return {};
+    }
+    std::string data(size, '\0');
+    if (!in.read(data.data(), static_cast<std::streamsize>(size))) {
+        return {};
+    }
+    return data;
+}
+
+class StringTable {
+  public:
+    StringRef add(const std::string &str) {
+        StringRef ref{ static_cast<uint32_t>(data.size()), static_cast<uint32_t>(str.size()) };
+        data += str;
+        return ref;
+    }
+
+    std::string data;
+};
+
+template <typename T> void write_pod(std::ofstream &out, const T &value) {
+    out.write(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+} // namespace
+
+bool load_hx_cache(HX &hx, const std::filesystem::path &hx_dir) {
+    std::string file = read_file(cache_path(hx_dir));
+    if (file.size() < sizeof(Header)) {
+        return false;
+    }
+
+    Header header;
+    std::memcpy(&header, file.data(), sizeof(Header));
+    if (std::memcmp(header.magic, Magic, sizeof(Magic)) != 0 || header.version != Version ||
+        header.byte_order != 0x01020304) {
+        return false;
+    }
+    if (header.csv != stamp(HX::hxs_path / hx_dir / "tubesheet.csv") ||
+        header.config != stamp(HX::hxs_path / hx_dir / "config.json")) {
+        SPDLOG_INFO("HX cache of {} is out of date", hx_dir.string());
+        return false;
+    }
+
+    const uint64_t tubes_offset = sizeof(Header);
+    const uint64_t labels_offset = tubes_offset + header.tubes * sizeof(TubeRecord);
+    const uint64_t strings_offset = labels_offset + (header.x_labels + header.y_labels) * sizeof(LabelRecord);
+    const uint64_t svg_offset = strings_offset + header.strings_size;
+    if (svg_offset + header.svg_size != file.size()) {
+        SPDLOG_WARN("HX cache of {} is corrupt", hx_dir.string());
+        return false;
+    }
+
+    std::string_view strings(file.data() + strings_offset, header.strings_size);
+    auto str = [&](StringRef ref) {
+        if (static_cast<uint64_t>(ref.offset) + ref.length > strings.size()) {
+            throw std::out_of_range("string out of the table");
+        }
+        return std::string(strings.substr(ref.offset, ref.length));
+    };
+
+    // Read into a copy: hx stays as it was if the file turns out to be inconsistent
+    TubeTable tubes;
+    std::set<std::pair<std::string, float>> x_labels, y_labels;
+    try {
+        tubes.reserve(header.tubes);
+        for (uint64_t i = 0; i < header.tubes; i++) {
+            TubeRecord record;
+            std::memcpy(&record, file.data() + tubes_offset + i * sizeof(TubeRecord), sizeof(TubeRecord));
+            tubes.add(str(record.id), str(record.x_label), str(record.y_label), { record.x, record.y, record.z });
+        }
+        for (uint64_t i = 0; i < header.x_labels + header.y_labels; i++) {
+            LabelRecord record;
+            std::memcpy(&record, file.data() + labels_offset + i * sizeof(LabelRecord), sizeof(LabelRecord));
+            (i < header.x_labels ? x_labels : y_labels).emplace(str(record.label), record.coord);
+        }
+    } catch (const std::exception &e) {
+        SPDLOG_WARN("HX cache of {} is corrupt: {}", hx_dir.string(), e.what());
+        return false;
+    }
+
+    hx.tubes = std::move(tubes);
+    hx.svg.x_labels = std::move(x_labels);
+    hx.svg.y_labels = std::move(y_labels);
+    hx.tubesheet_svg.assign(file.data() + svg_offset, header.svg_size);
+    return true;
+}
+
+void store_hx_cache(const HX &hx, const std::filesystem::path &hx_dir) {
+    Header header{};
+    std::memcpy(header.magic, Magic, sizeof(Magic));
+    header.version = Version;
+    header.byte_order = 0x01020304;
+    header.csv = stamp(HX::hxs_path / hx_dir / "tubesheet.csv");
+    header.config = stamp(HX::hxs_path / hx_dir / "config.json");
+    header.tubes = hx.tubes.size();
+    header.x_labels = hx.svg.x_labels.size();
+    header.y_labels = hx.svg.y_labels.size();
+    header.svg_size = hx.tubesheet_svg.size();
+
+    StringTable strings;
+    std::vector<TubeRecord> tube_records;
+    tube_records.reserve(hx.tubes.size());
+    for (TubeTable::TubeId tube = 0; tube < hx.tubes.size(); tube++) {
+        Point3D coords = hx.tubes.coords(tube);
+        tube_records.push_back({ strings.add(hx.tubes.id(tube)),
+                                 strings.add(hx.tubes.x_label(tube)),
+                                 strings.add(hx.tubes.y_label(tube)),
+                                 0,
+                                 coords.x,
+                                 coords.y,
+                                 coords.z });
+    }
+    std::vector<LabelRecord> label_records;
+    for (const auto *labels : { &hx.svg.x_labels, &hx.svg.y_labels }) {
+        for (const auto &[label, coord] : *labels) {
+            label_records.push_back({ strings.add(label), coord, 0 });
+        }
+    }
+    header.strings_size = strings.data.size();
+
+    std::filesystem::path file = cache_path(hx_dir);
+    std::filesystem::path tmp_file = file;
+    tmp_file += ".tmp";
+    {
+        std::ofstream out(tmp_file, std::ios::binary | std::ios::trunc);
+        write_pod(out, header);
+        out.write(reinterpret_cast<const char *>(tube_records.data()), tube_records.size() * sizeof(TubeRecord));
+        out.write(reinterpret_cast<const char *>(label_records.data()), label_records.size() * sizeof(LabelRecord));
+        out.write(strings.data.data(), static_cast<std::streamsize>(strings.data.size()));
+        out.write(hx.tubesheet_svg.data(), static_cast<std::streamsize>(hx.tubesheet_svg.size()));
+        if (!out.flush()) {
+            SPDLOG_WARN("HX cache of {} not written", hx_dir.string());
+            return;
+        }
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmp_file, file, ec);
+    if (ec) {
+        SPDLOG_WARN("HX cache of {} not written: {}", hx_dir.string(), ec.message());
+    }
+}
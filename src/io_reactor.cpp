@@ -0,0 +1,191 @@
+#include <spdlog/spdlog.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <vector>
+
+#include "io_reactor.hpp"
+
+IoReactor::IoReactor() {
+    epoll_fd = ::epoll_create1(EPOLL_CLOEXEC);
+    wakeup_fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epoll_fd < 0 || wakeup_fd < 0) {
+        SPDLOG_ERROR("Unable to create I/O reactor: {}", std::strerror(errno));
+        return;
+    }
+
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.u64 = 0; // Registration ids start at 1, 0 is the wakeup eventfd
+    ::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wakeup_fd, &ev);
+
+    thd = std::jthread([this](std::stop_token stop_token) { loop(stop_token); });
+}
+
+IoReactor::~IoReactor() {
+    thd.request_stop();
+    wake();
+    if (thd.joinable()) {
+        thd.join();
+    }
+
+    for (auto &[id, registration] : registrations) {
+        if (registration.fd >= 0) {
+            ::close(registration.fd);
+        }
+    }
+    ::close(wakeup_fd);
+    ::close(epoll_fd);
+}
+
+void IoReactor::add(int fd, uint32_t events, Handler handler) {
+    uint64_t id;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        id = ++last_registration_id;
+        registrations[id] = { fd, std::make_shared<Handler>(std::move(handler)) };
+        registration_by_fd[fd] = id;
+    }
+
+    epoll_event ev{};
+    ev.events = events;
+    ev.data.u64 = id;
+    if (::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        SPDLOG_ERROR("Unable to register fd {} in I/O reactor: {}", fd, std::strerror(errno));
+    }
+}
+
+void IoReactor::remove(int fd) {
+    ::epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+
+    std::lock_guard<std::mutex> lock(mtx);
+    if (auto it = registration_by_fd.find(fd); it != registration_by_fd.end()) {
+        registrations.erase(it->second);
+        registration_by_fd.erase(it);
+    }
+}
+
+void IoReactor::remove_and_close(int fd) {
+    if (in_reactor_thread()) {
+        remove(fd);
+        ::close(fd);
+    } else {
+        post([this, fd] {
+            remove(fd);
+            ::close(fd);
+        });
+    }
+}
+
+int IoReactor::add_timer(Task on_expired) {
+    int timer_fd = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timer_fd < 0) {
+        SPDLOG_ERROR("Unable to create timer: {}", std::strerror(errno));
+        return -1;
+    }
+
+    add(timer_fd, EPOLLIN, [timer_fd, on_expired = std::move(on_expired)](uint32_t) {
+        uint64_t expirations;
+        if (::read(timer_fd, &expirations, sizeof(expirations)) == sizeof(expirations)) {
+            on_expired();
+        }
+    });
+    return timer_fd;
+}
+
+void IoReactor::arm_timer(int timer_fd, std::chrono::nanoseconds timeout) {
+    if (timeout <= std::chrono::nanoseconds::zero()) {
+        timeout = std::chrono::nanoseconds(1); // A zero it_value would disarm the timer
+    }
+
+    itimerspec spec{};
+    spec.it_value.tv_sec = std::chrono::duration_cast<std::chrono::seconds>(timeout).count();
+    spec.it_value.tv_nsec = (timeout % std::chrono::seconds(1)).count();
+    ::timerfd_settime(timer_fd, 0, &spec, nullptr);
+}
+
+void IoReactor::disarm_timer(int timer_fd) {
+    itimerspec spec{};
+    ::timerfd_settime(timer_fd, 0, &spec, nullptr);
+}
+
+void IoReactor::remove_timer(int timer_fd) {
+    if (timer_fd >= 0) {
+        remove_and_close(timer_fd);
+    }
+}
+
+void IoReactor::post(Task task) {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        posted_tasks.push_back(std::move(task));
+    }
+    wake();
+}
+
+bool IoReactor::in_reactor_thread() const {
+    return std::this_thread::get_id() == thd.get_id();
+}
+
+void IoReactor::wake() {
+    uint64_t one = 1;
+    [[maybe_unused]] auto n = ::write(wakeup_fd, &one, sizeof(one));
+}
+
+void IoReactor::run_posted_tasks() {
+    std::deque<Task> tasks;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        tasks.swap(posted_tasks);
+    }
+
+    for (auto &task : tasks) {
+        task();
+    }
+}
+
+void IoReactor::loop(std::stop_token stop_token) {
+    constexpr int max_events = 16;
+    epoll_event events[max_events];
+
+    while (!stop_token.stop_requested()) {
+        int n = ::epoll_wait(epoll_fd, events, max_events, -1);
+        if (n < 0) {
+            if (errno != EINTR) {
+                SPDLOG_ERROR("I/O reactor epoll_wait: {}", std::strerror(errno));
+            }
+            continue;
+        }
+
+        for (int i = 0; i < n; i++) {
+            uint64_t id = events[i].data.u64;
+            if (id == 0) {
+                uint64_t count;
+                [[maybe_unused]] auto r = ::read(wakeup_fd, &count, sizeof(count));
+                run_posted_tasks();
+                continue;
+            }
+
+            std::shared_ptr<Handler> handler;
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                if (auto it = registrations.find(id); it != registrations.end()) {
+                    handler = it->second.handler;
+                }
+            }
+
+            // The registration may have been removed by an earlier handler of this same batch
+            if (handler) {
+                try {
+                    (*handler)(events[i].events);
+                } catch (std::exception &e) {
+                    SPDLOG_ERROR("I/O reactor handler error: {}", e.what());
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,150 @@
+#include <future>
+#include <spdlog/spdlog.h>
+
+#include "link_supervisor.hpp"
+
+LinkSupervisor::~LinkSupervisor() {
+    thd.request_stop();
+    cv.notify_all();
+    if (thd.joinable()) {
+        thd.join();
+    }
+}
+
+void LinkSupervisor::add_link(
+    const std::string &name, NetClient *client, int port_offset, std::function<void()> on_connected) {
+    std::lock_guard<std::mutex> lock(mtx);
+    Link link;
+    link.name = name;
+    link.client = client;
+    link.port_offset = port_offset;
+    link.on_connected = std::move(on_connected);
+    links.push_back(std::move(link));
+}
+
+void LinkSupervisor::start(const std::string &host, int port) {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        bool target_changed = !host_.empty() && (host_ != host || port_ != port);
+        host_ = host;
+        port_ = port;
+        for (auto &link : links) {
+            if (target_changed) {
+                link.client->close(); // Still connected to the old address
+            }
+            link.backoff = InitialBackoff;
+            link.next_attempt = {};
+        }
+        wake_up = true;
+    }
+
+    if (!thd.joinable()) {
+        thd = std::jthread([this](std::stop_token stop_token) { loop(stop_token); });
+    }
+    cv.notify_all();
+}
+
+void LinkSupervisor::reconnect_all() {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        for (auto &link : links) {
+            link.client->close();
+            link.backoff = InitialBackoff;
+            link.next_attempt = {};
+        }
+        wake_up = true;
+    }
+    cv.notify_all();
+}
+
+nlohmann::json LinkSupervisor::links_state() {
+    std::lock_guard<std::mutex> lock(mtx);
+    nlohmann::json res = nlohmann::json::object();
+    for (const auto &link : links) {
+        res[link.name] = link.state;
+    }
+    return res;
+}
+
+bool LinkSupervisor::take_state_changed() {
+    return state_changed.exchange(false);
+}
+
+void LinkSupervisor::set_state(Link &link, LinkState state) {
+    if (link.state != state) {
+        SPDLOG_INFO("{} link {}", link.name, nlohmann::json(state).get<std::string>());
+        link.state = state;
+        state_changed = true;
+    }
+}
+
+void LinkSupervisor::loop(std::stop_token stop_token) {
+    while (!stop_token.stop_requested()) {
+        std::vector<Link *> due;
+        std::string host;
+        int port;
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            cv.wait_for(lock, stop_token, PollInterval, [this] { return wake_up; });
+            wake_up = false;
+            if (stop_token.stop_requested()) {
+                return;
+            }
+
+            auto now = std::chrono::steady_clock::now();
+            for (auto &link : links) {
+                if (link.client->is_connected) {
+                    set_state(link, LinkState::CONNECTED);
+                    continue;
+                }
+
+                set_state(link, LinkState::DISCONNECTED);
+                if (now >= link.next_attempt) {
+                    set_state(link, LinkState::CONNECTING);
+                    due.push_back(&link);
+                }
+            }
+            host = host_;
+            port = port_;
+        }
+
+        if (due.empty()) {
+            continue;
+        }
+
+        // Every link that is down is connected at the same time, a dead endpoint does not delay the others
+        std::vector<std::future<int>> attempts;
+        for (Link *link : due) {
+            attempts.push_back(std::async(std::launch::async, [link, host, port] {
+                return link->client->connect(host, port + link->port_offset);
+            }));
+        }
+
+        for (size_t i = 0; i < due.size(); i++) {
+            Link &link = *due[i];
+            int result = attempts[i].get();
+
+            if (result == 0) {
+                link.backoff = InitialBackoff;
+                if (link.on_connected) {
+                    link.on_connected();
+                }
+            }
+
+            std::lock_guard<std::mutex> lock(mtx);
+            if (result == 0) {
+                set_state(link, LinkState::CONNECTED);
+            } else {
+                SPDLOG_WARN(
+                    "Unable to connect to {} endpoint {}:{}, retrying in {} ms",
+                    link.name,
+                    host,
+                    port + link.port_offset,
+                    link.backoff.count());
+                set_state(link, LinkState::DISCONNECTED);
+                link.next_attempt = std::chrono::steady_clock::now() + link.backoff;
+                link.backoff = std::min(link.backoff * 2, MaxBackoff);
+            }
+        }
+    }
+}
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <chrono>
 #include <cstdlib>
 #include <exception>
@@ -19,11 +20,16 @@
 #include "rema.hpp"
 #include "restfull_api.hpp"
 #include "session.hpp"
+#include "session_cache.hpp"
+#include "session_saver.hpp"
 #include "syslogger.hpp"
 #include "upload.hpp"
 #include "log_pattern.hpp"
+#include "sse_broadcaster.hpp"
+#include "telemetry_stream.hpp"
+#include "telemetry_websocket.hpp"
 
-std::vector<std::shared_ptr<restbed::Session>> sse_sessions;
+SseBroadcaster sse_broadcaster;
 
 using namespace std::chrono_literals;
 
@@ -40,26 +46,48 @@ void register_event_source_handler(const std::shared_ptr<restbed::Session>& sess
     };
 
     session->yield(restbed::OK, headers, [](const std::shared_ptr<restbed::Session>& rest_session_ptr) {
-        sse_sessions.push_back(rest_session_ptr);
+        sse_broadcaster.subscribe(rest_session_ptr);
     });
 }
 
-void event_stream_handler() {
-    if (sse_sessions.empty()) {
-        return;
+// Returns the sequence of the telemetry frame sent
+uint64_t event_stream_handler(TelemetryDeltaEncoder& telemetry_encoder) {
+    if (!sse_broadcaster.has_subscribers()) {
+        return rema.telemetry_snapshot.load().sequence;
+    }
+    if (sse_broadcaster.take_keyframe_request()) {
+        telemetry_encoder.request_keyframe();
     }
 
     static bool hide_sent = false;
-    nlohmann::json res;
+    nlohmann::json res; // Events, never dropped
+    nlohmann::json telemetry_res;
+    uint64_t sequence = 0;
 
     try {
-        res["TELEMETRY"] = rema.ui_telemetry;
-        res["TELEMETRY"]["aligned_coords"] = current_session.transform_point_if_aligned(rema.ui_telemetry.coords, true);
-        res["TELEMETRY"]["show_target"] = rema.is_sequence_in_progress;
+        TelemetrySnapshot snapshot = rema.telemetry_snapshot.load();
+        sequence = snapshot.sequence;
+        nlohmann::json telemetry = snapshot.ui_telemetry;
+        auto session = session_cache.current();
+        telemetry["aligned_coords"] = session->transform_point_if_aligned(snapshot.ui_telemetry.coords, true);
+        telemetry["show_target"] = rema.is_sequence_in_progress;
+
+        if (session->is_loaded) {
+            if (auto nearest = session->get_tube_index()->nearest(snapshot.ui_telemetry.coords)) {
+                telemetry["nearest_tube"] = {
+                    { "tube_id", nearest->tube_id },
+                    { "distance", nearest->distance },
+                    { "inside", nearest->distance <= session->hx.tube_od / 2 },
+                };
+            }
+        }
+        telemetry_encoder.encode(telemetry_res, telemetry);
 
-        if (rema.new_temps_available) {
-            rema.new_temps_available = false;
-            res["TEMP_INFO"] = rema.temps;
+        static uint64_t last_temps_sequence = 0;
+        TempsSnapshot temps = rema.temps_snapshot.load();
+        if (temps.sequence != last_temps_sequence) {
+            last_temps_sequence = temps.sequence;
+            res["TEMP_INFO"] = temps.temps;
         }
     } catch (std::exception& e) {
         SPDLOG_ERROR("Telemetry connection lost... {}", e.what());
@@ -75,30 +103,52 @@ void event_stream_handler() {
         }
     }
 
-    if (current_session.is_loaded && current_session.is_changed) {
-        current_session.save_to_disk();
-        current_session.is_changed = false;
+    if (rema.link_supervisor.take_state_changed()) {
+        res["LINK_STATE"] = rema.link_supervisor.links_state();
+    }
+
+    if (nlohmann::json jobs = rema.motion_jobs.take_events(); !jobs.empty()) {
+        res["JOBS"] = jobs;
+    }
+
+    if (session_saver.take_saved()) {
         res["SESSION_MSG"] = "Session Saved";
     }
 
     if (!res.empty()) {
-        sse_sessions.erase(
-            std::remove_if(
-                sse_sessions.begin(),
-                sse_sessions.end(),
-                [](const std::shared_ptr<restbed::Session>& rest_session_ptr) { return rest_session_ptr->is_closed(); }),
-            sse_sessions.end());
-
-        const auto message = "data: " + nlohmann::to_string(res) + "\n\n";
-        for (const auto& session : sse_sessions) {
-            session->yield(message);
-        }
+        sse_broadcaster.publish(SseBroadcaster::Kind::EVENT, res);
+    }
+    if (telemetry_res.contains("TELEMETRY")) {
+        sse_broadcaster.publish(SseBroadcaster::Kind::TELEMETRY_KEYFRAME, telemetry_res);
+    } else if (!telemetry_res.empty()) {
+        sse_broadcaster.publish(SseBroadcaster::Kind::TELEMETRY_DELTA, telemetry_res);
+    }
+    return sequence;
+}
+
+// Sends as soon as a new telemetry frame arrives, at most max_rate_hz times per second: frames arriving while the
+// stream waits for its next slot are coalesced, only the latest one is sent. Without telemetry the stream still runs
+// every idle_poll_ms for the other events.
+void event_stream_loop(
+    std::stop_token stop_token, TelemetryDeltaEncoder& telemetry_encoder, const TelemetryStreamSettings& settings) {
+    using namespace std::chrono;
+    const auto min_interval = microseconds(1'000'000 / std::max(settings.max_rate_hz, 1));
+    const auto idle_poll = milliseconds(settings.idle_poll_ms);
+
+    uint64_t last_sequence = 0;
+    auto next_slot = steady_clock::now();
+    while (!stop_token.stop_requested()) {
+        rema.wait_for_telemetry(last_sequence, idle_poll);
+        std::this_thread::sleep_until(next_slot);
+        next_slot = steady_clock::now() + min_interval;
+        last_sequence = event_stream_handler(telemetry_encoder);
     }
 }
 
 void get_HXs_method_handler(const std::shared_ptr<restbed::Session>& session) {
-    if (current_session.is_loaded) {
-        const std::string body = current_session.hx.tubesheet_svg;
+    auto current = session_cache.current();
+    if (current->is_loaded) {
+        const std::string body = current->hx.tubesheet_svg;
         std::string content_type = "image/svg+xml";
 
         const std::multimap<std::string, std::string> headers{ { "Content-Type", content_type },
@@ -149,35 +199,40 @@ void post_rema_method_handler(const std::shared_ptr<restbed::Session>& session)
         content_length, [&](const std::shared_ptr<restbed::Session>rest_session_ptr, const restbed::Bytes& body) {
             std::string tx_buffer(body.begin(), body.end());
 
-            try {
-                std::string rema_response;
-                {
-                    std::lock_guard<std::mutex> lock(rema.rtu_mutex);
-                    rema.command_client.send_request(tx_buffer);
-                    rema_response = rema.command_client.get_response();
-                }
-                if (!rema_response.empty()) {
-                    nlohmann::json res;
-                    res["request_id"] = request_id;
-                    res["payload"] = nlohmann::json::parse(rema_response);
-
-                    std::string stream = res.dump();
-                    rest_session_ptr->close(
-                        restbed::OK,
-                        stream,
-                        { { "Content-Length", std::to_string(stream.length()) },
-                          { "Content-Type", "application/json; charset=utf-8" } });
-                }
-            } catch (std::exception& e) {
-                std::string message = e.what();
-                SPDLOG_ERROR("COMMUNICATIONS ERROR {}", e.what());
-                rest_session_ptr->close(
-                    restbed::OK,
-                    message,
-                    { { "Content-Length", std::to_string(message.length()) },
-                      { "Content-Type", "application/json; charset=utf-8" },
-                      { "Cache-Control", "no-store" } });
-            }
+            // The callback runs on the I/O reactor thread for a response or a timeout, on the thread closing the link
+            // when it is lost, or on this worker when the request cannot be sent. This worker is not held meanwhile.
+            rema.command_client.send_command(
+                tx_buffer,
+                [rest_session_ptr, request_id](CommandNetClient::Response rema_response) {
+                    try {
+                        if (!rema_response) {
+                            throw std::runtime_error(rema_response.error());
+                        }
+
+                        nlohmann::json res;
+                        res["request_id"] = request_id;
+                        // An empty response still closes the session, with a null payload
+                        res["payload"] =
+                            rema_response->empty() ? nlohmann::json() : nlohmann::json::parse(*rema_response);
+
+                        std::string stream = res.dump();
+                        rest_session_ptr->close(
+                            restbed::OK,
+                            stream,
+                            { { "Content-Length", std::to_string(stream.length()) },
+                              { "Content-Type", "application/json; charset=utf-8" } });
+                    } catch (std::exception& e) {
+                        std::string message = e.what();
+                        SPDLOG_ERROR("COMMUNICATIONS ERROR {}", e.what());
+                        rest_session_ptr->close(
+                            restbed::OK,
+                            message,
+                            { { "Content-Length", std::to_string(message.length()) },
+                              { "Content-Type", "application/json; charset=utf-8" },
+                              { "Cache-Control", "no-store" } });
+                    }
+                },
+                rema.command_timeout);
         });
 }
 
@@ -242,17 +297,37 @@ int main([[maybe_unused]] int argc, [[maybe_unused]] char* argv[]) {
 
     auto resource_server_side_events = std::make_shared<restbed::Resource>();
     resource_server_side_events->set_path("/sse");
+    auto telemetry_stream_settings =
+        rema.config["REMA_PROXY"].value("sse", nlohmann::json::object()).get<TelemetryStreamSettings>();
+    TelemetryDeltaEncoder telemetry_encoder(std::chrono::milliseconds(telemetry_stream_settings.keyframe_interval_ms));
     resource_server_side_events->set_method_handler("GET", register_event_source_handler);
 
+    TelemetryWebSocket telemetry_websocket;
+    auto resource_telemetry_websocket = std::make_shared<restbed::Resource>();
+    resource_telemetry_websocket->set_path("/ws/telemetry");
+    resource_telemetry_websocket->set_method_handler(
+        "GET", [&telemetry_websocket](const std::shared_ptr<restbed::Session>& session) {
+            telemetry_websocket.upgrade(session);
+        });
+
     restbed::Service service;
     service.publish(resource_rema);
     service.publish(resource_HXs);
     service.publish(resource_html_file);
     service.publish(resource_server_side_events);
+    service.publish(resource_telemetry_websocket);
     upload_create_endpoints(service);
     restfull_api_create_endpoints(service);
 
-    service.schedule(event_stream_handler, std::chrono::milliseconds(100));
+    std::jthread event_stream_thread(event_stream_loop, std::ref(telemetry_encoder), std::cref(telemetry_stream_settings));
+    auto session_saver_settings =
+        rema.config["REMA_PROXY"].value("session_save", nlohmann::json::object()).get<SessionSaverSettings>();
+    std::jthread session_saver_thread([&session_saver_settings](std::stop_token stop_token) {
+        session_saver.run(stop_token, session_saver_settings);
+    });
+    std::jthread telemetry_websocket_thread([&telemetry_websocket](std::stop_token stop_token) {
+        telemetry_websocket.run(stop_token);
+    });
 
     service.set_logger(std::make_shared<SyslogLogger>());
 
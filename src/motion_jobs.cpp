@@ -0,0 +1,210 @@
+#include <spdlog/spdlog.h>
+
+#include "motion_jobs.hpp"
+
+void MotionJobs::Context::progress(const nlohmann::json &progress) {
+    std::lock_guard<std::mutex> lock(jobs.mtx);
+    if (Job *job = jobs.find_locked(id)) {
+        job->progress = progress;
+        jobs.publish_locked(*job);
+    }
+}
+
+MotionJobs::~MotionJobs() {
+    thd.request_stop();
+    cv.notify_all();
+    if (thd.joinable()) {
+        thd.join();
+    }
+}
+
+void MotionJobs::set_cancel_running_callback(std::function<void()> callback) {
+    std::lock_guard<std::mutex> lock(mtx);
+    cancel_running = std::move(callback);
+}
+
+uint64_t MotionJobs::submit(const std::string &name, const nlohmann::json &params, Body body) {
+    bool was_running = false;
+    uint64_t id;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        id = ++last_id;
+        for (auto &job : jobs) {
+            was_running |= cancel_locked(job, fmt::format("Superseded by job {}", id));
+        }
+
+        Job &job = jobs.emplace_back();
+        job.id = id;
+        job.name = name;
+        job.params = params;
+        job.body = std::move(body);
+        job.context = std::unique_ptr<Context>(new Context(*this, id));
+        queue.push_back(&job);
+        publish_locked(job);
+        SPDLOG_INFO("Motion job {} {} queued", id, name);
+
+        if (!thd.joinable()) {
+            thd = std::jthread([this](std::stop_token stop_token) { loop(stop_token); });
+        }
+    }
+
+    if (was_running && cancel_running) {
+        cancel_running();
+    }
+
+    cv.notify_all();
+    return id;
+}
+
+std::optional<nlohmann::json> MotionJobs::get(uint64_t id) {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (Job *job = find_locked(id)) {
+        return to_json(*job);
+    }
+    return std::nullopt;
+}
+
+nlohmann::json MotionJobs::list() {
+    std::lock_guard<std::mutex> lock(mtx);
+    nlohmann::json res = nlohmann::json::array();
+    for (const auto &job : jobs) {
+        res.push_back(to_json(job));
+    }
+    return res;
+}
+
+bool MotionJobs::cancel(uint64_t id) {
+    bool was_running;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        Job *job = find_locked(id);
+        if (!job || (job->state != MotionJobState::QUEUED && job->state != MotionJobState::RUNNING)) {
+            return false;
+        }
+        was_running = cancel_locked(*job, "Cancelled by the user");
+    }
+
+    // Outside the lock: stopping the axes waits for the sequence, which may be reporting progress
+    if (was_running && cancel_running) {
+        cancel_running();
+    }
+    return true;
+}
+
+nlohmann::json MotionJobs::take_events() {
+    std::lock_guard<std::mutex> lock(mtx);
+    nlohmann::json res = nlohmann::json::array();
+    for (auto &event : events) {
+        res.push_back(std::move(event));
+    }
+    events.clear();
+    return res;
+}
+
+// Returns true if the job is running, the caller has to stop the axes once the lock is released.
+// A running job keeps its RUNNING state until its body returns.
+bool MotionJobs::cancel_locked(Job &job, const std::string &reason) {
+    if (job.state == MotionJobState::QUEUED) {
+        job.error = reason;
+        std::erase(queue, &job);
+        finish_locked(job, MotionJobState::CANCELLED);
+        return false;
+    }
+    if (job.state == MotionJobState::RUNNING && !job.context->cancel_requested) {
+        job.error = reason;
+        job.context->cancel_requested = true;
+        return true;
+    }
+    return false;
+}
+
+void MotionJobs::finish_locked(Job &job, MotionJobState state) {
+    job.state = state;
+    job.body = nullptr;
+    publish_locked(job);
+    SPDLOG_INFO("Motion job {} {} {}", job.id, job.name, nlohmann::json(state).get<std::string>());
+
+    size_t finished = 0;
+    for (const auto &j : jobs) {
+        finished += j.state != MotionJobState::QUEUED && j.state != MotionJobState::RUNNING;
+    }
+    for (auto it = jobs.begin(); finished > MaxFinishedJobs && it != jobs.end();) {
+        if (it->state != MotionJobState::QUEUED && it->state != MotionJobState::RUNNING && &*it != &job) {
+            it = jobs.erase(it);
+            finished--;
+        } else {
+            ++it;
+        }
+    }
+}
+
+void MotionJobs::publish_locked(const Job &job) {
+    if (events.size() >= MaxPendingEvents) {
+        events.erase(events.begin()); // Nobody is listening on /sse, the oldest updates are stale anyway
+    }
+    events.push_back(to_json(job));
+}
+
+MotionJobs::Job *MotionJobs::find_locked(uint64_t id) {
+    for (auto &job : jobs) {
+        if (job.id == id) {
+            return &job;
+        }
+    }
+    return nullptr;
+}
+
+nlohmann::json MotionJobs::to_json(const Job &job) {
+    nlohmann::json res = {
+        { "id", job.id },
+        { "name", job.name },
+        { "params", job.params },
+        { "state", job.state },
+    };
+    if (!job.progress.is_null()) {
+        res["progress"] = job.progress;
+    }
+    if (!job.result.is_null()) {
+        res["result"] = job.result;
+    }
+    if (!job.error.empty()) {
+        res["error"] = job.error;
+    }
+    return res;
+}
+
+void MotionJobs::loop(std::stop_token stop_token) {
+    while (!stop_token.stop_requested()) {
+        std::unique_lock<std::mutex> lock(mtx);
+        cv.wait(lock, stop_token, [this] { return !queue.empty(); });
+        if (stop_token.stop_requested()) {
+            break;
+        }
+
+        Job &job = *queue.front();
+        queue.pop_front();
+        job.state = MotionJobState::RUNNING;
+        publish_locked(job);
+        Body body = job.body;
+        Context &context = *job.context;
+        lock.unlock();
+
+        tl::expected<nlohmann::json, std::string> ret;
+        try {
+            ret = body(context);
+        } catch (std::exception &e) {
+            ret = tl::make_unexpected(std::string(e.what()));
+        }
+
+        lock.lock();
+        if (context.cancelled()) {
+            finish_locked(job, MotionJobState::CANCELLED); // The error set by cancel() says why
+        } else if (ret) {
+            job.result = std::move(*ret);
+            finish_locked(job, MotionJobState::SUCCEEDED);
+        } else {
+            job.error = ret.error();
+            finish_locked(job, MotionJobState::FAILED);
+        }
+    }
+}
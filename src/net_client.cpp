@@ -1,38 +1,80 @@
 #include <spdlog/spdlog.h>
 
+#include "io_reactor.hpp"
 #include "net_client.hpp"
 #include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+
+#include <chrono>
+#include <map>
+#include <mutex>
+
+namespace {
+struct ResolvedHost {
+    in_addr addr;
+    std::chrono::steady_clock::time_point expires;
+};
+
+std::mutex resolver_mtx;
+std::map<std::string, ResolvedHost> resolver_cache;
+constexpr auto ResolverCacheTtl = std::chrono::minutes(5);
+} // namespace
 
 NetClient::NetClient() {
 }
 
+// Name lookups are cached so the reconnect attempts of every endpoint do not hit the resolver each time
+bool NetClient::resolve(const std::string &host, in_addr &addr) {
+    auto now = std::chrono::steady_clock::now();
+    {
+        std::lock_guard<std::mutex> lock(resolver_mtx);
+        if (auto it = resolver_cache.find(host); it != resolver_cache.end() && it->second.expires > now) {
+            addr = it->second.addr;
+            return true;
+        }
+    }
+
+    struct addrinfo hints {};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo *result;
+    if (int err = ::getaddrinfo(host.c_str(), nullptr, &hints, &result); err != 0) {
+        SPDLOG_ERROR("No such host name: {} ({})", host, gai_strerror(err));
+        return false;
+    }
+    addr = reinterpret_cast<struct sockaddr_in *>(result->ai_addr)->sin_addr;
+    ::freeaddrinfo(result);
+
+    std::lock_guard<std::mutex> lock(resolver_mtx);
+    resolver_cache[host] = { addr, now + ResolverCacheTtl };
+    return true;
+}
+
 int NetClient::connect(std::string host, int port, int nsec) {
+    if (socket_ >= 0) {
+        close(); // Connecting replaces the previous connection
+    }
+
     // setup variables
     host_ = host;
     port_ = port;
 
-    struct sockaddr_in server_addr;
-
-    // use DNS to get IP address
-    struct hostent* hostEntry;
-    hostEntry = gethostbyname(host_.c_str());
-    if (!hostEntry) {
-        SPDLOG_ERROR("No such host name: {}", host_);
+    struct sockaddr_in server_addr {};
+    if (!resolve(host_, server_addr.sin_addr)) {
         return -1;
     }
-
-    // setup socket address structure
-    memset(&server_addr, 0, sizeof(server_addr));
     server_addr.sin_family = AF_INET;
     server_addr.sin_port = htons(port_);
-    memcpy(&server_addr.sin_addr, hostEntry->h_addr_list[0], hostEntry->h_length);
 
     // create socket
-    socket_ = socket(PF_INET, SOCK_STREAM, 0);
-    if (!socket_) {
+    int fd = socket(PF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
         SPDLOG_ERROR("Socket creation");
         return -1;
     }
+    apply_socket_options(fd); // Before connecting, the buffer sizes set the TCP window negotiated in the handshake
 
     // connect to server
     int flags, n, error;
@@ -40,13 +82,15 @@ int NetClient::connect(std::string host, int port, int nsec) {
     fd_set rset, wset;
     struct timeval tval;
 
-    flags = ::fcntl(socket_, F_GETFL, 0);
-    ::fcntl(socket_, F_SETFL, flags | O_NONBLOCK);
+    flags = ::fcntl(fd, F_GETFL, 0);
+    ::fcntl(fd, F_SETFL, flags | O_NONBLOCK);
 
     error = 0;
-    if ((n = ::connect(socket_, reinterpret_cast<const struct sockaddr*>(&server_addr), sizeof(server_addr))) < 0) {
+    if ((n = ::connect(fd, reinterpret_cast<const struct sockaddr*>(&server_addr), sizeof(server_addr))) < 0) {
         if (errno != EINPROGRESS) {
-            return (-errno);
+            int err = errno;
+            ::close(fd);
+            return (-err);
         }
     }
 
@@ -58,20 +102,21 @@ int NetClient::connect(std::string host, int port, int nsec) {
     }
 
     FD_ZERO(&rset);
-    FD_SET(socket_, &rset);
+    FD_SET(fd, &rset);
     wset = rset;
     tval.tv_sec = nsec;
     tval.tv_usec = 0;
 
-    if ((::select(socket_ + 1, &rset, &wset, nullptr, nsec ? &tval : nullptr)) == 0) {
-        ::close(socket_); /* timeout */
+    if ((::select(fd + 1, &rset, &wset, nullptr, nsec ? &tval : nullptr)) == 0) {
+        ::close(fd); /* timeout */
         errno = ETIMEDOUT;
         return (-errno);
     }
 
-    if (FD_ISSET(socket_, &rset) || FD_ISSET(socket_, &wset)) {
+    if (FD_ISSET(fd, &rset) || FD_ISSET(fd, &wset)) {
         len = sizeof(error);
-        if (::getsockopt(socket_, SOL_SOCKET, SO_ERROR, &error, &len) < 0) {
+        if (::getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &len) < 0) {
+            ::close(fd);
             return (-error); /* Solaris pending error */
         }
     } else {
@@ -79,18 +124,104 @@ int NetClient::connect(std::string host, int port, int nsec) {
     }
 
 done:
-    ::fcntl(socket_, F_SETFL, flags); /* restore file status flags */
+    ::fcntl(fd, F_SETFL, flags); /* restore file status flags */
 
     if (error) {
-        ::close(socket_); /* just in case */
+        ::close(fd); /* just in case */
         errno = error;
         return (-errno);
     }
+    {
+        std::lock_guard<std::mutex> lock(options_mtx);
+        effective_socket_options_ = read_socket_options(fd);
+    }
+    socket_ = fd;
     is_connected = true;
+    // rx_buffer_ belongs to the reactor thread. It is emptied there, of leftovers of the previous connection, before
+    // the new fd is registered and after the removal of the previous one, which close() posted earlier: posted tasks
+    // run in order, so no on_data() of the old connection can run meanwhile.
+    auto start_receiving = [this, fd] {
+        if (socket_ != fd) {
+            return; // Closed meanwhile, from the reactor thread
+        }
+        rx_buffer_.clear();
+        io_reactor.add(fd, EPOLLIN | EPOLLRDHUP, [this](uint32_t events) { on_socket_event(events); });
+    };
+    if (io_reactor.in_reactor_thread()) {
+        start_receiving();
+    } else {
+        io_reactor.post(start_receiving);
+    }
     SPDLOG_INFO("Connected to PORT: {}", port_);    
     return (0);
 }
 
+void NetClient::set_socket_options(const SocketOptions &options) {
+    std::lock_guard<std::mutex> lock(options_mtx);
+    socket_options_ = options;
+}
+
+nlohmann::json NetClient::get_effective_socket_options() {
+    std::lock_guard<std::mutex> lock(options_mtx);
+    return is_connected ? effective_socket_options_ : nlohmann::json::object();
+}
+
+void NetClient::apply_socket_options(int fd) {
+    SocketOptions options;
+    {
+        std::lock_guard<std::mutex> lock(options_mtx);
+        options = socket_options_;
+    }
+
+    auto set = [&](int level, int name, int value, const char *option_name) {
+        if (::setsockopt(fd, level, name, &value, sizeof(value)) < 0) {
+            SPDLOG_WARN("Unable to set {}={} on port {}: {}", option_name, value, port_, std::strerror(errno));
+        }
+    };
+
+    set(IPPROTO_TCP, TCP_NODELAY, options.tcp_nodelay, "TCP_NODELAY");
+    set(SOL_SOCKET, SO_KEEPALIVE, options.keepalive, "SO_KEEPALIVE");
+    if (options.keepalive) {
+        set(IPPROTO_TCP, TCP_KEEPIDLE, options.keepalive_idle_s, "TCP_KEEPIDLE");
+        set(IPPROTO_TCP, TCP_KEEPINTVL, options.keepalive_interval_s, "TCP_KEEPINTVL");
+        set(IPPROTO_TCP, TCP_KEEPCNT, options.keepalive_count, "TCP_KEEPCNT");
+    }
+    if (options.user_timeout_ms > 0) {
+        set(IPPROTO_TCP, TCP_USER_TIMEOUT, options.user_timeout_ms, "TCP_USER_TIMEOUT");
+    }
+    if (options.rcvbuf > 0) {
+        set(SOL_SOCKET, SO_RCVBUF, options.rcvbuf, "SO_RCVBUF");
+    }
+    if (options.sndbuf > 0) {
+        set(SOL_SOCKET, SO_SNDBUF, options.sndbuf, "SO_SNDBUF");
+    }
+    if (options.busy_poll_us > 0) {
+        set(SOL_SOCKET, SO_BUSY_POLL, options.busy_poll_us, "SO_BUSY_POLL");
+    }
+}
+
+// The kernel may adjust what was asked for (e.g. it doubles SO_RCVBUF), so report what the socket really uses
+nlohmann::json NetClient::read_socket_options(int fd) {
+    auto get = [fd](int level, int name) {
+        int value = 0;
+        socklen_t len = sizeof(value);
+        ::getsockopt(fd, level, name, &value, &len);
+        return value;
+    };
+
+    SocketOptions effective;
+    effective.tcp_nodelay = get(IPPROTO_TCP, TCP_NODELAY) != 0;
+    effective.keepalive = get(SOL_SOCKET, SO_KEEPALIVE) != 0;
+    effective.keepalive_idle_s = get(IPPROTO_TCP, TCP_KEEPIDLE);
+    effective.keepalive_interval_s = get(IPPROTO_TCP, TCP_KEEPINTVL);
+    effective.keepalive_count = get(IPPROTO_TCP, TCP_KEEPCNT);
+    effective.user_timeout_ms = get(IPPROTO_TCP, TCP_USER_TIMEOUT);
+    effective.rcvbuf = get(SOL_SOCKET, SO_RCVBUF);
+    effective.sndbuf = get(SOL_SOCKET, SO_SNDBUF);
+    effective.busy_poll_us = get(SOL_SOCKET, SO_BUSY_POLL);
+    return effective;
+}
+
 void NetClient::reconnect() {
     close();
     connect(host_, port_);
@@ -120,8 +251,55 @@ void shutdownSocket(int fd) {
 
 void NetClient::close() {
     is_connected = false;
-    shutdownSocket(socket_); // As I'm shutind down socket_ from another thread, use shutdown instead of close
-                             // otherwise the same socket number will be assigned and errno = EBADF
+    int fd = socket_.exchange(-1);
+    if (fd >= 0) {
+        shutdownSocket(fd);             // Wakes up anyone still blocked on the socket
+        io_reactor.remove_and_close(fd); // The fd is released on the reactor thread, where its handler runs
+    }
+}
+
+void NetClient::on_connection_lost() {
+    SPDLOG_WARN("Connection to {}:{} lost", host_, port_);
+    close();
+}
+
+void NetClient::on_socket_event(uint32_t events) {
+    if (!is_connected) {
+        return;
+    }
+
+    bool alive = receive();
+    if (rx_buffer_.pending_bytes() > 0) {
+        on_data();
+    }
+
+    if (!alive || (events & (EPOLLERR | EPOLLHUP))) {
+        on_connection_lost();
+    }
+}
+
+// Reads everything the kernel has buffered for the socket without blocking.
+// Returns false when the peer closed the connection or the socket failed.
+bool NetClient::receive() {
+    while (true) {
+        char *dst = rx_buffer_.prepare(MinRecvSize);
+        ssize_t nread = ::recv(socket_, dst, rx_buffer_.free_space(), MSG_DONTWAIT);
+        if (nread > 0) {
+            rx_buffer_.commit(nread);
+            continue;
+        }
+
+        if (nread == 0) {
+            // The socket is closed
+            return false;
+        }
+
+        if (errno == EINTR) {
+            // The socket call was interrupted -- try again
+            continue;
+        }
+        return errno == EAGAIN; // Same value as EWOULDBLOCK on Linux
+    }
 }
 
 bool NetClient::send_request(std::string request) {
@@ -140,12 +318,12 @@ bool NetClient::send_request(std::string request) {
                     } else {
                         // an error occurred, so break out
                         SPDLOG_ERROR("Error writing to socket");
-                        is_connected = false;
+                        on_connection_lost();
                         return false;
                     }
                 } else if (nwritten == 0) {
                     // the socket is closed
-                    is_connected = false;
+                    on_connection_lost();
                     return false;
                 }
                 nleft -= nwritten;
@@ -153,79 +331,10 @@ bool NetClient::send_request(std::string request) {
             }
             return true;
         } catch (std::exception &e) {
-            is_connected = false;
             SPDLOG_ERROR("Error sending {}", e.what());
+            on_connection_lost();
             return false;
         }
     }
     return false;
 }
-
-std::string NetClient::get_response() {
-    if (is_connected) {
-        if (!leftover_buffer.empty()) {            
-            if (std::size_t null_pos; (null_pos = leftover_buffer.find('\0')) != std::string::npos) {
-                std:: string prev = leftover_buffer.substr(0, null_pos);
-                leftover_buffer = leftover_buffer.substr(null_pos + 1);
-                return prev;
-            }
-        }
-                                                            // If something was left on leftover_buffer because no null was found...
-        std::string response = std::move(leftover_buffer);  // start with what was left
-
-        // Read until we get a null character
-        while (true) {
-            ssize_t nread = recv(socket_, buf_, buflen_, 0);
-            if (nread < 0) {
-                if (errno == EINTR) {
-                    // The socket call was interrupted -- try again
-                    continue;
-                } else {
-                    // An error occurred, so return false
-                    return {};
-                }
-            } else if (nread == 0) {
-                // The socket is closed
-                return {};
-            }
-            
-            for (ssize_t i = 0; i < nread; ++i) {
-                if (buf_[i] == '\0') {
-                    // Guardar lo que viene después del carácter nulo en el buffer restante
-                    leftover_buffer.assign(buf_ + i + 1, nread - i - 1);
-                    return response; // Retornar la respuesta acumulada hasta el carácter nulo
-                }
-                response += buf_[i];
-            }
-        }
-    }
-    return {};
-}
-
-std::vector<uint8_t> NetClient::get_response_binary() {
-    if (is_connected) {
-        std::vector<uint8_t> response;
-
-        while (true) {
-            ssize_t nread = recv(socket_, buf_, buflen_, 0);
-            if (nread < 0) {
-                if (errno == EINTR) {
-                    // The socket call was interrupted -- try again
-                    continue;
-                } else {
-                    // An error occurred, so return false
-                    return {};
-                }
-            } else if (nread == 0) {
-                // The socket is closed
-                return {};
-            }
-
-            for (ssize_t i = 0; i < nread; ++i) {
-                response.push_back(buf_[i]);
-            }
-            return response;
-        }
-    }
-    return {};
-}
@@ -0,0 +1,240 @@
+#include <algorithm>
+#include <fstream>
+#include <spdlog/spdlog.h>
+#include <vector>
+
+#include "chart.hpp"
+#include "plan_runner.hpp"
+#include "rema.hpp"
+#include "session.hpp"
+#include "session_cache.hpp"
+
+tl::expected<nlohmann::json, std::string> PlanRunner::run(
+    MotionJobs::Context &job, const std::string &plan, const PlanRunOptions &options) {
+    std::string plan_name = plan;
+    auto session = session_cache.current();
+    auto entries = session->plan_get(plan_name);
+    if (entries.empty()) {
+        return tl::make_unexpected("Plan not found or empty");
+    }
+
+    std::vector<std::pair<int, std::string>> tubes;
+    for (const auto &[tube_id, entry] : entries) {
+        if (!(options.skip_executed && entry.executed)) {
+            tubes.emplace_back(entry.seq, tube_id);
+        }
+    }
+    std::sort(tubes.begin(), tubes.end());
+
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        status_ = Status();
+        status_.plan = plan;
+        status_.total = tubes.size();
+        paused = false;
+        skip_requested = false;
+    }
+    SPDLOG_INFO("Running plan {}: {} tubes", plan, tubes.size());
+    chart.init("plan_" + plan);
+
+    tl::expected<nlohmann::json, std::string> res;
+    for (size_t i = 0; i < tubes.size(); i++) {
+        std::string tube_id = tubes[i].second;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            status_.index = i;
+            status_.tube_id = tube_id;
+            skip_requested = false;
+        }
+
+        auto outcome = visit(job, *session, tube_id, options);
+        if (!outcome) {
+            res = tl::make_unexpected(fmt::format("Tube {}: {}", tube_id, outcome.error()));
+            break;
+        }
+        if (*outcome == Outcome::CANCELLED) {
+            break;
+        }
+
+        std::lock_guard<std::mutex> lock(mtx);
+        if (*outcome == Outcome::DONE) {
+            session->set_tube_executed(plan_name, tube_id, true);
+            status_.executed++;
+        } else {
+            status_.skipped++;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mtx);
+    status_.state = PlanRunnerState::IDLE;
+    status_.tube_id.clear();
+    if (res) {
+        res = status_locked();
+    }
+    SPDLOG_INFO("Plan {} run over: {} executed, {} skipped", plan, status_.executed, status_.skipped);
+    return res;
+}
+
+tl::expected<PlanRunner::Outcome, std::string> PlanRunner::visit(
+    MotionJobs::Context &job, Session &session, const std::string &tube_id, const PlanRunOptions &options) {
+    if (!wait_while_paused(job)) {
+        return Outcome::CANCELLED;
+    }
+    if (session_cache.current().get() != &session) {
+        return tl::make_unexpected("Session changed while running the plan");
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (skip_requested) {
+            return Outcome::SKIPPED;
+        }
+        inspection_done_ = false; // A trigger sent while moving is meant for this tube only once the axes stop
+    }
+
+    if (!session.hx.tubes.contains(tube_id)) {
+        SPDLOG_WARN("Tube {} is not in HX {}, skipped", tube_id, session.hx_dir.string());
+        return Outcome::SKIPPED; // Its coordinates would be (0, 0)
+    }
+
+    Tool tool = rema.get_selected_tool();
+    Point3D rema_coords = session.from_ui_to_rema(session.get_tube_coordinates(tube_id, false), &tool);
+    movement_cmd goto_tube;
+    goto_tube.axes = "XY";
+    goto_tube.first_axis_setpoint = rema_coords.x;
+    goto_tube.second_axis_setpoint = rema_coords.y;
+
+    set_state(job, PlanRunnerState::MOVING);
+    auto moved = rema.execute_sequence(goto_tube, [&](size_t) {
+        std::lock_guard<std::mutex> lock(mtx);
+        return !job.cancelled() && !skip_requested;
+    });
+
+    if (job.cancelled()) {
+        return Outcome::CANCELLED;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (skip_requested) {
+            return Outcome::SKIPPED; // The move was stopped by skip()
+        }
+    }
+    if (!moved) {
+        return tl::make_unexpected(moved.error());
+    }
+
+    set_state(job, PlanRunnerState::INSPECTING);
+    return wait_on_tube(job, options);
+}
+
+PlanRunner::Outcome PlanRunner::wait_on_tube(MotionJobs::Context &job, const PlanRunOptions &options) {
+    auto dwell_end = std::chrono::steady_clock::now() + std::chrono::milliseconds(options.dwell_ms);
+    std::unique_lock<std::mutex> lock(mtx);
+    while (true) {
+        if (job.cancelled()) {
+            return Outcome::CANCELLED;
+        }
+        if (skip_requested) {
+            return Outcome::SKIPPED;
+        }
+        if (paused) {
+            // The dwell clock stops while paused, the tube still gets its whole dwell once resumed
+            auto paused_at = std::chrono::steady_clock::now();
+            lock.unlock();
+            bool resumed = wait_while_paused(job);
+            if (resumed) {
+                set_state(job, PlanRunnerState::INSPECTING);
+            }
+            lock.lock();
+            if (!resumed) {
+                return Outcome::CANCELLED;
+            }
+            dwell_end += std::chrono::steady_clock::now() - paused_at;
+            continue;
+        }
+        if (inspection_done_ || (!options.wait_trigger && std::chrono::steady_clock::now() >= dwell_end)) {
+            return Outcome::DONE;
+        }
+        // Polling as well, cancelling the job does not notify this condition variable
+        auto wake_up = std::chrono::steady_clock::now() + PollInterval;
+        cv.wait_until(lock, options.wait_trigger ? wake_up : std::min(wake_up, dwell_end));
+    }
+}
+
+bool PlanRunner::wait_while_paused(MotionJobs::Context &job) {
+    std::unique_lock<std::mutex> lock(mtx);
+    if (paused) {
+        status_.state = PlanRunnerState::PAUSED;
+        job.progress(status_locked());
+    }
+    while (paused && !job.cancelled()) {
+        cv.wait_for(lock, PollInterval);
+    }
+    return !job.cancelled();
+}
+
+void PlanRunner::set_state(MotionJobs::Context &job, PlanRunnerState state) {
+    std::lock_guard<std::mutex> lock(mtx);
+    status_.state = state;
+    job.progress(status_locked());
+}
+
+void PlanRunner::pause() {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        paused = true;
+    }
+    cv.notify_all(); // Stops the dwell of the current tube
+}
+
+void PlanRunner::resume() {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        paused = false;
+    }
+    cv.notify_all();
+}
+
+// The move in progress is stopped by the sequence observer before its next step, the step itself is cut short by
+// cancelling the sequence
+void PlanRunner::skip() {
+    bool moving;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (status_.state == PlanRunnerState::IDLE) {
+            return;
+        }
+        skip_requested = true;
+        moving = status_.state == PlanRunnerState::MOVING;
+    }
+    cv.notify_all();
+    if (moving) {
+        rema.cancel_sequence_in_progress();
+    }
+}
+
+void PlanRunner::inspection_done() {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        inspection_done_ = true;
+    }
+    cv.notify_all();
+}
+
+nlohmann::json PlanRunner::status() {
+    std::lock_guard<std::mutex> lock(mtx);
+    return status_locked();
+}
+
+nlohmann::json PlanRunner::status_locked() const {
+    return {
+        { "state", status_.state },
+        { "plan", status_.plan },
+        { "tube_id", status_.tube_id },
+        { "index", status_.index },
+        { "total", status_.total },
+        { "executed", status_.executed },
+        { "skipped", status_.skipped },
+        { "paused", paused },
+    };
+}
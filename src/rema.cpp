@@ -6,6 +6,7 @@
 #include <fstream>
 #include <map>
 #include <memory>
+#include <set>
 #include <spdlog/spdlog.h>
 #include <string>
 #include <variant>
@@ -13,6 +14,7 @@
 #include "nlohmann/json.hpp"
 #include "rema.hpp"
 #include "session.hpp"
+#include "session_cache.hpp"
 #include "chart.hpp"
 #include "tool.hpp"
 
@@ -21,8 +23,8 @@ REMA::REMA() {
     spdlog::set_pattern(log_pattern);
 
     telemetry_client.set_on_receive_callback(
-        [&](std::vector<uint8_t>& line) { 
-            update_telemetry(line);
+        [&](std::span<const uint8_t> frame) { 
+            return update_telemetry(frame);
         }
     );
 
@@ -32,6 +34,12 @@ REMA::REMA() {
         }
     );
 
+    link_supervisor.add_link("command", &command_client, 0, [&] { send_startup_commands(); });
+    link_supervisor.add_link("telemetry", &telemetry_client, 1, [&] { telemetry_client.start(); });
+    link_supervisor.add_link("logs", &logs_client, 2);
+
+    motion_jobs.set_cancel_running_callback([&] { cancel_sequence_in_progress(); });
+
     auto now = to_time_t(std::chrono::steady_clock::now());
     std::filesystem::path log_file = logs_dir / ("log" + std::to_string(now) + ".json");
     
@@ -66,6 +74,7 @@ void REMA::delete_tool(const std::string &tool) {
 void REMA::cancel_sequence_in_progress() {
     while (is_sequence_in_progress) {
         cancel_sequence = true;
+        telemetry_cv.notify_all(); // Wakes execute_step() if it is waiting for telemetry
     }
 }
 
@@ -75,6 +84,7 @@ void REMA::load_config() {
         if (config_file.is_open()) {
             config_file >> config;
             this->last_selected_tool = config["REMA"]["last_selected_tool"];
+            motion_settings = config["REMA"].value("motion", nlohmann::json::object()).get<MotionSettings>();
         } else {
             SPDLOG_WARN("{} not found", config_file_path.string());
             std::exit(1);
@@ -94,9 +104,7 @@ nlohmann::json REMA::send_startup_commands() {
             SPDLOG_INFO("REMA start up file found");
             nlohmann::json rema_startup_cmds;
             rema_startup_file >> rema_startup_cmds;
-            for (auto cmd : rema_startup_cmds) {
-                res.push_back(execute_command(cmd["cmd"], cmd["pars"]));
-            }
+            res = execute_commands(rema_startup_cmds);
         }
     } catch (std::exception &e) {
         SPDLOG_WARN(e.what());
@@ -114,61 +122,87 @@ void REMA::save_config() {
 void REMA::connect(const std::string &rtu_host, int rtu_port) {
     rtu_host_ = rtu_host;
     rtu_port_ = rtu_port;
-    if (command_client.connect(rtu_host, rtu_port) < 0) {
-        SPDLOG_WARN("Unable to connect to Command endpoint");
-    } else {
-        send_startup_commands();
-    };
-
-    if (telemetry_client.connect(rtu_host, rtu_port + 1) < 0) {
-        SPDLOG_WARN("Unable to connect to Telemetry endpoint");
-    } else {
-        telemetry_client.start();
-    }
+    command_timeout = std::chrono::milliseconds(config["REMA"]["network"].value("command_timeout_ms", 5000));
+    apply_socket_options();
+    link_supervisor.start(rtu_host, rtu_port); // Connects in the background, the links come up as the RTU answers
+}
 
-    if (logs_client.connect(rtu_host, rtu_port + 2) < 0) {
-        SPDLOG_WARN("Unable to connect to Logs endpoint");
-    } else {
-        logs_client.start();
-    }
+// "socket_options" holds the options shared by every link, and optionally an object per link
+// ("command", "telemetry", "logs") overriding some of them
+void REMA::apply_socket_options() {
+    nlohmann::json common = config["REMA"]["network"].value("socket_options", nlohmann::json::object());
+    auto options_for = [&](const std::string &link) {
+        nlohmann::json options = common;
+        if (common.contains(link)) {
+            options.merge_patch(common[link]);
+        }
+        return options.get<SocketOptions>();
+    };
 
+    command_client.set_socket_options(options_for("command"));
+    telemetry_client.set_socket_options(options_for("telemetry"));
+    logs_client.set_socket_options(options_for("logs"));
 }
 
 void REMA::reconnect() {
-    command_client.close();
-    telemetry_client.close();   // this would probably be closed by watchdog
-    logs_client.close();
-    connect(rtu_host_, rtu_port_);
+    link_supervisor.reconnect_all();
 }
 
-void REMA::update_telemetry(std::vector<uint8_t>& stream) {
-    nlohmann::json json;    
+// Runs on the I/O reactor thread, the only writer of the telemetry snapshots
+bool REMA::update_telemetry(std::span<const uint8_t> stream) {
     try {
-        std::lock_guard<std::mutex> lock(mtx);
-        if (!stream.empty()) {
-            json = nlohmann::json::from_msgpack(stream);
-
-            if (json.contains("telemetry")) {
-                telemetry = json["telemetry"];
-                ui_telemetry = rema.telemetry;
-                Tool tool = rema.get_selected_tool();
-                ui_telemetry.coords = current_session.from_rema_to_ui(rema.telemetry.coords, &tool);
-                ui_telemetry.targets = current_session.from_rema_to_ui(rema.telemetry.targets, &tool);
-
-
-                if (ui_telemetry.coords != old_telemetry.coords) {
-                    chart.insertData({ui_telemetry.coords});
-                    old_telemetry = ui_telemetry;
-                }
+        if (stream.empty()) {
+            return false;
+        }
+
+        struct telemetry new_telemetry {};
+        struct temps new_temps {};
+        bool has_telemetry = false;
+        bool has_temps = false;
+
+        MsgpackReader reader(stream.data(), stream.size());
+        size_t entries = reader.read_map_header();
+        for (size_t i = 0; i < entries; i++) {
+            std::string_view key = reader.read_str();
+            if (key == "telemetry") {
+                msgpack_decode(reader, new_telemetry);
+                has_telemetry = true;
+            } else if (key == "temps") {
+                msgpack_decode(reader, new_temps);
+                has_temps = true;
+            } else {
+                reader.skip();
             }
+        }
+
+        if (has_telemetry) {
+            TelemetrySnapshot snapshot;
+            snapshot.sequence = ++telemetry_sequence;
+            snapshot.telemetry = new_telemetry;
+            snapshot.ui_telemetry = new_telemetry;
+            Tool tool = rema.get_selected_tool();
+            auto session = session_cache.current();
+            snapshot.ui_telemetry.coords = session->from_rema_to_ui(new_telemetry.coords, &tool);
+            snapshot.ui_telemetry.targets = session->from_rema_to_ui(new_telemetry.targets, &tool);
+            telemetry_snapshot.store(snapshot);
+            {
+                std::lock_guard<std::mutex> lock(telemetry_wait_mtx); // Not lost by a waiter between its check and wait
+            }
+            telemetry_cv.notify_all();
 
-            if (json.contains("temps")) {
-                new_temps_available = true;
-                temps = json["temps"];
+            if (snapshot.ui_telemetry.coords != old_telemetry.coords) {
+                chart.insertData({snapshot.ui_telemetry.coords});
+                old_telemetry = snapshot.ui_telemetry;
             }
         }
+
+        if (has_temps) {
+            temps_snapshot.store({ ++temps_sequence, new_temps });
+        }
+        return true;
     } catch (std::exception &e) {
         SPDLOG_ERROR("TELEMETRY COMMUNICATIONS ERROR {}", e.what());
+        return false;
     }
 }
 
@@ -193,31 +227,83 @@ void REMA::set_home_z(double z) {
     execute_command("SET_COORDS", { { "position_Z", z } });
 }
 
-void REMA::execute_command_no_wait(
-    const std::string cmd_name,
-    const nlohmann::json pars) { // do not change command to a reference
-    nlohmann::json to_rema;
-
+nlohmann::json REMA::make_command(const std::string &cmd_name, const nlohmann::json &pars) {
     nlohmann::json command;
     command["cmd"] = cmd_name;
     if (!pars.is_null()) {
         command["pars"] = pars;
     }
+    return command;
+}
 
-    to_rema.push_back(command);
-    std::string tx_buffer = to_rema.dump();
+std::string REMA::make_command_frame(const std::string &cmd_name, const nlohmann::json &pars) {
+    nlohmann::json to_rema;
+    to_rema.push_back(make_command(cmd_name, pars));
+    return to_rema.dump();
+}
+
+void REMA::execute_command_no_wait(
+    const std::string cmd_name,
+    const nlohmann::json pars) { // do not change command to a reference
+    std::string tx_buffer = make_command_frame(cmd_name, pars);
 
     SPDLOG_INFO("Sending to REMA: {}", tx_buffer);
-    {
-        std::lock_guard<std::mutex> lock(rtu_mutex);
-        command_client.send_request(tx_buffer);
-    }
+    command_client.send_command(tx_buffer, nullptr, command_timeout); // The response is consumed and discarded
+}
+
+std::future<std::string> REMA::execute_command_async(const std::string cmd_name, const nlohmann::json pars) {
+    std::string tx_buffer = make_command_frame(cmd_name, pars);
+
+    SPDLOG_INFO("Sending to REMA: {}", tx_buffer);
+    return command_client.send_command(tx_buffer, command_timeout);
 }
 
 nlohmann::json
 REMA::execute_command(const std::string cmd_name, const nlohmann::json pars) { // do not change command to a reference
-    execute_command_no_wait(cmd_name, pars);
-    return nlohmann::json::parse(command_client.get_response());
+    return nlohmann::json::parse(execute_command_async(cmd_name, pars).get());
+}
+
+// Sends a list of {"cmd", "pars"} objects in as few frames as possible and returns one result per command,
+// in the same order, each shaped like the response of execute_command ({ "CMD_NAME": {...} }).
+// REMA answers a frame with a single object keyed by command name, so a command whose name already appears
+// in the frame being built starts a new one. All the frames are pipelined, the wait is a single round trip.
+nlohmann::json REMA::execute_commands(const nlohmann::json &commands) {
+    std::vector<nlohmann::json> frames;
+    std::set<std::string> names_in_frame;
+    for (const auto &command : commands) {
+        std::string cmd_name = command["cmd"];
+        if (frames.empty() || names_in_frame.count(cmd_name)) {
+            frames.push_back(nlohmann::json::array());
+            names_in_frame.clear();
+        }
+        frames.back().push_back(make_command(cmd_name, command.value("pars", nlohmann::json())));
+        names_in_frame.insert(cmd_name);
+    }
+
+    std::vector<std::future<std::string>> responses;
+    for (const auto &frame : frames) {
+        std::string tx_buffer = frame.dump();
+        SPDLOG_INFO("Sending to REMA: {}", tx_buffer);
+        responses.push_back(command_client.send_command(tx_buffer, command_timeout));
+    }
+
+    nlohmann::json res = nlohmann::json::array();
+    for (size_t i = 0; i < frames.size(); i++) {
+        nlohmann::json response = nlohmann::json::parse(responses[i].get());
+        for (const auto &command : frames[i]) {
+            std::string cmd_name = command["cmd"];
+            res.push_back({ { cmd_name, response.value(cmd_name, nlohmann::json()) } });
+        }
+    }
+    return res;
+}
+
+nlohmann::json REMA::move_closed_loop_command(const movement_cmd &cmd) {
+    return make_command(
+        "MOVE_CLOSED_LOOP",
+        { { "axes", cmd.axes },
+          { "first_axis_setpoint", cmd.first_axis_setpoint },
+          { "second_axis_setpoint", cmd.second_axis_setpoint } });
 }
 
 nlohmann::json REMA::move_closed_loop(movement_cmd cmd) {
@@ -238,19 +324,85 @@ void REMA::axes_soft_stop_all() {
     execute_command("AXES_SOFT_STOP_ALL");
 }
 
-tl::expected<void, std::string> REMA::execute_step(movement_cmd& step) {
-    nlohmann::json cmd_response = move_closed_loop(step);
+nlohmann::json REMA::axes_soft_stop_all_and_execute(const std::string cmd_name, const nlohmann::json pars) {
+    cancel_sequence_in_progress();
+    nlohmann::json res = execute_commands(
+        nlohmann::json::array({ make_command("AXES_SOFT_STOP_ALL", {}), make_command(cmd_name, pars) }));
+    return res.back();
+}
+
+std::optional<TelemetrySnapshot> REMA::wait_for_telemetry(uint64_t after_sequence, std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(telemetry_wait_mtx);
+    telemetry_cv.wait_for(lock, timeout, [&] { return telemetry_snapshot.load().sequence > after_sequence; });
+
+    TelemetrySnapshot snapshot = telemetry_snapshot.load();
+    if (snapshot.sequence > after_sequence) {
+        return snapshot;
+    }
+    return std::nullopt;
+}
+
+std::optional<TelemetrySnapshot> REMA::wait_for_step_telemetry(uint64_t after_sequence, std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(telemetry_wait_mtx);
+    telemetry_cv.wait_for(
+        lock, timeout, [&] { return cancel_sequence || telemetry_snapshot.load().sequence > after_sequence; });
+
+    TelemetrySnapshot snapshot = telemetry_snapshot.load();
+    if (snapshot.sequence > after_sequence) {
+        return snapshot;
+    }
+    return std::nullopt;
+}
+
+// Follows the move frame by frame as telemetry arrives instead of sleeping:
+//  1. the move is acknowledged by the first frame received after the command response that shows the stop flags
+//     cleared (or after ack_timeout_ms), before that they may still belong to the previous move
+//  2. it is over on the first frame that shows a probe or condition stop
+//  3. then it waits until the measured speed stays below settle_velocity for settle_frames frames
+tl::expected<void, std::string> REMA::execute_step(movement_cmd& step, const nlohmann::json &preceding_commands) {
+    using namespace std::chrono;
+
+    nlohmann::json commands = preceding_commands;
+    commands.push_back(move_closed_loop_command(step));
+    nlohmann::json cmd_response = execute_commands(commands).back();
     if (cmd_response["MOVE_CLOSED_LOOP"].contains("error")) {
-        is_sequence_in_progress = false;
         return tl::make_unexpected(cmd_response["MOVE_CLOSED_LOOP"]["error"]);
     }
+    uint64_t sequence = telemetry_snapshot.load().sequence; // Only frames sent after the response are looked at
 
-    std::this_thread::sleep_for(std::chrono::milliseconds(1000)); // Wait for telemetry update...
+    const MotionSettings settings = motion_settings;
+    auto stop_flags_cleared = [&](const struct telemetry &telemetry) {
+        bool stalled = telemetry.stalled.x || telemetry.stalled.y || telemetry.stalled.z;
+        if (step.axes == "XY") {
+            return !telemetry.probe.x_y && !telemetry.on_condition.x_y && !stalled;
+        }
+        return !telemetry.probe.z && !telemetry.on_condition.z && !stalled;
+    };
 
     bool stopped_on_probe = false;
     bool stopped_on_condition = false;
     bool abort_from_rema = false;
+    bool acknowledged = false;
+    struct telemetry telemetry;
+    auto ack_deadline = steady_clock::now() + milliseconds(settings.ack_timeout_ms);
+    auto last_frame_time = steady_clock::now();
     do {
+        auto snapshot = wait_for_step_telemetry(sequence, milliseconds(100));
+        if (!snapshot) {
+            if (!cancel_sequence && steady_clock::now() - last_frame_time > milliseconds(settings.telemetry_timeout_ms)) {
+                return tl::make_unexpected("No telemetry from REMA");
+            }
+            continue;
+        }
+        sequence = snapshot->sequence;
+        last_frame_time = steady_clock::now();
+        telemetry = snapshot->telemetry;
+
+        acknowledged = acknowledged || stop_flags_cleared(telemetry) || last_frame_time >= ack_deadline;
+        if (!acknowledged) {
+            continue;
+        }
+
         if (step.axes == "XY") {
             stopped_on_probe = telemetry.probe.x_y;
             stopped_on_condition = telemetry.on_condition.x_y;
@@ -259,56 +411,123 @@ tl::expected<void, std::string> REMA::execute_step(movement_cmd& step) {
             stopped_on_condition = telemetry.on_condition.z;
         }
 
-        std::this_thread::sleep_for(std::chrono::milliseconds(100)); // Avoid hogging the processor
         abort_from_rema = !telemetry.control_enabled || telemetry.stalled.x || telemetry.stalled.y ||
                             telemetry.stalled.z || telemetry.probe_protected;
     } while (!(stopped_on_probe || stopped_on_condition || cancel_sequence || abort_from_rema));
 
     if (cancel_sequence || abort_from_rema) {
-        is_sequence_in_progress = false;
-        return tl::make_unexpected("Sequence cancelled");            
-    } else {
-        step.executed = true;
-        step.execution_results.coords = telemetry.coords;
-        step.execution_results.stopped_on_probe = stopped_on_probe;
-        step.execution_results.stopped_on_condition = stopped_on_condition;
+        cancel_sequence = false; // Consumed by this step
+        return tl::make_unexpected("Sequence cancelled");
+    }
+
+    // Wait for vibrations to stop
+    Point3D last_coords = telemetry.coords;
+    auto last_time = last_frame_time;
+    auto settle_deadline = last_time + milliseconds(settings.settle_timeout_ms);
+    int slow_frames = 0;
+    while (slow_frames < settings.settle_frames && !cancel_sequence) {
+        auto now = steady_clock::now();
+        if (now >= settle_deadline) {
+            SPDLOG_WARN("Axes did not settle in {} ms", settings.settle_timeout_ms);
+            break;
+        }
+        auto snapshot = wait_for_step_telemetry(sequence, ceil<milliseconds>(settle_deadline - now));
+        if (!snapshot) {
+            continue;
+        }
+        sequence = snapshot->sequence;
+        now = steady_clock::now();
+
+        // Frames may arrive back to back, do not let a tiny interval turn a small jitter into a high speed
+        double dt = std::max(duration<double>(now - last_time).count(), 0.001);
+        double velocity = snapshot->telemetry.coords.distance(last_coords) / dt;
+        slow_frames = velocity < settings.settle_velocity ? slow_frames + 1 : 0;
+        last_coords = snapshot->telemetry.coords;
+        last_time = now;
     }
-    std::this_thread::sleep_for(std::chrono::milliseconds(250)); // Wait for vibrations to stop
+
+    if (cancel_sequence || abort_from_rema) {
+        cancel_sequence = false; // Cancelled while settling, the step is not complete either
+        return tl::make_unexpected("Sequence cancelled");
+    }
+
+    step.executed = true;
+    step.execution_results.coords = last_coords;
+    step.execution_results.stopped_on_probe = stopped_on_probe;
+    step.execution_results.stopped_on_condition = stopped_on_condition;
     return {};
 }
 
-tl::expected<void, std::string> REMA::execute_sequence(movement_cmd& step) {
-    nlohmann::json res;
-    cancel_sequence_in_progress();
-    cancel_sequence = false;
-    is_sequence_in_progress = true;
-    execute_command("AXES_SOFT_STOP_ALL");
+// Marks a sequence in progress for as long as execute_sequence() runs and ends it however it returns, a command
+// timeout or a lost link thrown out of execute_step() included. Otherwise cancel_sequence_in_progress() would wait
+// forever for a sequence that is over.
+namespace {
+struct SequenceInProgress {
+    explicit SequenceInProgress(REMA &remote_) : remote(remote_) {
+        remote.cancel_sequence_in_progress();
+        remote.cancel_sequence = false;
+        remote.is_sequence_in_progress = true;
+    }
 
-    auto ret = execute_step(step);
+    ~SequenceInProgress() {
+        remote.is_sequence_in_progress = false;
+        remote.cancel_sequence = false;
+    }
+
+    SequenceInProgress(const SequenceInProgress &) = delete;
+    SequenceInProgress &operator=(const SequenceInProgress &) = delete;
+
+    REMA &remote;
+};
+
+// execute_step() with the exceptions of the command link turned into errors
+tl::expected<void, std::string>
+try_execute_step(REMA &remote, movement_cmd &step, const nlohmann::json &preceding_commands) {
+    try {
+        return remote.execute_step(step, preceding_commands);
+    } catch (const std::exception &e) {
+        SPDLOG_ERROR("Sequence step failed: {}", e.what());
+        return tl::make_unexpected(std::string(e.what()));
+    }
+}
+} // namespace
+
+tl::expected<void, std::string> REMA::execute_sequence(movement_cmd& step, const SequenceObserver &observer) {
+    SequenceInProgress in_progress(*this);
+
+    if (observer && !observer(0)) {
+        return tl::make_unexpected("Sequence cancelled");
+    }
+
+    auto ret = try_execute_step(*this, step, nlohmann::json::array({ make_command("AXES_SOFT_STOP_ALL", {}) }));
     if (!ret) {
         return ret;
     }
-    is_sequence_in_progress = false;
-    cancel_sequence = false;
+    if (observer) {
+        observer(1);
+    }
     return {};
 }
 
-tl::expected<void, std::string> REMA::execute_sequence(std::vector<movement_cmd>& sequence) {
-    nlohmann::json res;
-    cancel_sequence_in_progress();
-    cancel_sequence = false;
-    is_sequence_in_progress = true;
-    execute_command("AXES_SOFT_STOP_ALL");
+tl::expected<void, std::string> REMA::execute_sequence(
+    std::vector<movement_cmd>& sequence, const SequenceObserver &observer) {
+    SequenceInProgress in_progress(*this);
 
-    // Create an individual command object and add it to the array
-    for (auto &step : sequence) {
-        auto ret = execute_step(step);
+    // The soft stop travels in the same frame as the first movement
+    nlohmann::json preceding_commands = nlohmann::json::array({ make_command("AXES_SOFT_STOP_ALL", {}) });
+    for (size_t i = 0; i < sequence.size(); i++) {
+        if (observer && !observer(i)) {
+            return tl::make_unexpected("Sequence cancelled");
+        }
+        auto ret = try_execute_step(*this, sequence[i], preceding_commands);
         if (!ret) {
             return ret;
         }
+        preceding_commands = nlohmann::json::array();
+    }
+    if (observer) {
+        observer(sequence.size());
     }
-    is_sequence_in_progress = false;
-    cancel_sequence = false;
     return {};
 }
 
@@ -317,7 +536,7 @@ nlohmann::json REMA::would_move_touch_probe(std::string new_tool_string) {
     nlohmann::json res = nlohmann::json::object();
     Tool new_tool = get_tool(new_tool_string);
     if (get_selected_tool().is_touch_probe != new_tool.is_touch_probe) {
-        if (!telemetry.control_enabled) {
+        if (!telemetry_snapshot.load().telemetry.control_enabled) {
             res["error"]="CONTROL IS DISABLED";
         } else {
             std::string message = "⚠️ WARNING: CRITICAL OPERATION ⚠️\n\n";
@@ -15,9 +15,13 @@
 #include "nlohmann/json.hpp"
 #include "magic_enum.hpp"
 #include "misc_fns.hpp"
+#include "plan_runner.hpp"
 #include "points.hpp"
 #include "rema.hpp"
 #include "session.hpp"
+#include "session_cache.hpp"
+#include "session_index.hpp"
+#include "session_saver.hpp"
 #include "tool.hpp"
 #include "chart.hpp"
 
@@ -59,7 +63,7 @@ void REMA_connect(const std::shared_ptr<restbed::Session>& rest_session) {
     try {
         rema.reconnect();
         status = restbed::OK;
-        res = "Connected";
+        res = "Reconnecting";
     } catch (std::exception &e) {
         res = e.what();
         status = restbed::INTERNAL_SERVER_ERROR;
@@ -71,14 +75,22 @@ void REMA_info(const std::shared_ptr<restbed::Session>& rest_session) {
     nlohmann::json res = nlohmann::json(nlohmann::json::value_t::object);
 
     std::map<std::string, Tool> tools_to_ui;
+    auto session = session_cache.current();
     for (auto [id, tool] : REMA::tools) {
-        tools_to_ui[id] = Tool(id, (tool.offset * current_session.hx.scale), tool.is_touch_probe);
+        tools_to_ui[id] = Tool(id, (tool.offset * session->hx.scale), tool.is_touch_probe);
     }
 
     res["tools"] = tools_to_ui;
     res["last_selected_tool"] = rema.last_selected_tool;
     res["host"] = rema.command_client.get_host();
     res["service"] = rema.command_client.get_port();
+    res["links"] = rema.link_supervisor.links_state();
+    res["socket_options"] = {
+        { "command", rema.command_client.get_effective_socket_options() },
+        { "telemetry", rema.telemetry_client.get_effective_socket_options() },
+        { "logs", rema.logs_client.get_effective_socket_options() },
+    };
+    res["telemetry_stats"] = rema.telemetry_client.get_stats();
     close_rest_session(rest_session, restbed::OK, res);
 }
 
@@ -103,7 +115,8 @@ void HXs_delete(const std::shared_ptr<restbed::Session>& rest_session) {
 }
 
 void HXs_tubesheet_load(const std::shared_ptr<restbed::Session>& rest_session) {
-    close_rest_session(rest_session, restbed::OK, nlohmann::json(current_session.hx.tubes));
+    auto session = session_cache.current();
+    close_rest_session(rest_session, restbed::OK, nlohmann::json(session->hx.tubes));
 }
 
 /**
@@ -116,7 +129,8 @@ void plans(const std::shared_ptr<restbed::Session>& rest_session) {
 
     nlohmann::json res;
     if (!plan.empty()) {
-        res = current_session.plan_get(plan);
+        auto session = session_cache.current();
+        res = session->plan_get(plan);
     }
     close_rest_session(rest_session, restbed::OK, res);
 }
@@ -127,11 +141,44 @@ void plans_delete(const std::shared_ptr<restbed::Session>& rest_session) {
 
     nlohmann::json res;
     if (!plan.empty()) {
-        current_session.plan_remove(plan);
+        auto session = session_cache.current();
+        session->plan_remove(plan);
     }
     close_rest_session(rest_session, restbed::OK);
 }
 
+void plans_optimize(const std::shared_ptr<restbed::Session>& rest_session) {
+    const auto request = rest_session->get_request();
+    size_t content_length = request->get_header("Content-Length", 0);
+
+    rest_session->fetch(
+        content_length, [](const std::shared_ptr<restbed::Session>& rest_session_ptr, const restbed::Bytes& body) {
+            std::string plan = rest_session_ptr->get_request()->get_path_parameter("plan", "");
+            nlohmann::json res;
+            try {
+                nlohmann::json pars = nlohmann::json::object();
+                if (!body.empty()) {
+                    pars = nlohmann::json::parse(body.begin(), body.end());
+                }
+                RouteOptions options;
+                options.sweep = pars.value("sweep", RouteSweep::NONE);
+                options.time_limit = std::chrono::milliseconds(pars.value("time_limit_ms", 500));
+
+                auto session = session_cache.current();
+                auto optimized = session->plan_optimize_route(plan, options, pars.value("apply", false));
+                if (!optimized) {
+                    res["error"] = optimized.error();
+                    close_rest_session(rest_session_ptr, restbed::NOT_FOUND, res);
+                    return;
+                }
+                close_rest_session(rest_session_ptr, restbed::OK, *optimized);
+            } catch (std::exception& e) {
+                res["error"] = e.what();
+                close_rest_session(rest_session_ptr, restbed::BAD_REQUEST, res);
+            }
+        });
+}
+
 /**
  * Tools related functions
  **/
@@ -222,15 +269,15 @@ void would_move_touch_probe(const std::shared_ptr<restbed::Session>& rest_sessio
  **/
 
 void sessions_list(const std::shared_ptr<restbed::Session>& rest_session) {
-    nlohmann::json res;
-
-    for (auto &session : Session::sessions_list()) {
-        res.push_back({ { "name", session.name },
-                        { "hx", session.hx },
-                        { "hx_dir", session.hx_dir },
-                        { "last_write_time", session.last_write_time },
-                        { "total_tubes_in_plans", session.total_tubes_in_plans() },
-                        { "total_tubes_executed", session.total_tubes_executed() } });
+    nlohmann::json res = nlohmann::json::array();
+
+    for (const auto &summary : session_index.list()) {
+        res.push_back({ { "name", summary.name },
+                        { "hx", summary.hx },
+                        { "hx_dir", summary.hx_dir },
+                        { "last_write_time", summary.last_write_time },
+                        { "total_tubes_in_plans", summary.total_tubes_in_plans },
+                        { "total_tubes_executed", summary.total_tubes_executed } });
     }
     close_rest_session(rest_session, restbed::OK, res);
 }
@@ -257,10 +304,12 @@ void sessions_create(const std::shared_ptr<restbed::Session>& rest_session) {
                 if (!res.empty()) {
                     status = restbed::BAD_REQUEST;
                 } else {
-                    Session new_session(session_name, std::filesystem::path(form_data["hx"]));
-                    res = new_session.load_plans();
-                    new_session.save_to_disk();
-                    current_session = new_session;
+                    auto new_session =
+                        std::make_shared<Session>(session_name, std::filesystem::path(form_data["hx"]));
+                    res = new_session->load_plans();
+                    new_session->save_to_disk();
+                    session_index.update(*new_session);
+                    session_cache.activate(std::move(new_session));
                     status = restbed::CREATED;
                 }
             } catch (const std::exception &e) {
@@ -278,9 +327,7 @@ void sessions_load(const std::shared_ptr<restbed::Session>& rest_session) {
     std::string res;
     if (!session_name.empty()) {
         try {
-            current_session.load(session_name);
-            current_session.hx.process_csv_from_disk(current_session.hx_dir);
-            current_session.hx.generate_svg();            
+            session_cache.activate(session_name);
 
             status = restbed::OK;
         } catch (std::exception &e) {
@@ -295,9 +342,10 @@ void sessions_load(const std::shared_ptr<restbed::Session>& rest_session) {
 }
 
 void current_session_info(const std::shared_ptr<restbed::Session>& rest_session) {
-    nlohmann::json res = current_session;
-    if (current_session.is_loaded) {
-        auto aligned_tubes = current_session.calculate_aligned_tubes();         // Done before to update is_aligned;
+    auto session = session_cache.current();
+    nlohmann::json res = *session;
+    if (session->is_loaded) {
+        auto aligned_tubes = session->calculate_aligned_tubes();         // Done before to update is_aligned;
         res["aligned_tubes"] = aligned_tubes;
     }
     close_rest_session(rest_session, restbed::OK, res);
@@ -308,7 +356,10 @@ void sessions_delete(const std::shared_ptr<restbed::Session>& rest_session) {
     std::string session_name = request->get_path_parameter("session_name", "");
     try {
         Session::delete_session(session_name);
-        close_rest_session(rest_session, restbed::OK, nlohmann::json(current_session));
+        session_index.remove(session_name);
+        session_cache.evict(session_name);
+        auto session = session_cache.current();
+        close_rest_session(rest_session, restbed::OK, nlohmann::json(*session));
         return;
     } catch (const std::filesystem::filesystem_error &e) {
         std::string res = std::string("filesystem error: ") + e.what();
@@ -321,7 +372,8 @@ void sessions_delete(const std::shared_ptr<restbed::Session>& rest_session) {
  **/
 
 void cal_points_list(const std::shared_ptr<restbed::Session>& rest_session) {
-    close_rest_session(rest_session, restbed::OK, nlohmann::json(current_session.cal_points));
+    auto session = session_cache.current();
+    close_rest_session(rest_session, restbed::OK, nlohmann::json(session->cal_points));
 }
 
 void cal_points_add_update(const std::shared_ptr<restbed::Session>& rest_session) {
@@ -349,7 +401,8 @@ void cal_points_add_update(const std::shared_ptr<restbed::Session>& rest_session
                     to_double(form_data.value("determined_coords_z", "0")),
                 };
                 if (!tube_id.empty()) {
-                    current_session.cal_points_add_update(
+                    auto session = session_cache.current();
+                    session->cal_points_add_update(
                         tube_id, form_data["col"], form_data["row"], ideal_coords, determined_coords);
                     status = restbed::OK;
                 } else {
@@ -374,12 +427,32 @@ void cal_points_delete(const std::shared_ptr<restbed::Session>& rest_session) {
         res = "No tube specified";
         status = restbed::INTERNAL_SERVER_ERROR;
     } else {
-        current_session.cal_points_delete(tube_id);
+        auto session = session_cache.current();
+        session->cal_points_delete(tube_id);
         status = restbed::NO_CONTENT;
     }
     close_rest_session(rest_session, status, res);
 }
 
+// Tubes around a point of the tubesheet, e.g. where the user clicked. Coordinates are the aligned ones, like telemetry,
+// unless aligned=false is given: then they are ideal HX coordinates, like the tubesheet drawing.
+// Answers the nearest tube within radius (half the tube OD by default) and every tube within it.
+void tubes_hit_test(const std::shared_ptr<restbed::Session>& rest_session) {
+    const auto request = rest_session->get_request();
+    Point3D point(request->get_path_parameter("x", 0.0), request->get_path_parameter("y", 0.0), 0);
+    auto session = session_cache.current();
+    double radius = request->get_query_parameter("radius", session->hx.tube_od / 2.0);
+    if (request->get_query_parameter("aligned", "true") == "false") {
+        point = session->transform_point_if_aligned(point);
+    }
+
+    nlohmann::json res;
+    std::vector<TubeIndex::Hit> hits = session->get_tube_index()->within_radius(point, radius);
+    res["tube"] = hits.empty() ? nlohmann::json() : nlohmann::json(hits.front());
+    res["tubes"] = hits;
+    close_rest_session(rest_session, restbed::OK, res);
+}
+
 void tubes_set_status(const std::shared_ptr<restbed::Session>& rest_session) {
 
     const auto request = rest_session->get_request();
@@ -396,7 +469,8 @@ void tubes_set_status(const std::shared_ptr<restbed::Session>& rest_session) {
 
             std::string plan = form_data["plan"];
             bool checked = form_data["checked"];
-            current_session.set_tube_executed(plan, tube_id, checked);
+            auto session = session_cache.current();
+            session->set_tube_executed(plan, tube_id, checked);
             nlohmann::json res = nlohmann::json::object();
             res[tube_id] = checked;
             close_rest_session(rest_session_ptr, restbed::OK, res);
@@ -414,24 +488,293 @@ void axes_soft_stop_all(const std::shared_ptr<restbed::Session>& rest_session) {
     close_rest_session(rest_session, restbed::OK);
 }
 
+/**
+ * Motion jobs: sequences that take seconds run on the motion jobs worker, the request only returns the job ID.
+ * Progress, results and errors are published on /sse as JOBS events.
+ **/
+
+// Publishes the sequence progress to the job, and stops the sequence before the next step if the job was cancelled
+REMA::SequenceObserver job_progress(MotionJobs::Context &job, const std::string &phase, size_t steps) {
+    return [&job, phase, steps](size_t steps_done) {
+        job.progress({ { "phase", phase }, { "step", steps_done }, { "steps", steps } });
+        return !job.cancelled();
+    };
+}
+
+tl::expected<nlohmann::json, std::string> go_to_tube_job(MotionJobs::Context &job, const std::string &tube_id) {
+    Tool tool = rema.get_selected_tool();
+    auto session = session_cache.current();
+    Point3D rema_coords = session->from_ui_to_rema(session->get_tube_coordinates(tube_id, false), &tool);
+
+    movement_cmd goto_tube;
+    goto_tube.axes = "XY";
+    goto_tube.first_axis_setpoint = rema_coords.x;
+    goto_tube.second_axis_setpoint = rema_coords.y;
+
+    chart.init("go_to_tube");
+    auto seq_execution_response = rema.execute_sequence(goto_tube, job_progress(job, "go_to_tube", 1));
+    if (!seq_execution_response) {
+        return tl::make_unexpected(seq_execution_response.error());
+    }
+
+    return nlohmann::json({ { "tube_id", tube_id } });
+}
+
+tl::expected<nlohmann::json, std::string> determine_tube_center_job(
+    MotionJobs::Context &job, const std::string &tube_id, bool set_home) {
+    Tool tool = rema.get_selected_tool();
+    double touch_probe_radius_inch = 0.085;
+    double probe_wiggle_factor = 1.2;
+
+    nlohmann::json res;
+    auto session = session_cache.current();
+    double tube_radius = session->hx.tube_od / 2;
+    Point3D ideal_center = session->get_tube_coordinates(tube_id, true);
+    Point3D initial_center = rema.telemetry_snapshot.load().telemetry.coords;
+
+    constexpr int points_number = 3;
+    static_assert(points_number % 2 != 0, "Number of points must be odd");
+    std::vector<Point3D> points = calculateCirclePoints(
+        initial_center,
+        session->from_ui_to_rema(tube_radius) * probe_wiggle_factor,
+        points_number);
+
+    std::vector<movement_cmd> seq;
+    int vertex = 0;
+    for (int n = 0; n < points_number; n++) {
+        Point3D point = points[vertex % points_number]; // To touch the tube boundary following a star pattern
+        movement_cmd step;
+        step.axes = "XY";
+        step.first_axis_setpoint = point.x;
+        step.second_axis_setpoint = point.y;
+        step.is_relevant = true;
+        seq.push_back(step);
+
+        step.first_axis_setpoint = initial_center.x;    // Go back to initial center
+        step.second_axis_setpoint = initial_center.y;
+        seq.push_back(step);
+
+        vertex += 2;
+    }
+    seq.pop_back();     // Remove the last "Go back to initial center" sequence step
+
+    chart.init("determine_tube_center");
+    auto seq_execution_response = rema.execute_sequence(seq, job_progress(job, "touch_tube", seq.size()));
+    if (!seq_execution_response) {
+        return tl::make_unexpected(seq_execution_response.error());
+    }
+
+    std::vector<Point3D> tube_boundary_points;
+
+    for (const auto &step : seq) {
+        if (step.is_relevant && step.executed && (step.execution_results.stopped_on_probe || step.execution_results.stopped_on_condition)) {
+            tube_boundary_points.push_back(step.execution_results.coords);
+        }
+    }
+
+    Circle circle = CircleFitByHyper(tube_boundary_points);
+
+    movement_cmd goto_center;
+    goto_center.axes = "XY";
+    goto_center.first_axis_setpoint = circle.center.x;
+    goto_center.second_axis_setpoint = circle.center.y;
+
+    res["center"] = { { "x", circle.center.x - tool.offset.x },
+                        { "y", circle.center.y - tool.offset.y },
+                        { "z", circle.center.z } };
+    res["radius"] = circle.radius + touch_probe_radius_inch;
+    job.progress({ { "phase", "go_to_center" }, { "step", 0 }, { "steps", 1 }, { "center", res["center"] } });
+
+    seq_execution_response = rema.execute_sequence(goto_center, job_progress(job, "go_to_center", 1));
+    if (!seq_execution_response) {
+        return tl::make_unexpected(seq_execution_response.error());
+    }
+
+    if (set_home && goto_center.executed && goto_center.execution_results.stopped_on_condition) {
+        rema.set_home_xy(
+            session->from_ui_to_rema(ideal_center.x) + tool.offset.x,
+            session->from_ui_to_rema(ideal_center.y) + tool.offset.y);
+    }
+
+    return res;
+}
+
+tl::expected<nlohmann::json, std::string> determine_tubesheet_z_job(MotionJobs::Context &job, bool set_home) {
+    Tool tool = rema.get_selected_tool();
+
+    nlohmann::json res = nlohmann::json::object();
+    movement_cmd first_touch_search;
+    first_touch_search.axes = "Z";
+    first_touch_search.first_axis_setpoint = MAX_POSITIVE_SETPOINT;
+    first_touch_search.second_axis_setpoint = 0;
+
+    chart.init("determine_tubesheet_z");
+    auto seq_execution_response = rema.execute_sequence(first_touch_search, job_progress(job, "first_touch", 1));
+    if (!seq_execution_response) {
+        return tl::make_unexpected(seq_execution_response.error());
+    }
+
+    if (!(first_touch_search.executed && first_touch_search.execution_results.stopped_on_probe)) {
+        return tl::make_unexpected("Touch probe didn't touch tubesheet");
+    }
+
+    double first_touch_z = first_touch_search.execution_results.coords.z;
+
+    std::vector<movement_cmd> seq;
+    movement_cmd backwards;
+    backwards.axes = "Z";
+    backwards.first_axis_setpoint = first_touch_z - 0.1;
+    backwards.second_axis_setpoint = 0;
+    seq.push_back(backwards);
+
+    movement_cmd second_touch_search;
+    second_touch_search.axes = "Z";
+    second_touch_search.first_axis_setpoint = first_touch_z + 0.1;
+    second_touch_search.second_axis_setpoint = 0;
+    second_touch_search.is_relevant = true;
+    seq.push_back(second_touch_search);
+
+    seq.push_back(backwards);
+
+    seq_execution_response = rema.execute_sequence(seq, job_progress(job, "second_touch", seq.size()));
+    if (!seq_execution_response) {
+        return tl::make_unexpected(seq_execution_response.error());
+    }
+
+    double sum_z = first_touch_z;
+    bool second_touch_found = false;
+    for (auto &step : seq) {
+        if (step.executed && step.is_relevant && step.execution_results.stopped_on_probe) {
+            sum_z += step.execution_results.coords.z;
+            second_touch_found = true;
+        }
+    }
+
+    if (!second_touch_found) {
+        return tl::make_unexpected("Touch probe didn't touch tubesheet the second time");
+    }
+
+    double z = sum_z / 2;
+
+    movement_cmd goto_tubesheet;
+    goto_tubesheet.axes = "Z";
+    goto_tubesheet.first_axis_setpoint = z;
+    goto_tubesheet.second_axis_setpoint = 0;
+
+    seq_execution_response = rema.execute_sequence(goto_tubesheet, job_progress(job, "go_to_tubesheet", 1));
+    if (!seq_execution_response) {
+        return tl::make_unexpected(seq_execution_response.error());
+    }
+
+    if (goto_tubesheet.executed) {
+        if (set_home) {
+            rema.set_home_z(0);
+        } else {
+            auto session = session_cache.current();
+            res["z"] = session->from_rema_to_ui(z) + tool.offset.z;
+        }
+    }
+
+    return res;
+}
+
+void start_motion_job(
+    const std::shared_ptr<restbed::Session>& rest_session,
+    const std::string &name,
+    const nlohmann::json &params,
+    MotionJobs::Body body) {
+    uint64_t job_id = rema.motion_jobs.submit(name, params, std::move(body));
+    close_rest_session(rest_session, restbed::ACCEPTED, nlohmann::json({ { "job_id", job_id } }));
+}
+
+void jobs_list(const std::shared_ptr<restbed::Session>& rest_session) {
+    close_rest_session(rest_session, restbed::OK, rema.motion_jobs.list());
+}
+
+void jobs_get(const std::shared_ptr<restbed::Session>& rest_session) {
+    const auto request = rest_session->get_request();
+    uint64_t job_id = request->get_path_parameter("job_id", static_cast<uint64_t>(0));
+
+    if (auto job = rema.motion_jobs.get(job_id)) {
+        close_rest_session(rest_session, restbed::OK, *job);
+    } else {
+        close_rest_session(rest_session, restbed::NOT_FOUND, nlohmann::json({ { "error", "Job not found" } }));
+    }
+}
+
+void jobs_cancel(const std::shared_ptr<restbed::Session>& rest_session) {
+    const auto request = rest_session->get_request();
+    uint64_t job_id = request->get_path_parameter("job_id", static_cast<uint64_t>(0));
+
+    if (!rema.motion_jobs.get(job_id)) {
+        close_rest_session(rest_session, restbed::NOT_FOUND, nlohmann::json({ { "error", "Job not found" } }));
+    } else if (!rema.motion_jobs.cancel(job_id)) {
+        close_rest_session(rest_session, restbed::CONFLICT, nlohmann::json({ { "error", "Job already finished" } }));
+    } else {
+        close_rest_session(rest_session, restbed::OK);
+    }
+}
+
+void plans_run(const std::shared_ptr<restbed::Session>& rest_session) {
+    const auto request = rest_session->get_request();
+    size_t content_length = request->get_header("Content-Length", 0);
+
+    rest_session->fetch(
+        content_length, [](const std::shared_ptr<restbed::Session>& rest_session_ptr, const restbed::Bytes& body) {
+            std::string plan = rest_session_ptr->get_request()->get_path_parameter("plan", "");
+            PlanRunOptions options;
+            try {
+                if (!body.empty()) {
+                    options = nlohmann::json::parse(body.begin(), body.end()).get<PlanRunOptions>();
+                }
+            } catch (std::exception& e) {
+                close_rest_session(rest_session_ptr, restbed::BAD_REQUEST, nlohmann::json({ { "error", e.what() } }));
+                return;
+            }
+
+            start_motion_job(
+                rest_session_ptr,
+                "run_plan",
+                { { "plan", plan }, { "options", options } },
+                [plan, options](MotionJobs::Context &job) { return plan_runner.run(job, plan, options); });
+        });
+}
+
+void plan_runner_status(const std::shared_ptr<restbed::Session>& rest_session) {
+    close_rest_session(rest_session, restbed::OK, plan_runner.status());
+}
+
+void plan_runner_control(const std::shared_ptr<restbed::Session>& rest_session) {
+    const auto request = rest_session->get_request();
+    std::string action = request->get_path_parameter("action", "");
+
+    if (action == "pause") {
+        plan_runner.pause();
+    } else if (action == "resume") {
+        plan_runner.resume();
+    } else if (action == "skip") {
+        plan_runner.skip();
+    } else if (action == "inspection-done") {
+        plan_runner.inspection_done();
+    } else {
+        close_rest_session(rest_session, restbed::BAD_REQUEST, nlohmann::json({ { "error", "Unknown action" } }));
+        return;
+    }
+    close_rest_session(rest_session, restbed::OK, plan_runner.status());
+}
+
 void go_to_tube(const std::shared_ptr<restbed::Session>& rest_session) {
     const auto request = rest_session->get_request();
     std::string tube_id = request->get_path_parameter("tube_id", "");
 
-    if (!tube_id.empty()) {
-        Tool tool = rema.get_selected_tool();
-        Point3D rema_coords = current_session.from_ui_to_rema(current_session.get_tube_coordinates(tube_id, false), &tool);
-
-        movement_cmd goto_tube;
-        goto_tube.axes = "XY";
-        goto_tube.first_axis_setpoint = rema_coords.x;
-        goto_tube.second_axis_setpoint = rema_coords.y;
-        
-        chart.init("go_to_tube");
-        nlohmann::json res = rema.move_closed_loop(goto_tube);
-        
-        close_rest_session(rest_session, restbed::OK, res);
+    if (tube_id.empty()) {
+        close_rest_session(rest_session, restbed::BAD_REQUEST, nlohmann::json({ { "error", "Tube ID missing" } }));
+        return;
     }
+
+    start_motion_job(rest_session, "go_to_tube", { { "tube_id", tube_id } }, [tube_id](MotionJobs::Context &job) {
+        return go_to_tube_job(job, tube_id);
+    });
 }
 
 void move_joystick(const std::shared_ptr<restbed::Session>& rest_session) {
@@ -470,10 +813,8 @@ void move_joystick(const std::shared_ptr<restbed::Session>& rest_session) {
         pars_obj["first_axis_setpoint"] = MAX_NEGATIVE_SETPOINT;
     }
 
-    rema.axes_soft_stop_all();
-    
     chart.init("joystick");
-    nlohmann::json res = rema.execute_command("MOVE_JOYSTICK", pars_obj);
+    nlohmann::json res = rema.axes_soft_stop_all_and_execute("MOVE_JOYSTICK", pars_obj);
     
     close_rest_session(rest_session, restbed::OK, res);
 }
@@ -501,28 +842,23 @@ void network_settings(const std::shared_ptr<restbed::Session>& rest_session) {
                     rema.config["REMA"]["network"]["port"] = rtu_port;
                     rema.save_config();
 
-                    rema.telemetry_client.close();      // Doing this else wont connect after restart
-                    rema.logs_client.close();           // Doing this else wont connect after restart
-                    // Do not close rema.command_client becaus it is needed to send the network parameters
-
                     pars["ipaddr"] = rtu_host;
                     pars["port"] = rtu_port;
                     pars["gw"] = form_data["ipaddr"];
                     pars["netmask"] = "255.255.255.0";
-                    rema.execute_command_no_wait("NETWORK_SETTINGS", pars);
-
-                    for (int retry = 0; retry < 3; ++retry) {
-                        try {
-                            rema.connect(rtu_host, rtu_port);
-                        } catch (const std::exception &e) {
-                            std::this_thread::sleep_for(std::chrono::milliseconds(1000));
-                            SPDLOG_INFO("Retrying...");
-                        }
-                        if (rema.command_client.is_connected && rema.telemetry_client.is_connected) {
-                            break;
-                        }
+                    // Switching the links right away would close the command link before REMA answers on the
+                    // old address. Waits for the response, or its timeout, for at most command_timeout.
+                    auto response = rema.execute_command_async("NETWORK_SETTINGS", pars);
+                    try {
+                        response.get();
+                    } catch (const std::exception &e) {
+                        SPDLOG_WARN("NETWORK_SETTINGS not answered: {}", e.what());
                     }
-                    close_rest_session(rest_session_ptr, restbed::OK);                    
+
+                    // The links drop and come back up on the new address in the background
+                    rema.connect(rtu_host, rtu_port);
+                    close_rest_session(rest_session_ptr, restbed::OK);
+                    return;
                 }
                 close_rest_session(rest_session_ptr, restbed::BAD_REQUEST);
             } else {
@@ -543,31 +879,30 @@ void move_incremental(const std::shared_ptr<restbed::Session>& rest_session) {
             double incremental_x = 0.0;
             double incremental_y = 0.0;
             double incremental_z = 0.0;
+            auto session = session_cache.current();
             if (form_data.contains("incremental_x")) {
                 incremental_x = to_double(form_data["incremental_x"]);
                 if (!equals(incremental_x, 0)) {
                     pars_obj["axes"] = "XY";
-                    pars_obj["first_axis_delta"] = current_session.from_ui_to_rema(incremental_x);
+                    pars_obj["first_axis_delta"] = session->from_ui_to_rema(incremental_x);
                 }
             }
             if (form_data.contains("incremental_y")) {
                 incremental_y = to_double(form_data["incremental_y"]);
                 if (!equals(incremental_y, 0)) {
                     pars_obj["axes"] = "XY";
-                    pars_obj["second_axis_delta"] = current_session.from_ui_to_rema(incremental_y);
+                    pars_obj["second_axis_delta"] = session->from_ui_to_rema(incremental_y);
                 }
             }
             if (form_data.contains("incremental_z")) {
                 incremental_z = to_double(form_data["incremental_z"]);
                 if (!equals(incremental_z, 0)) {
                     pars_obj["axes"] = "Z";
-                    pars_obj["first_axis_delta"] = current_session.from_ui_to_rema(incremental_z);
+                    pars_obj["first_axis_delta"] = session->from_ui_to_rema(incremental_z);
                 }
             }
-            rema.axes_soft_stop_all();
-            
             chart.init("incremental");
-            nlohmann::json res = rema.execute_command("MOVE_INCREMENTAL", pars_obj);
+            nlohmann::json res = rema.axes_soft_stop_all_and_execute("MOVE_INCREMENTAL", pars_obj);
 
             close_rest_session(rest_session_ptr, restbed::OK, res);
         });
@@ -578,11 +913,12 @@ void set_home_xyz(const std::shared_ptr<restbed::Session>& rest_session) {
 
     const auto request = rest_session->get_request();
     std::string tube_id = request->get_path_parameter("tube_id", "");
+    auto session = session_cache.current();
     if (!tube_id.empty()) {
-        Point3D tube_coords = current_session.from_ui_to_rema(current_session.get_tube_coordinates(tube_id, false), &tool);
+        Point3D tube_coords = session->from_ui_to_rema(session->get_tube_coordinates(tube_id, false), &tool);
         rema.set_home_xyz(tube_coords);
     } else {
-        Point3D zero_coords = current_session.from_ui_to_rema(Point3D(), &tool);
+        Point3D zero_coords = session->from_ui_to_rema(Point3D(), &tool);
         rema.set_home_xyz(zero_coords);
     }
     close_rest_session(rest_session, restbed::OK);
@@ -594,11 +930,12 @@ void set_home_xy(const std::shared_ptr<restbed::Session>& rest_session) {
 
     const auto request = rest_session->get_request();
     std::string tube_id = request->get_path_parameter("tube_id", "");
+    auto session = session_cache.current();
     if (!tube_id.empty()) {
-        Point3D tube_coords = current_session.from_ui_to_rema(current_session.get_tube_coordinates(tube_id, false), &tool);
+        Point3D tube_coords = session->from_ui_to_rema(session->get_tube_coordinates(tube_id, false), &tool);
         rema.set_home_xy(tube_coords.x, tube_coords.y);
     } else {
-        Point3D zero_coords = current_session.from_ui_to_rema(Point3D(), &tool);
+        Point3D zero_coords = session->from_ui_to_rema(Point3D(), &tool);
         rema.set_home_xy(zero_coords.x, zero_coords.y);
     }
     close_rest_session(rest_session, restbed::OK);
@@ -612,202 +949,45 @@ void set_home_z(const std::shared_ptr<restbed::Session>& rest_session) {
 
     nlohmann::json res;
 
-    double corrected_z = current_session.from_ui_to_rema(z) + tool.offset.z;
+    auto session = session_cache.current();
+    double corrected_z = session->from_ui_to_rema(z) + tool.offset.z;
     rema.set_home_z(corrected_z);
     close_rest_session(rest_session, restbed::OK, res);
 }
 
 void determine_tube_center(const std::shared_ptr<restbed::Session>& rest_session) {
-    Tool tool = rema.get_selected_tool();
-    double touch_probe_radius_inch = 0.085;
-    double probe_wiggle_factor = 1.2;
     const auto request = rest_session->get_request();
     std::string tube_id = request->get_path_parameter("tube_id", "");
     bool set_home = request->get_path_parameter("set_home", "") == "true";
 
-    nlohmann::json res;
-
-    if (!tube_id.empty()) {
-        double tube_radius = current_session.hx.tube_od / 2;
-        Point3D ideal_center = current_session.get_tube_coordinates(tube_id, true);
-        Point3D initial_center = rema.telemetry.coords;
-
-        constexpr int points_number = 3;
-        static_assert(points_number % 2 != 0, "Number of points must be odd");
-        std::vector<Point3D> points = calculateCirclePoints(
-            initial_center,
-            current_session.from_ui_to_rema(tube_radius) * probe_wiggle_factor,
-            points_number);
-
-        std::vector<movement_cmd> seq;
-        int vertex = 0;
-        for (int n = 0; n < points_number; n++) {
-            Point3D point = points[vertex % points_number]; // To touch the tube boundary following a star pattern
-            movement_cmd step;
-            step.axes = "XY";
-            step.first_axis_setpoint = point.x;
-            step.second_axis_setpoint = point.y;
-            step.is_relevant = true;
-            seq.push_back(step);
-
-            step.first_axis_setpoint = initial_center.x;    // Go back to initial center
-            step.second_axis_setpoint = initial_center.y;
-            seq.push_back(step);
-
-            vertex += 2;
-        }
-        seq.pop_back();     // Remove the last "Go back to initial center" sequence step
-
-        chart.init("determine_tube_center");
-        auto seq_execution_response = rema.execute_sequence(seq);
-        
-        if (!seq_execution_response) {
-            res["error"] = seq_execution_response.error();
-            std::cout << nlohmann::to_string(res) << std::endl;
-            close_rest_session(rest_session, restbed::CONFLICT, res);
-            return;
-        }
-
-        std::vector<Point3D> tube_boundary_points;
-
-        for (const auto &step : seq) {
-            if (step.is_relevant && step.executed && (step.execution_results.stopped_on_probe || step.execution_results.stopped_on_condition)) {
-                tube_boundary_points.push_back(step.execution_results.coords);
-            }
-        }
-
-        int status = restbed::OK;
-        Circle circle = CircleFitByHyper(tube_boundary_points);
-
-        movement_cmd goto_center;
-        goto_center.axes = "XY";
-        goto_center.first_axis_setpoint = circle.center.x;
-        goto_center.second_axis_setpoint = circle.center.y;
-
-        res["center"] = { { "x", circle.center.x - tool.offset.x },
-                            { "y", circle.center.y - tool.offset.y },
-                            { "z", circle.center.z } };
-        res["radius"] = circle.radius + touch_probe_radius_inch;
-
-        seq_execution_response = rema.execute_sequence(goto_center);
-        if (!seq_execution_response) {
-            res["error"] = seq_execution_response.error();
-            std::cout << nlohmann::to_string(res) << std::endl;
-            close_rest_session(rest_session, restbed::CONFLICT, res);
-            status = restbed::CONFLICT;
-        } else if (set_home) {
-            if (goto_center.executed && goto_center.execution_results.stopped_on_condition) {
-                rema.set_home_xy(
-                    current_session.from_ui_to_rema(ideal_center.x) + tool.offset.x,
-                    current_session.from_ui_to_rema(ideal_center.y) + tool.offset.y);
-            }
-        }
-
-        close_rest_session(rest_session, status, res);
+    if (tube_id.empty()) {
+        close_rest_session(rest_session, restbed::BAD_REQUEST, nlohmann::json({ { "error", "Tube ID missing" } }));
+        return;
     }
+
+    start_motion_job(
+        rest_session,
+        "determine_tube_center",
+        { { "tube_id", tube_id }, { "set_home", set_home } },
+        [tube_id, set_home](MotionJobs::Context &job) { return determine_tube_center_job(job, tube_id, set_home); });
 }
 
 void determine_tubesheet_z(const std::shared_ptr<restbed::Session>& rest_session) {
-    Tool tool = rema.get_selected_tool();
     const auto request = rest_session->get_request();
-    std::string tube_id = request->get_path_parameter("tube_id", "");
     bool set_home = request->get_path_parameter("set_home", "") == "true";
 
-    nlohmann::json res;
-    movement_cmd first_touch_search;
-    first_touch_search.axes = "Z";
-    first_touch_search.first_axis_setpoint = MAX_POSITIVE_SETPOINT;
-    first_touch_search.second_axis_setpoint = 0;
-
-    chart.init("determine_tubesheet_z");
-    auto seq_execution_response = rema.execute_sequence(first_touch_search);
-    
-    if (!seq_execution_response) {
-        res["error"] = seq_execution_response.error();
-        std::cout << nlohmann::to_string(res) << std::endl;
-        close_rest_session(rest_session, restbed::CONFLICT, res);
-        return;
-    }
-
-    if (!(first_touch_search.executed && first_touch_search.execution_results.stopped_on_probe)) {
-        res["error"] = "Touch probe didn't touch tubesheet";
-        close_rest_session(rest_session, restbed::CONFLICT, res);
-        return;        
-    } 
-    
-    double first_touch_z = first_touch_search.execution_results.coords.z;
-    
-    std::vector<movement_cmd> seq;
-    movement_cmd backwards;
-    backwards.axes = "Z";
-    backwards.first_axis_setpoint = first_touch_z - 0.1;
-    backwards.second_axis_setpoint = 0;
-    seq.push_back(backwards);
-
-    movement_cmd second_touch_search;
-    second_touch_search.axes = "Z";
-    second_touch_search.first_axis_setpoint = first_touch_z + 0.1;
-    second_touch_search.second_axis_setpoint = 0;
-    second_touch_search.is_relevant = true;
-    seq.push_back(second_touch_search);
-
-    seq.push_back(backwards);
-
-    seq_execution_response = rema.execute_sequence(seq);
-    
-    if (!seq_execution_response) {
-        res["error"] = seq_execution_response.error();
-        std::cout << nlohmann::to_string(res) << std::endl;
-        close_rest_session(rest_session, restbed::CONFLICT, res);
-        return;
-    }
-    
-    double sum_z = first_touch_z;
-    bool second_touch_found = false;
-    for (auto &step : seq) {
-        if (step.executed && step.is_relevant && step.execution_results.stopped_on_probe) {
-            sum_z += step.execution_results.coords.z;
-            second_touch_found = true;
-        }
-    }
-
-    if (!second_touch_found) {
-        res["error"] = "Touch probe didn't touch tubesheet the second time";
-        close_rest_session(rest_session, restbed::CONFLICT, res);
-        return;
-    }
-    
-    double z = sum_z / 2;
-
-    int status = restbed::OK;
-    movement_cmd goto_tubesheet;
-    goto_tubesheet.axes = "Z";
-    goto_tubesheet.first_axis_setpoint = z;
-    goto_tubesheet.second_axis_setpoint = 0;
-
-    seq_execution_response = rema.execute_sequence(goto_tubesheet);
-    if (!seq_execution_response) {
-        res["error"] = seq_execution_response.error();
-        std::cout << nlohmann::to_string(res) << std::endl;
-        close_rest_session(rest_session, restbed::RESET_CONTENT, res);
-        status = restbed::RESET_CONTENT;
-    } else {
-        if (goto_tubesheet.executed) {
-            if (set_home) {
-                rema.set_home_z(0);
-            } else {
-                res["z"] = current_session.from_rema_to_ui(z) + tool.offset.z;
-            }
-        }
-    }
-
-    close_rest_session(rest_session, status, res);
+    start_motion_job(
+        rest_session,
+        "determine_tubesheet_z",
+        { { "set_home", set_home } },
+        [set_home](MotionJobs::Context &job) { return determine_tubesheet_z_job(job, set_home); });
 }
 
 void aligned_tubesheet_get(const std::shared_ptr<restbed::Session>& rest_session) {
     nlohmann::json res;
-    res["aligned_tubes"] = current_session.calculate_aligned_tubes();
-    res["is_aligned"] = current_session.is_aligned;
+    auto session = session_cache.current();
+    res["aligned_tubes"] = session->calculate_aligned_tubes();
+    res["is_aligned"] = session->is_aligned;
 
     close_rest_session(rest_session, restbed::OK, res);
 }
@@ -863,6 +1043,10 @@ void restfull_api_create_endpoints(restbed::Service &service) {
         { "HXs/tubesheet/load", { { "GET", &HXs_tubesheet_load } } },
         { "plans", { { "GET", &plans } } },
         { "plans/{plan: .*}", { { "GET", &plans }, { "DELETE", &plans_delete } } },
+        { "plans/{plan: .*}/optimize", { { "POST", &plans_optimize } } },
+        { "plans/{plan: .*}/run", { { "POST", &plans_run } } },
+        { "plan-runner", { { "GET", &plan_runner_status } } },
+        { "plan-runner/{action: .*}", { { "POST", &plan_runner_control } } },
         { "tools",
           {
               { "GET", &tools_list },
@@ -883,14 +1067,17 @@ void restfull_api_create_endpoints(restbed::Service &service) {
         { "calibration-points", { { "GET", &cal_points_list } } },
         { "calibration-points/{tube_id: .*}", { { "PUT", &cal_points_add_update }, { "DELETE", &cal_points_delete } } },
         { "tubes/{tube_id: .*}", { { "PUT", &tubes_set_status } } },
-        { "go-to-tube/{tube_id: .*}", { { "GET", &go_to_tube } } },
+        { "tube-hit-test/{x: .*}/{y: .*}", { { "GET", &tubes_hit_test } } },
+        { "jobs", { { "GET", &jobs_list } } },
+        { "jobs/{job_id: [0-9]+}", { { "GET", &jobs_get }, { "DELETE", &jobs_cancel } } },
+        { "go-to-tube/{tube_id: .*}", { { "POST", &go_to_tube } } },
         { "move-joystick/{dir: .*}", { { "GET", &move_joystick } } },
         { "move-incremental", { { "POST", &move_incremental } } },
-        { "determine-tube-center/{tube_id: .*}/{set_home: .*}", { { "GET", &determine_tube_center } } },
+        { "determine-tube-center/{tube_id: .*}/{set_home: .*}", { { "POST", &determine_tube_center } } },
         { "set-home-xyz/", { { "GET", &set_home_xyz } } },
         { "set-home-xy/", { { "GET", &set_home_xy } } },
         { "set-home-xy/{tube_id: .*}", { { "GET", &set_home_xy } } },
-        { "determine-tubesheet-z/{set_home: .*}", { { "GET", &determine_tubesheet_z } } },
+        { "determine-tubesheet-z/{set_home: .*}", { { "POST", &determine_tubesheet_z } } },
         { "set-home-z/{z: .*}", { { "GET", &set_home_z } } },
         { "aligned-tubesheet-get", { { "GET", &aligned_tubesheet_get } } },
         { "axes-hard-stop-all", { { "GET", &axes_hard_stop_all } } },
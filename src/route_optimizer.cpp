@@ -0,0 +1,292 @@
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <numeric>
+#include <queue>
+
+#include "route_optimizer.hpp"
+
+namespace {
+constexpr size_t NeighbourCount = 10; // Candidate tubes considered next to each tube
+constexpr size_t MaxSegment = 3;      // Longest chain of tubes moved by Or-opt
+constexpr double MinGain = 1e-9;
+
+class RouteImprover {
+  public:
+    RouteImprover(const std::vector<RouteStop> &stops, std::chrono::steady_clock::time_point deadline_)
+        : n(stops.size()), deadline(deadline_) {
+        xs.reserve(n);
+        ys.reserve(n);
+        for (const auto &stop : stops) {
+            xs.push_back(stop.coords.x);
+            ys.push_back(stop.coords.y);
+        }
+    }
+
+    std::vector<size_t> run() {
+        find_neighbours();
+        nearest_neighbour_path();
+
+        bool improved = true;
+        while (improved && std::chrono::steady_clock::now() < deadline) {
+            improved = false;
+            for (size_t a = 0; a < n; a++) {
+                improved |= two_opt(a);
+                improved |= or_opt(a);
+            }
+        }
+        return path;
+    }
+
+  private:
+    double distance(size_t a, size_t b) const {
+        double dx = xs[a] - xs[b];
+        double dy = ys[a] - ys[b];
+        return std::sqrt(dx * dx + dy * dy);
+    }
+
+    // Distance between the stops at two path positions. The path is open: past either end there is nothing to
+    // travel to, so those edges cost nothing.
+    double at(ptrdiff_t i, ptrdiff_t j) const {
+        if (i < 0 || j < 0 || i >= static_cast<ptrdiff_t>(n) || j >= static_cast<ptrdiff_t>(n)) {
+            return 0;
+        }
+        return distance(path[i], path[j]);
+    }
+
+    // The closest stops of every stop, scanning outwards along X until no closer stop can be found
+    void find_neighbours() {
+        std::vector<size_t> by_x(n);
+        std::iota(by_x.begin(), by_x.end(), 0);
+        std::sort(by_x.begin(), by_x.end(), [&](size_t a, size_t b) { return xs[a] < xs[b]; });
+
+        neighbours.assign(n, {});
+        for (size_t k = 0; k < n; k++) {
+            size_t a = by_x[k];
+            std::priority_queue<std::pair<double, size_t>> closest; // Max-heap, the farthest candidate on top
+            auto consider = [&](size_t b) {
+                double d = distance(a, b);
+                if (closest.size() < NeighbourCount) {
+                    closest.emplace(d, b);
+                } else if (d < closest.top().first) {
+                    closest.pop();
+                    closest.emplace(d, b);
+                }
+            };
+            auto out_of_reach = [&](size_t b) {
+                return closest.size() == NeighbourCount && std::fabs(xs[b] - xs[a]) > closest.top().first;
+            };
+
+            for (size_t l = k + 1; l < n && !out_of_reach(by_x[l]); l++) {
+                consider(by_x[l]);
+            }
+            for (size_t l = k; l-- > 0 && !out_of_reach(by_x[l]);) {
+                consider(by_x[l]);
+            }
+
+            neighbours[a].resize(closest.size());
+            for (size_t i = closest.size(); i-- > 0;) {
+                neighbours[a][i] = closest.top().second;
+                closest.pop();
+            }
+        }
+    }
+
+    void nearest_neighbour_path() {
+        std::vector<size_t> remaining(n);
+        std::iota(remaining.begin(), remaining.end(), 0);
+
+        path.clear();
+        path.reserve(n);
+        size_t current = 0;
+        remaining[0] = remaining.back();
+        remaining.pop_back();
+        path.push_back(current);
+
+        while (!remaining.empty()) {
+            size_t best = 0;
+            double best_distance = distance(current, remaining[0]);
+            for (size_t i = 1; i < remaining.size(); i++) {
+                if (double d = distance(current, remaining[i]); d < best_distance) {
+                    best_distance = d;
+                    best = i;
+                }
+            }
+            current = remaining[best];
+            remaining[best] = remaining.back();
+            remaining.pop_back();
+            path.push_back(current);
+        }
+        update_positions();
+    }
+
+    void update_positions() {
+        pos.resize(n);
+        for (size_t i = 0; i < n; i++) {
+            pos[path[i]] = i;
+        }
+    }
+
+    // Gain of reversing path[lo..hi]
+    double reversal_gain(ptrdiff_t lo, ptrdiff_t hi) const {
+        return at(lo - 1, lo) + at(hi, hi + 1) - at(lo - 1, hi) - at(lo, hi + 1);
+    }
+
+    // Makes a adjacent to one of its neighbours by reversing the stretch of path in between
+    bool two_opt(size_t a) {
+        for (size_t c : neighbours[a]) {
+            auto i = static_cast<ptrdiff_t>(pos[a]);
+            auto j = static_cast<ptrdiff_t>(pos[c]);
+            std::pair<ptrdiff_t, ptrdiff_t> candidates[2] = { { i + 1, j }, { i, j - 1 } }; // a then c
+            if (j < i) {
+                candidates[0] = { j + 1, i }; // c then a
+                candidates[1] = { j, i - 1 };
+            }
+            for (auto [lo, hi] : candidates) {
+                if (lo < hi && reversal_gain(lo, hi) > MinGain) {
+                    std::reverse(path.begin() + lo, path.begin() + hi + 1);
+                    for (ptrdiff_t k = lo; k <= hi; k++) {
+                        pos[path[k]] = k;
+                    }
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    // Moves the chain of 1 to MaxSegment stops starting at a next to a neighbour of either end of the chain,
+    // in whichever direction is shorter
+    bool or_opt(size_t a) {
+        auto i = static_cast<ptrdiff_t>(pos[a]);
+        for (size_t length = 1; length <= MaxSegment; length++) {
+            auto last = i + static_cast<ptrdiff_t>(length) - 1;
+            if (last >= static_cast<ptrdiff_t>(n)) {
+                break;
+            }
+            double removal_gain = at(i - 1, i) + at(last, last + 1) - at(i - 1, last + 1);
+            if (removal_gain <= MinGain) {
+                continue;
+            }
+
+            for (size_t end : { path[i], path[last] }) {
+                for (size_t c : neighbours[end]) {
+                    auto j = static_cast<ptrdiff_t>(pos[c]);
+                    if (j >= i && j <= last) {
+                        continue;
+                    }
+                    // Insert between x and x + 1, either side of c
+                    for (ptrdiff_t x : { j - 1, j }) {
+                        ptrdiff_t y = x + 1;
+                        if ((x >= i - 1 && x <= last) || (y >= i && y <= last + 1)) {
+                            continue; // Touches the chain or its current place
+                        }
+                        double forward = at(x, i) + at(last, y);
+                        double reversed = at(x, last) + at(i, y);
+                        double insertion_cost = std::min(forward, reversed) - at(x, y);
+                        if (removal_gain - insertion_cost > MinGain) {
+                            move_chain(i, last, x, reversed < forward);
+                            return true;
+                        }
+                    }
+                }
+            }
+        }
+        return false;
+    }
+
+    // Moves path[first..last] right after position x (-1 for the front)
+    void move_chain(ptrdiff_t first, ptrdiff_t last, ptrdiff_t x, bool reverse) {
+        std::vector<size_t> chain(path.begin() + first, path.begin() + last + 1);
+        if (reverse) {
+            std::reverse(chain.begin(), chain.end());
+        }
+        std::vector<size_t> moved;
+        moved.reserve(n);
+        if (x < 0) {
+            moved.insert(moved.end(), chain.begin(), chain.end());
+        }
+        for (ptrdiff_t k = 0; k < static_cast<ptrdiff_t>(n); k++) {
+            if (k < first || k > last) {
+                moved.push_back(path[k]);
+            }
+            if (k == x) {
+                moved.insert(moved.end(), chain.begin(), chain.end());
+            }
+        }
+        path.swap(moved);
+        update_positions();
+    }
+
+    size_t n;
+    std::chrono::steady_clock::time_point deadline;
+    std::vector<double> xs;
+    std::vector<double> ys;
+    std::vector<std::vector<size_t>> neighbours;
+    std::vector<size_t> path;
+    std::vector<size_t> pos; // Position of every stop in path
+};
+
+std::vector<size_t> sweep_route(const std::vector<RouteStop> &stops, RouteSweep sweep) {
+    bool rows = sweep == RouteSweep::ROWS;
+    auto along = [&](size_t i) { return rows ? stops[i].coords.x : stops[i].coords.y; };
+    auto across = [&](size_t i) { return rows ? stops[i].coords.y : stops[i].coords.x; };
+
+    std::map<std::string, std::vector<size_t>> lines;
+    for (size_t i = 0; i < stops.size(); i++) {
+        lines[rows ? stops[i].row : stops[i].col].push_back(i);
+    }
+
+    // Lines ordered by their mean position across the sweep direction
+    std::vector<std::pair<double, std::vector<size_t> *>> ordered;
+    for (auto &[label, line] : lines) {
+        double sum = 0;
+        for (size_t i : line) {
+            sum += across(i);
+        }
+        ordered.emplace_back(sum / static_cast<double>(line.size()), &line);
+    }
+    std::sort(ordered.begin(), ordered.end(), [](const auto &a, const auto &b) { return a.first < b.first; });
+
+    std::vector<size_t> route;
+    route.reserve(stops.size());
+    bool forward = true;
+    for (auto &[position, line] : ordered) {
+        std::sort(line->begin(), line->end(), [&](size_t a, size_t b) {
+            return forward ? along(a) < along(b) : along(a) > along(b);
+        });
+        route.insert(route.end(), line->begin(), line->end());
+        forward = !forward;
+    }
+    return route;
+}
+} // namespace
+
+double route_length(const std::vector<RouteStop> &stops, const std::vector<size_t> &order) {
+    double length = 0;
+    for (size_t i = 1; i < order.size(); i++) {
+        length += stops[order[i - 1]].coords.distance_xy(stops[order[i]].coords);
+    }
+    return length;
+}
+
+std::vector<size_t> optimize_route(const std::vector<RouteStop> &stops, const RouteOptions &options) {
+    if (stops.size() < 3) {
+        std::vector<size_t> order(stops.size());
+        std::iota(order.begin(), order.end(), 0);
+        return order;
+    }
+
+    std::vector<size_t> route;
+    if (options.sweep == RouteSweep::NONE) {
+        route = RouteImprover(stops, std::chrono::steady_clock::now() + options.time_limit).run();
+    } else {
+        route = sweep_route(stops, options.sweep);
+    }
+
+    const Point3D &start = stops[0].coords;
+    if (stops[route.back()].coords.distance_xy(start) < stops[route.front()].coords.distance_xy(start)) {
+        std::reverse(route.begin(), route.end());
+    }
+    return route;
+}
@@ -2,13 +2,17 @@
 #include <open3d/Open3D.h>
 #include <spdlog/spdlog.h>
 
+#include <algorithm>
+#include <chrono>
 #include <csv.hpp>
 #include <fstream>
 #include <iostream>
 #include <map>
+#include <numeric>
 #include <string>
 
 #include "session.hpp"
+#include "session_saver.hpp"
 
 Session::Session() : transformation_matrix(Eigen::Matrix4d::Identity()) {};
 
@@ -20,27 +24,96 @@ Session::Session(const std::filesystem::path& session_file) {
 Session::Session(const std::string& session_name, const std::filesystem::path& hx_dir_)
     : name(session_name), hx_dir(hx_dir_) {
     Session();
-    hx.process_csv_from_disk(hx_dir);
-    hx.generate_svg();
+    hx.load_from_disk(hx_dir);
 }
 
 void Session::delete_session(std::string session_name) {
     std::filesystem::remove(sessions_dir / (session_name + std::string(".json")));
+    std::filesystem::remove(sessions_dir / (session_name + std::string(".journal")));
+}
+
+std::filesystem::path Session::file_path() const {
+    return sessions_dir / (name + std::string(".json"));
+}
+
+std::filesystem::path Session::journal_path() const {
+    return sessions_dir / (name + std::string(".journal"));
 }
 
 bool Session::load(const std::string& session_name) {
-    std::filesystem::path session_path = sessions_dir / (session_name + std::string(".json"));
-    std::ifstream i_file_stream(session_path);
+    name = session_name;
+    std::ifstream i_file_stream(file_path());
 
     // nlohmann::json json;
     // i_file_stream >> json;
     from_json_from_disk(nlohmann::json::parse(i_file_stream));
+    replay_journal();
 
     is_loaded = true;
-    name = session_name;
     return true;
 }
 
+// A record cut short by a crash can only be the last one. It is dropped, and cut off the file so the next records
+// are not appended after it.
+void Session::replay_journal() {
+    journal_size = 0;
+    std::ifstream journal(journal_path(), std::ios::binary);
+    if (!journal.is_open()) {
+        return;
+    }
+
+    std::string line;
+    size_t records = 0;
+    while (std::getline(journal, line)) {
+        auto record = nlohmann::json::parse(line, nullptr, false);
+        if (journal.eof() || record.is_discarded()) {
+            SPDLOG_WARN("Session {}: incomplete journal record dropped", name);
+            journal.close();
+            std::filesystem::resize_file(journal_path(), journal_size);
+            break;
+        }
+        apply_journal_record(record);
+        journal_size += line.size() + 1;
+        records++;
+    }
+    SPDLOG_INFO("Session {}: {} journal records replayed", name, records);
+}
+
+void Session::apply_journal_record(const nlohmann::json& record) {
+    const std::string op = record.at("op");
+    if (op == "tube_executed") {
+        plans[record.at("plan")][record.at("tube")].executed = record.at("executed");
+    } else if (op == "select_plan") {
+        last_selected_plan = record.at("plan");
+    } else if (op == "plan") {
+        plans[record.at("plan")] = record.at("entries").get<std::map<std::string, PlanEntry>>();
+    } else if (op == "plan_remove") {
+        plans.erase(record.at("plan").get<std::string>());
+        last_selected_plan = "";
+    } else if (op == "cal_point") {
+        cal_points[record.at("tube")] = record.at("entry").get<CalPointEntry>();
+    } else if (op == "cal_point_delete") {
+        cal_points.erase(record.at("tube").get<std::string>());
+    } else {
+        SPDLOG_WARN("Session {}: unknown journal record {}", name, op);
+    }
+}
+
+void Session::append_to_journal(const std::vector<nlohmann::json>& records) {
+    std::string lines;
+    for (const auto& record : records) {
+        lines += record.dump();
+        lines += '\n';
+    }
+    std::ofstream journal(journal_path(), std::ios::binary | std::ios::app);
+    journal.write(lines.data(), static_cast<std::streamsize>(lines.size()));
+    if (!journal.flush()) {
+        throw std::runtime_error("Error writing " + journal_path().string());
+    }
+    std::lock_guard<std::mutex> lock(mtx);
+    journal_size += lines.size();
+}
+
 void Session::load_plan(const std::string& plan_name, std::istream& stream) {
     // Parse the CSV file to extract the data for the plan
     io::CSVReader<4, io::trim_chars<' ', '\t'>, io::no_quote_escape<';'>> ip(plan_name, stream);
@@ -48,6 +121,7 @@ void Session::load_plan(const std::string& plan_name, std::istream& stream) {
     int seq;
     std::string row, col;
     std::string tube_num;
+    std::lock_guard<std::mutex> lock(mtx);
     while (ip.read_row(seq, row, col, tube_num)) {
         std::string tube_num_stripped = tube_num.substr(5);
         plans[plan_name][tube_num_stripped] = PlanEntry{ seq, row, col, false };
@@ -78,6 +152,7 @@ std::string Session::load_plans() {
 }
 
 std::map<std::string, PlanEntry> Session::plan_get(const std::string& plan) {
+    std::lock_guard<std::mutex> lock(mtx);
     last_selected_plan = plan;
 
     auto it = plans.find(plan);
@@ -89,12 +164,81 @@ std::map<std::string, PlanEntry> Session::plan_get(const std::string& plan) {
 }
 
 void Session::plan_remove(const std::string& plan) {
+    std::lock_guard<std::mutex> lock(mtx);
     last_selected_plan = "";
 
     auto it = plans.find(plan);
     if (it != plans.end()) {
         plans.erase(it);
+        mark_changed({ { "op", "plan_remove" }, { "plan", plan } });
+    }
+}
+
+tl::expected<nlohmann::json, std::string> Session::plan_optimize_route(
+    const std::string& plan, const RouteOptions& options, bool apply) {
+    std::lock_guard<std::mutex> lock(mtx);
+    auto it = plans.find(plan);
+    if (it == plans.end()) {
+        return tl::make_unexpected("Plan not found");
+    }
+    auto& entries = it->second;
+
+    // Current order, tubes missing from the HX go last and keep their order
+    std::vector<std::string> ids;
+    std::vector<std::string> missing;
+    for (const auto& [id, entry] : entries) {
+        (hx.tubes.contains(id) ? ids : missing).push_back(id);
     }
+    auto by_seq = [&](const std::string& a, const std::string& b) { return entries[a].seq < entries[b].seq; };
+    std::sort(ids.begin(), ids.end(), by_seq);
+    std::sort(missing.begin(), missing.end(), by_seq);
+
+    std::vector<RouteStop> stops;
+    stops.reserve(ids.size());
+    for (const auto& id : ids) {
+        const PlanEntry& entry = entries[id];
+        stops.push_back({ transform_point_if_aligned(hx.tubes.coords(*hx.tubes.find(id))), entry.row, entry.col });
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<size_t> order = optimize_route(stops, options);
+    auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start);
+
+    std::vector<size_t> current(stops.size());
+    std::iota(current.begin(), current.end(), 0);
+    double length_before = route_length(stops, current);
+    double length_after = route_length(stops, order);
+    if (length_after >= length_before) {
+        // The result is built from scratch (nearest neighbour or sweep), not from the current order: never make it worse
+        SPDLOG_INFO("Plan {} route {:.1f} is not shorter than the current {:.1f}, order kept", plan, length_after,
+            length_before);
+        order = current;
+        length_after = length_before;
+    }
+    SPDLOG_INFO("Plan {} route {:.1f} -> {:.1f} in {:.1f} ms", plan, length_before, length_after, elapsed.count());
+
+    nlohmann::json res;
+    res["tubes"] = ids.size();
+    res["distance_before"] = length_before;
+    res["distance_after"] = length_after;
+    res["elapsed_ms"] = elapsed.count();
+    res["missing_tubes"] = missing;
+    res["order"] = nlohmann::json::array();
+    for (size_t i : order) {
+        res["order"].push_back(ids[i]);
+    }
+    for (const auto& id : missing) {
+        res["order"].push_back(id);
+    }
+
+    if (apply) {
+        int seq = 1;
+        for (const auto& id : res["order"]) {
+            entries[id.get<std::string>()].seq = seq++;
+        }
+        mark_changed({ { "op", "plan" }, { "plan", plan }, { "entries", entries } });
+    }
+    return res;
 }
 
 Point3D Session::from_rema_to_ui(Point3D coords, Tool* tool) {
@@ -121,48 +265,64 @@ double Session::from_ui_to_rema(double meassure) {
     return (meassure / hx.scale);
 }
 
-std::vector<Session> Session::sessions_list() {
-    std::vector<Session> res;
-
-    for (const auto& entry : std::filesystem::directory_iterator(sessions_dir)) {
-        if (entry.is_regular_file()) {
-            std::time_t tt = to_time_t(entry.last_write_time());
-            std::tm* gmt = std::gmtime(&tt);
-            std::stringstream buffer;
-            buffer << std::put_time(gmt, "%A, %d %B %Y %H:%M");
-            std::string formattedFileTime = buffer.str();
-
-            Session session(entry.path().filename().replace_extension());
-            session.last_write_time = buffer.str();
-
-            res.push_back(session);
+// Written next to the file and renamed over it, so a crash while writing never leaves a truncated session. The
+// journal is folded into the new file, so it starts over empty; replaying it over the new file would not change
+// anything either, should the process stop before it is removed.
+void Session::save_to_disk() {
+    std::filesystem::path session_file = file_path();
+    std::filesystem::path tmp_file = session_file;
+    tmp_file += ".tmp";
+
+    std::string contents;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        contents = to_json_to_disk().dump();
+        is_changed = false; // A change made while writing sets it again and is saved by the next write
+    }
+    {
+        std::ofstream file(tmp_file, std::ios::binary | std::ios::trunc);
+        file.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+        if (!file.flush()) {
+            throw std::runtime_error("Error writing " + tmp_file.string());
         }
     }
-    return res;
+    std::filesystem::rename(tmp_file, session_file);
+    std::filesystem::remove(journal_path());
+    std::lock_guard<std::mutex> lock(mtx);
+    journal_size = 0;
 }
 
-void Session::save_to_disk() const {
-    std::filesystem::path session_file = sessions_dir / (name + std::string(".json"));
-    std::ofstream file(session_file);
-    nlohmann::json json = to_json_to_disk();
-    file << json;
+void Session::mark_changed(nlohmann::json record) {
+    is_changed = true;
+    if (auto self = weak_from_this().lock()) {
+        session_saver.changed(std::move(self), std::move(record));
+    }
+}
+
+void Session::plan_changed(const std::string& plan) {
+    std::lock_guard<std::mutex> lock(mtx);
+    mark_changed({ { "op", "plan" }, { "plan", plan }, { "entries", plans[plan] } });
 }
 
 void Session::set_selected_plan(std::string& plan) {
+    std::lock_guard<std::mutex> lock(mtx);
     last_selected_plan = plan;
-    is_changed = true;
+    mark_changed({ { "op", "select_plan" }, { "plan", plan } });
 }
 
 std::string Session::get_selected_plan() const {
+    std::lock_guard<std::mutex> lock(mtx);
     return last_selected_plan;
 }
 
 void Session::set_tube_executed(std::string& plan, std::string& tube_id, bool state) {
+    std::lock_guard<std::mutex> lock(mtx);
     plans[plan][tube_id].executed = state;
-    is_changed = true;
+    mark_changed({ { "op", "tube_executed" }, { "plan", plan }, { "tube", tube_id }, { "executed", state } });
 }
 
 int Session::total_tubes_in_plans() {
+    std::lock_guard<std::mutex> lock(mtx);
     int total = 0;
     for (auto plan : plans) {
         total += plan.second.size();
@@ -171,6 +331,7 @@ int Session::total_tubes_in_plans() {
 }
 
 int Session::total_tubes_executed() {
+    std::lock_guard<std::mutex> lock(mtx);
     int total = 0;
     for (auto& [key, value] : plans) {
         total += std::count_if(value.begin(), value.end(), [](auto& entry) { return entry.second.executed; });
@@ -187,18 +348,20 @@ void Session::cal_points_add_update(
     CalPointEntry cpe = {
         col, row, ideal_coords, determined_coords, true,
     };
+    std::lock_guard<std::mutex> lock(mtx);
     cal_points[tube_id] = cpe;
-    is_changed = true;
+    mark_changed({ { "op", "cal_point" }, { "tube", tube_id }, { "entry", cpe } });
 }
 
 void Session::cal_points_delete(const std::string& tube_id) {
+    std::lock_guard<std::mutex> lock(mtx);
     cal_points.erase(tube_id);
-    is_changed = true;
+    mark_changed({ { "op", "cal_point_delete" }, { "tube", tube_id } });
 }
 
 Point3D Session::get_tube_coordinates(const std::string& tube_id, bool ideal = true) {
-    if (auto iter = hx.tubes.find(tube_id); iter != hx.tubes.end()) {
-        return (ideal ? iter->second.coords : transform_point_if_aligned(iter->second.coords));
+    if (auto tube = hx.tubes.find(tube_id)) {
+        return (ideal ? hx.tubes.coords(*tube) : transform_point_if_aligned(hx.tubes.coords(*tube)));
     }
     return {};
 };
@@ -216,8 +379,24 @@ Point3D Session::transform_point_if_aligned(Point3D point, bool inverse)  {
     }
 }
 
-std::map<std::string, TubeEntry> Session::calculate_aligned_tubes() {
-    std::map<std::string, TubeEntry> aligned_tubes = hx.tubes;
+std::shared_ptr<const TubeIndex> Session::get_tube_index() {
+    TubeIndex::Key key;
+    key.hx_dir = hx_dir.string();
+    key.tubes = hx.tubes.size();
+    key.aligned = is_aligned;
+    key.transformation = transformation_matrix;
+
+    auto index = tube_index.load();
+    if (!index || !(index->key() == key)) {
+        index = std::make_shared<const TubeIndex>(
+            key, hx.tubes.transformed([this](const Point3D& point) { return transform_point_if_aligned(point); }));
+        tube_index.store(index);
+        SPDLOG_INFO("Tube index built over {} tubes{}", index->size(), is_aligned ? " (aligned)" : "");
+    }
+    return index;
+}
+
+TubeTable Session::calculate_aligned_tubes() {
     is_aligned = false;
     SPDLOG_INFO("Aligning Tubes...");
     // std::vector<Point3D> src_points = { { 1.625, 0.704, 0 },
@@ -250,7 +429,7 @@ std::map<std::string, TubeEntry> Session::calculate_aligned_tubes() {
 
     if (used_points < 3) {
         SPDLOG_ERROR("At least 3 alignment points are required");
-        return aligned_tubes;
+        return hx.tubes;
     }
 
     // Set ICP parameters and perform ICP
@@ -286,18 +465,12 @@ std::map<std::string, TubeEntry> Session::calculate_aligned_tubes() {
     is_aligned = true;
 
     // Transform the source point cloud
-    for (const auto& [id, tube] : hx.tubes) {
-        TubeEntry aligned_tube = tube;
-        aligned_tube.coords = transform_point_if_aligned(tube.coords);
-        aligned_tubes[id] = aligned_tube;
-    }
-    return aligned_tubes;
+    return hx.tubes.transformed([this](const Point3D& point) { return transform_point_if_aligned(point); });
 }
 
 nlohmann::json Session::to_json_to_disk() const {
     nlohmann::json json;
-    json["hx_dir"] = hx_dir;
-    json["hx"] = hx;
+    json["hx_dir"] = hx_dir; // The HX itself is read again from hx_dir when the session is loaded
     json["last_selected_plan"] = last_selected_plan;
     json["plans"] = plans;
     json["cal_points"] = cal_points;
@@ -307,7 +480,7 @@ nlohmann::json Session::to_json_to_disk() const {
 void Session::from_json_from_disk(const nlohmann::json& json) {
     const Session nlohmann_json_default_obj{};
     hx_dir = json.value("hx_dir", nlohmann_json_default_obj.hx_dir);
-    hx = json.value("hx", nlohmann_json_default_obj.hx);
+    // Older session files also hold an "hx" copy, it is ignored: the HX is always read again from hx_dir
     last_selected_plan = json.value("last_selected_plan", nlohmann_json_default_obj.last_selected_plan);
     plans = json.value("plans", nlohmann_json_default_obj.plans);
     cal_points = json.value("cal_points", nlohmann_json_default_obj.cal_points);
@@ -0,0 +1,67 @@
+#include <algorithm>
+#include <spdlog/spdlog.h>
+
+#include "session_cache.hpp"
+#include "session_saver.hpp"
+
+std::vector<int64_t> SessionCache::stamp_of(const Session &session) {
+    std::vector<int64_t> stamp;
+    for (const auto &file : { session.file_path(),
+                              session.journal_path(),
+                              HX::hxs_path / session.hx_dir / "tubesheet.csv",
+                              HX::hxs_path / session.hx_dir / "config.json" }) {
+        std::error_code ec;
+        auto time = std::filesystem::last_write_time(file, ec);
+        stamp.push_back(ec ? 0 : time.time_since_epoch().count());
+    }
+    return stamp;
+}
+
+bool SessionCache::activate(const std::string &session_name) {
+    session_saver.flush();
+    std::lock_guard<std::mutex> lock(mtx);
+
+    auto cached = std::find_if(
+        entries.begin(), entries.end(), [&](const Entry &entry) { return entry.session->name == session_name; });
+    if (cached != entries.end() && cached->stamp == stamp_of(*cached->session)) {
+        std::shared_ptr<Session> session = cached->session;
+        entries.erase(cached);
+        switch_to_locked(std::move(session));
+        SPDLOG_INFO("Session {} switched to from the cache", session_name);
+        return true;
+    }
+    if (cached != entries.end()) {
+        entries.erase(cached); // Changed on disk
+    }
+
+    // Built aside: the current session stays as it is if loading fails
+    auto session = std::make_shared<Session>();
+    session->load(session_name);
+    session->hx.load_from_disk(session->hx_dir);
+    switch_to_locked(std::move(session));
+    return false;
+}
+
+void SessionCache::activate(std::shared_ptr<Session> session) {
+    session_saver.flush();
+    std::lock_guard<std::mutex> lock(mtx);
+    entries.remove_if([&](const Entry &entry) { return entry.session->name == session->name; });
+    switch_to_locked(std::move(session));
+}
+
+void SessionCache::evict(const std::string &session_name) {
+    std::lock_guard<std::mutex> lock(mtx);
+    entries.remove_if([&](const Entry &entry) { return entry.session->name == session_name; });
+}
+
+void SessionCache::switch_to_locked(std::shared_ptr<Session> session) {
+    std::shared_ptr<Session> previous = current_.exchange(std::move(session));
+    if (!previous->is_loaded || previous->name == current_.load()->name) {
+        return; // Nothing to keep, or the same session read again
+    }
+    std::vector<int64_t> stamp = stamp_of(*previous);
+    entries.push_front({ std::move(previous), std::move(stamp) });
+    if (entries.size() > Capacity) {
+        entries.pop_back();
+    }
+}
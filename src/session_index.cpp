@@ -0,0 +1,274 @@
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <spdlog/spdlog.h>
+#include <sstream>
+
+#include "misc_fns.hpp"
+#include "session.hpp"
+#include "session_index.hpp"
+
+namespace {
+using PlanStates = std::map<std::string, std::map<std::string, bool>>; // Plan > tube > executed
+
+// Collects hx_dir and plans > {plan} > {tube} > executed, nothing is kept of the rest of the document
+class SummaryScanner : public nlohmann::json_sax<nlohmann::json> {
+  public:
+    std::string hx_dir;
+    PlanStates plans;
+
+    bool null() override {
+        return true;
+    }
+
+    bool boolean(bool value) override {
+        if (in_plans() && depth == 4 && key_at[4] == "executed") {
+            plans[key_at[2]][key_at[3]] = value;
+        }
+        return true;
+    }
+
+    bool number_integer(number_integer_t) override {
+        return true;
+    }
+
+    bool number_unsigned(number_unsigned_t) override {
+        return true;
+    }
+
+    bool number_float(number_float_t, const string_t &) override {
+        return true;
+    }
+
+    bool string(string_t &value) override {
+        if (depth == 1 && key_at[1] == "hx_dir") {
+            hx_dir = value;
+        }
+        return true;
+    }
+
+    bool binary(binary_t &) override {
+        return true;
+    }
+
+    bool start_object(std::size_t) override {
+        depth++;
+        if (in_plans() && depth == 4) {
+            plans[key_at[2]][key_at[3]]; // Listed even if it has no executed flag
+        }
+        return true;
+    }
+
+    bool key(string_t &value) override {
+        if (depth < static_cast<int>(std::size(key_at))) {
+            key_at[depth] = value;
+        }
+        return true;
+    }
+
+    bool end_object() override {
+        depth--;
+        return true;
+    }
+
+    bool start_array(std::size_t) override {
+        depth++;
+        return true;
+    }
+
+    bool end_array() override {
+        depth--;
+        return true;
+    }
+
+    bool parse_error(std::size_t position, const std::string &, const nlohmann::detail::exception &e) override {
+        throw std::runtime_error(fmt::format("at {}: {}", position, e.what()));
+    }
+
+  private:
+    bool in_plans() const {
+        return depth >= 2 && key_at[1] == "plans";
+    }
+
+    int depth = 0;
+    std::string key_at[5]; // Last key seen at every depth that matters
+};
+
+// The same records Session::apply_journal_record() replays, as far as the executed flags go
+void apply_journal(const std::filesystem::path &journal_file, PlanStates &plans) {
+    std::ifstream journal(journal_file, std::ios::binary);
+    std::string line;
+    while (std::getline(journal, line) && !journal.eof()) {
+        auto record = nlohmann::json::parse(line, nullptr, false);
+        if (record.is_discarded()) {
+            break;
+        }
+        const std::string op = record.value("op", "");
+        if (op == "tube_executed") {
+            plans[record.at("plan")][record.at("tube")] = record.at("executed");
+        } else if (op == "plan") {
+            auto &plan = plans[record.at("plan")];
+            plan.clear();
+            for (const auto &[tube_id, entry] : record.at("entries").items()) {
+                plan[tube_id] = entry.value("executed", false);
+            }
+        } else if (op == "plan_remove") {
+            plans.erase(record.at("plan").get<std::string>());
+        }
+    }
+}
+
+int64_t write_time(const std::filesystem::path &file) {
+    std::error_code ec;
+    auto time = std::filesystem::last_write_time(file, ec);
+    return ec ? 0 : time.time_since_epoch().count();
+}
+
+std::string format_write_time(int64_t file_time, int64_t journal_time) {
+    std::filesystem::file_time_type time{ std::filesystem::file_time_type::duration(std::max(file_time, journal_time)) };
+    std::time_t tt = to_time_t(time);
+    std::tm *gmt = std::gmtime(&tt);
+    std::stringstream buffer;
+    buffer << std::put_time(gmt, "%A, %d %B %Y %H:%M");
+    return buffer.str();
+}
+
+// What the Sessions page gets of the HX, its tubes and SVG are too large to repeat for every session
+nlohmann::json hx_summary(const HX &hx) {
+    return { { "tube_od", hx.tube_od }, { "leg", hx.leg }, { "unit", hx.unit }, { "scale", hx.scale } };
+}
+
+std::filesystem::path journal_of(const std::filesystem::path &session_file) {
+    return std::filesystem::path(session_file).replace_extension(".journal");
+}
+} // namespace
+
+SessionSummary SessionIndex::scan(const std::filesystem::path &session_file) {
+    SummaryScanner scanner;
+    std::ifstream stream(session_file, std::ios::binary);
+    nlohmann::json::sax_parse(stream, &scanner);
+    apply_journal(journal_of(session_file), scanner.plans);
+
+    SessionSummary summary;
+    summary.name = session_file.stem().string();
+    summary.hx_dir = scanner.hx_dir;
+    HX hx;
+    hx.load_config(nlohmann::json::object()); // Defaults, for an HX without config.json
+    hx.load_config_from_disk(scanner.hx_dir);
+    summary.hx = hx_summary(hx);
+    for (const auto &[plan, tubes] : scanner.plans) {
+        summary.total_tubes_in_plans += static_cast<int>(tubes.size());
+        summary.total_tubes_executed +=
+            static_cast<int>(std::count_if(tubes.begin(), tubes.end(), [](const auto &tube) { return tube.second; }));
+    }
+    summary.file_time = write_time(session_file);
+    summary.journal_time = write_time(journal_of(session_file));
+    summary.last_write_time = format_write_time(summary.file_time, summary.journal_time);
+    return summary;
+}
+
+std::vector<SessionSummary> SessionIndex::list() {
+    std::lock_guard<std::mutex> lock(mtx);
+    load_locked();
+
+    std::map<std::string, SessionSummary> current;
+    for (const auto &entry : std::filesystem::directory_iterator(sessions_dir)) {
+        if (!entry.is_regular_file() || entry.path().extension() != ".json") {
+            continue;
+        }
+        std::string name = entry.path().stem().string();
+        auto summary = summaries.find(name);
+        // Summaries without hx were indexed by an older version
+        if (summary != summaries.end() && summary->second.file_time == write_time(entry.path()) &&
+            summary->second.journal_time == write_time(journal_of(entry.path())) && !summary->second.hx.empty()) {
+            current.emplace(name, summary->second);
+            continue;
+        }
+        try {
+            current.emplace(name, scan(entry.path()));
+        } catch (const std::exception &e) {
+            SPDLOG_WARN("Session file {} skipped: {}", entry.path().string(), e.what());
+        }
+        dirty = true;
+    }
+    if (current.size() != summaries.size()) {
+        dirty = true; // Sessions deleted behind the index
+    }
+    summaries.swap(current);
+    store_locked();
+
+    std::vector<SessionSummary> res;
+    res.reserve(summaries.size());
+    for (const auto &[name, summary] : summaries) {
+        res.push_back(summary);
+    }
+    return res;
+}
+
+// Only in memory, the file is written by the next list(): saves happen far more often than the Sessions page is
+// opened
+void SessionIndex::update(const Session &session) {
+    SessionSummary summary;
+    summary.name = session.name;
+    summary.hx_dir = session.hx_dir.string();
+    summary.hx = hx_summary(session.hx);
+    {
+        std::lock_guard<std::mutex> lock(session.mtx); // Called from the saver thread
+        for (const auto &[plan, tubes] : session.plans) {
+            summary.total_tubes_in_plans += static_cast<int>(tubes.size());
+            summary.total_tubes_executed += static_cast<int>(
+                std::count_if(tubes.begin(), tubes.end(), [](const auto &tube) { return tube.second.executed; }));
+        }
+    }
+    summary.file_time = write_time(session.file_path());
+    summary.journal_time = write_time(session.journal_path());
+    summary.last_write_time = format_write_time(summary.file_time, summary.journal_time);
+
+    std::lock_guard<std::mutex> lock(mtx);
+    load_locked();
+    summaries[summary.name] = std::move(summary);
+    dirty = true;
+}
+
+void SessionIndex::remove(const std::string &name) {
+    std::lock_guard<std::mutex> lock(mtx);
+    load_locked();
+    dirty |= summaries.erase(name) > 0;
+}
+
+void SessionIndex::load_locked() {
+    if (loaded) {
+        return;
+    }
+    loaded = true;
+    std::ifstream stream(sessions_dir / IndexFile);
+    if (!stream.is_open()) {
+        return;
+    }
+    try {
+        summaries = nlohmann::json::parse(stream).get<std::map<std::string, SessionSummary>>();
+    } catch (const std::exception &e) {
+        SPDLOG_WARN("Sessions index discarded, it will be rebuilt: {}", e.what());
+        summaries.clear();
+    }
+}
+
+void SessionIndex::store_locked() {
+    if (!dirty) {
+        return;
+    }
+    std::filesystem::path index_file = sessions_dir / IndexFile;
+    std::filesystem::path tmp_file = index_file;
+    tmp_file += ".tmp";
+    {
+        std::ofstream stream(tmp_file, std::ios::trunc);
+        stream << nlohmann::json(summaries);
+        if (!stream.flush()) {
+            SPDLOG_WARN("Sessions index not written");
+            return;
+        }
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmp_file, index_file, ec);
+    dirty = ec.operator bool();
+}
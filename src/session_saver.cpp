@@ -0,0 +1,128 @@
+#include <filesystem>
+#include <iterator>
+#include <spdlog/spdlog.h>
+
+#include "session.hpp"
+#include "session_index.hpp"
+#include "session_saver.hpp"
+
+void SessionSaver::changed(std::shared_ptr<Session> session, nlohmann::json record) {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (pending.empty() || pending.back().session != session) {
+            pending.push_back({ std::move(session), {} });
+        }
+        pending.back().records.push_back(std::move(record));
+        arm();
+    }
+    cv.notify_all();
+}
+
+// Called with mtx held
+void SessionSaver::arm() {
+    last_change = std::chrono::steady_clock::now();
+    if (!first_change) {
+        first_change = last_change;
+    }
+}
+
+void SessionSaver::flush() {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (!first_change) {
+            return;
+        }
+        first_change.reset();
+    }
+    save();
+}
+
+// A change arriving during a wait is not notified: it can only push the deadline later, which is seen when the
+// current wait times out
+void SessionSaver::run(std::stop_token stop_token, const SessionSaverSettings &settings) {
+    const auto debounce = std::chrono::milliseconds(settings.debounce_ms);
+    const auto max_delay = std::chrono::milliseconds(settings.max_delay_ms);
+
+    std::unique_lock<std::mutex> lock(mtx);
+    compact_bytes = static_cast<uintmax_t>(settings.compact_journal_kb) * 1024;
+    while (!stop_token.stop_requested()) {
+        if (!first_change) {
+            cv.wait(lock, stop_token, [this] { return first_change.has_value(); });
+            continue;
+        }
+        auto due = std::min(last_change + debounce, *first_change + max_delay);
+        if (std::chrono::steady_clock::now() < due) {
+            cv.wait_until(lock, stop_token, due, [] { return false; });
+            continue;
+        }
+        first_change.reset();
+        lock.unlock();
+        save();
+        lock.lock();
+    }
+
+    if (first_change) {
+        first_change.reset();
+        lock.unlock();
+        save();
+    }
+}
+
+void SessionSaver::save() {
+    std::lock_guard<std::mutex> save_lock(save_mtx);
+    std::vector<Batch> batches;
+    uintmax_t compact_at;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        batches.swap(pending);
+        compact_at = compact_bytes;
+    }
+
+    std::vector<Batch> failed;
+    for (auto &batch : batches) {
+        if (!save(batch, compact_at)) {
+            failed.push_back(std::move(batch));
+        }
+    }
+    if (!failed.empty()) {
+        // Tried again after the debounce, before the changes made since
+        std::lock_guard<std::mutex> lock(mtx);
+        pending.insert(pending.begin(), std::make_move_iterator(failed.begin()), std::make_move_iterator(failed.end()));
+        arm();
+    }
+}
+
+bool SessionSaver::save(const Batch &batch, uintmax_t compact_at) {
+    Session &session = *batch.session;
+    if (!session.is_loaded || batch.records.empty()) {
+        return true;
+    }
+    if (!std::filesystem::exists(session.file_path())) {
+        SPDLOG_INFO("Session {} was deleted, {} changes dropped", session.name, batch.records.size());
+        return true;
+    }
+
+    try {
+        bool compact;
+        {
+            std::lock_guard<std::mutex> lock(session.mtx);
+            // Cleared first: a change made while writing sets it again and is saved by the next write
+            session.is_changed = false;
+            compact = session.journal_size >= compact_at;
+        }
+        // Records still pending for a later batch may already be in a compacted file, applying them again over it
+        // changes nothing
+        if (compact) {
+            SPDLOG_INFO("Compacting the journal of session {}", session.name);
+            session.save_to_disk();
+        } else {
+            session.append_to_journal(batch.records);
+        }
+        session_index.update(session);
+        saved = true;
+        return true;
+    } catch (const std::exception &e) {
+        SPDLOG_ERROR("Session {} not saved: {}", session.name, e.what());
+        return false;
+    }
+}
@@ -0,0 +1,114 @@
+#include <algorithm>
+#include <spdlog/spdlog.h>
+
+#include "sse_broadcaster.hpp"
+
+void SseBroadcaster::subscribe(const std::shared_ptr<restbed::Session> &session) {
+    auto subscriber = std::make_shared<Subscriber>();
+    subscriber->session = session;
+
+    std::lock_guard<std::mutex> lock(mtx);
+    subscribers.push_back(subscriber);
+    keyframe_requested = true; // Deltas mean nothing to the new subscriber without a full object first
+}
+
+bool SseBroadcaster::has_subscribers() {
+    std::lock_guard<std::mutex> lock(mtx);
+    return !subscribers.empty();
+}
+
+bool SseBroadcaster::take_keyframe_request() {
+    std::lock_guard<std::mutex> lock(mtx);
+    auto now = std::chrono::steady_clock::now();
+    if (lagging_keyframe_requested && now - last_lagging_keyframe >= LaggingKeyframeInterval) {
+        lagging_keyframe_requested = false;
+        last_lagging_keyframe = now;
+        keyframe_requested = true;
+    }
+    return std::exchange(keyframe_requested, false);
+}
+
+void SseBroadcaster::publish(Kind kind, const nlohmann::json &message) {
+    const Message shared_message{
+        kind, std::make_shared<const std::string>("data: " + nlohmann::to_string(message) + "\n\n") };
+
+    std::vector<std::shared_ptr<Subscriber>> ready;
+    std::vector<std::shared_ptr<restbed::Session>> lagging;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        std::erase_if(subscribers, [&](const std::shared_ptr<Subscriber> &subscriber) {
+            if (subscriber->session->is_closed()) {
+                return true;
+            }
+            if (!enqueue(*subscriber, shared_message)) {
+                lagging.push_back(subscriber->session);
+                return true;
+            }
+            if (!subscriber->writing && !subscriber->queue.empty()) {
+                subscriber->writing = true;
+                ready.push_back(subscriber);
+            }
+            return false;
+        });
+    }
+
+    for (const auto &session : lagging) {
+        SPDLOG_WARN("SSE subscriber {} is not keeping up, disconnecting it", session->get_origin());
+        session->close();
+    }
+    for (const auto &subscriber : ready) {
+        write_next(subscriber);
+    }
+}
+
+bool SseBroadcaster::enqueue(Subscriber &subscriber, const Message &message) {
+    switch (message.kind) {
+    case Kind::EVENT:
+        if (subscriber.queued_events >= MaxQueuedEvents) {
+            return false;
+        }
+        subscriber.queued_events++;
+        break;
+    case Kind::TELEMETRY_KEYFRAME:
+        drop_telemetry(subscriber);
+        subscriber.needs_keyframe = false;
+        break;
+    case Kind::TELEMETRY_DELTA:
+        if (subscriber.needs_keyframe) {
+            return true;
+        }
+        if (drop_telemetry(subscriber)) {
+            // Applying this delta without the dropped message would leave the browser with a wrong object
+            subscriber.needs_keyframe = true;
+            lagging_keyframe_requested = true;
+            return true;
+        }
+        break;
+    }
+    subscriber.queue.push_back(message);
+    return true;
+}
+
+bool SseBroadcaster::drop_telemetry(Subscriber &subscriber) {
+    return std::erase_if(subscriber.queue, [](const Message &message) { return message.kind != Kind::EVENT; }) > 0;
+}
+
+// Runs again from the write callback until the queue is empty. If the session closes the callback never comes, the
+// subscriber is then removed by the next publish().
+void SseBroadcaster::write_next(const std::shared_ptr<Subscriber> &subscriber) {
+    Message message;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (subscriber->queue.empty()) {
+            subscriber->writing = false;
+            return;
+        }
+        message = std::move(subscriber->queue.front());
+        subscriber->queue.pop_front();
+        if (message.kind == Kind::EVENT) {
+            subscriber->queued_events--;
+        }
+    }
+    subscriber->session->yield(
+        *message.data, [this, subscriber](const std::shared_ptr<restbed::Session>) { write_next(subscriber); });
+}
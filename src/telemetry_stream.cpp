@@ -0,0 +1,34 @@
+#include "telemetry_stream.hpp"
+
+nlohmann::json json_merge_diff(const nlohmann::json &from, const nlohmann::json &to) {
+    if (!from.is_object() || !to.is_object()) {
+        return to;
+    }
+
+    nlohmann::json patch = nlohmann::json::object();
+    for (const auto &[key, value] : from.items()) {
+        if (!to.contains(key)) {
+            patch[key] = nullptr;
+        }
+    }
+    for (const auto &[key, value] : to.items()) {
+        auto old_value = from.find(key);
+        if (old_value == from.end()) {
+            patch[key] = value;
+        } else if (*old_value != value) {
+            patch[key] = json_merge_diff(*old_value, value);
+        }
+    }
+    return patch;
+}
+
+void TelemetryDeltaEncoder::encode(nlohmann::json &res, const nlohmann::json &telemetry) {
+    auto now = std::chrono::steady_clock::now();
+    if (keyframe_requested.exchange(false) || now - last_keyframe >= keyframe_interval) {
+        res["TELEMETRY"] = telemetry;
+        last_keyframe = now;
+    } else if (nlohmann::json delta = json_merge_diff(last_sent, telemetry); !delta.empty()) {
+        res["TELEMETRY_DELTA"] = std::move(delta);
+    }
+    last_sent = telemetry;
+}
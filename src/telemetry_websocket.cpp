@@ -0,0 +1,179 @@
+#include <algorithm>
+#include <bit>
+#include <openssl/evp.h>
+#include <openssl/sha.h>
+#include <spdlog/spdlog.h>
+#include <string>
+#include <system_error>
+
+#include "telemetry_websocket.hpp"
+
+namespace {
+constexpr std::chrono::milliseconds IdlePoll = std::chrono::milliseconds(500);
+constexpr uint64_t MaxDecimation = 1000;
+
+template <typename T> void put_le(uint8_t *out, T value) {
+    auto bits = std::bit_cast<std::array<uint8_t, sizeof(T)>>(value);
+    if constexpr (std::endian::native == std::endian::big) {
+        std::reverse(bits.begin(), bits.end());
+    }
+    std::copy(bits.begin(), bits.end(), out);
+}
+
+void put_point(uint8_t *out, const Point3D &point) {
+    put_le(out, point.x);
+    put_le(out + 8, point.y);
+    put_le(out + 16, point.z);
+}
+
+// RFC 6455 4.2.2: base64 of the SHA-1 of the client key and the protocol GUID
+std::string websocket_accept_key(const std::string &key) {
+    const std::string input = key + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+    unsigned char digest[SHA_DIGEST_LENGTH];
+    EVP_Digest(input.data(), input.size(), digest, nullptr, EVP_sha1(), nullptr);
+
+    unsigned char encoded[4 * ((SHA_DIGEST_LENGTH + 2) / 3) + 1];
+    int length = EVP_EncodeBlock(encoded, digest, SHA_DIGEST_LENGTH);
+    return std::string(reinterpret_cast<const char *>(encoded), static_cast<size_t>(length));
+}
+
+uint64_t clamp_decimation(int64_t decimation) {
+    return static_cast<uint64_t>(std::clamp<int64_t>(decimation, 1, MaxDecimation));
+}
+} // namespace
+
+std::array<uint8_t, TelemetryFrameSize> encode_telemetry_frame(
+    const TelemetrySnapshot &snapshot, bool sequence_in_progress) {
+    const struct telemetry &telemetry = snapshot.ui_telemetry;
+    std::array<uint8_t, TelemetryFrameSize> frame{};
+
+    put_le(frame.data(), snapshot.sequence);
+    put_point(frame.data() + 8, telemetry.coords);
+    put_point(frame.data() + 32, telemetry.targets);
+
+    const bool flags[] = {
+        telemetry.on_condition.x_y, telemetry.on_condition.z, telemetry.probe.x_y, telemetry.probe.z,
+        telemetry.stalled.x,        telemetry.stalled.y,      telemetry.stalled.z, telemetry.control_enabled,
+        telemetry.stall_control,    telemetry.probe_protected, sequence_in_progress,
+    };
+    uint16_t flag_bits = 0;
+    for (size_t bit = 0; bit < std::size(flags); bit++) {
+        flag_bits |= static_cast<uint16_t>(flags[bit] << bit);
+    }
+    put_le(frame.data() + 56, flag_bits);
+
+    const bool limits[] = {
+        telemetry.limits.left, telemetry.limits.right, telemetry.limits.up,    telemetry.limits.down,
+        telemetry.limits.in,   telemetry.limits.out,   telemetry.limits.probe,
+    };
+    uint8_t limit_bits = 0;
+    for (size_t bit = 0; bit < std::size(limits); bit++) {
+        limit_bits |= static_cast<uint8_t>(limits[bit] << bit);
+    }
+    frame[58] = limit_bits;
+    frame[59] = static_cast<uint8_t>(static_cast<int8_t>(telemetry.brakes_mode));
+    return frame;
+}
+
+void TelemetryWebSocket::upgrade(const std::shared_ptr<restbed::Session> &session) {
+    const auto request = session->get_request();
+    const std::string key = request->get_header("Sec-WebSocket-Key");
+    if (key.empty()) {
+        session->close(restbed::BAD_REQUEST, "WebSocket upgrade expected");
+        return;
+    }
+
+    auto client = std::make_shared<Client>();
+    client->decimation = clamp_decimation(request->get_query_parameter("decimation", static_cast<int64_t>(1)));
+
+    const std::multimap<std::string, std::string> headers{
+        { "Upgrade", "websocket" },
+        { "Connection", "Upgrade" },
+        { "Sec-WebSocket-Accept", websocket_accept_key(key) },
+    };
+    auto on_upgrade = [this, client](const std::shared_ptr<restbed::WebSocket> socket) {
+        if (!socket->is_open()) {
+            return;
+        }
+        socket->set_message_handler(
+            [this, client](
+                const std::shared_ptr<restbed::WebSocket> socket,
+                const std::shared_ptr<restbed::WebSocketMessage> message) { on_message(client, socket, message); });
+        socket->set_error_handler([](const std::shared_ptr<restbed::WebSocket> socket, const std::error_code error) {
+            SPDLOG_WARN("Telemetry WebSocket {} error: {}", socket->get_key(), error.message());
+        });
+
+        std::lock_guard<std::mutex> lock(mtx);
+        client->socket = socket;
+        clients.push_back(client);
+        SPDLOG_INFO("Telemetry WebSocket {} connected, decimation {}", socket->get_key(), client->decimation);
+    };
+    session->upgrade(restbed::SWITCHING_PROTOCOLS, headers, on_upgrade);
+}
+
+void TelemetryWebSocket::on_message(
+    const std::shared_ptr<Client> &client,
+    const std::shared_ptr<restbed::WebSocket> &socket,
+    const std::shared_ptr<restbed::WebSocketMessage> &message) {
+    switch (message->get_opcode()) {
+    case restbed::WebSocketMessage::PING_FRAME:
+        socket->send(
+            std::make_shared<restbed::WebSocketMessage>(restbed::WebSocketMessage::PONG_FRAME, message->get_data()));
+        break;
+    case restbed::WebSocketMessage::CONNECTION_CLOSE_FRAME:
+        socket->close();
+        break;
+    case restbed::WebSocketMessage::TEXT_FRAME: {
+        const auto data = message->get_data();
+        auto pars = nlohmann::json::parse(data.begin(), data.end(), nullptr, false);
+        if (pars.is_object() && pars.contains("decimation") && pars["decimation"].is_number_integer()) {
+            std::lock_guard<std::mutex> lock(mtx);
+            client->decimation = clamp_decimation(pars["decimation"].get<int64_t>());
+        } else {
+            SPDLOG_WARN("Telemetry WebSocket {}: unexpected message", socket->get_key());
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+void TelemetryWebSocket::run(std::stop_token stop_token) {
+    uint64_t last_sequence = 0;
+    while (!stop_token.stop_requested()) {
+        auto snapshot = rema.wait_for_telemetry(last_sequence, IdlePoll);
+        if (!snapshot) {
+            continue;
+        }
+        last_sequence = snapshot->sequence;
+        broadcast(*snapshot);
+    }
+}
+
+void TelemetryWebSocket::broadcast(const TelemetrySnapshot &snapshot) {
+    std::vector<std::shared_ptr<Client>> due;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        std::erase_if(clients, [](const std::shared_ptr<Client> &client) { return client->socket->is_closed(); });
+        for (const auto &client : clients) {
+            if (!client->sending && snapshot.sequence - client->last_sent_sequence >= client->decimation) {
+                client->sending = true;
+                client->last_sent_sequence = snapshot.sequence;
+                due.push_back(client);
+            }
+        }
+    }
+    if (due.empty()) {
+        return;
+    }
+
+    auto frame = encode_telemetry_frame(snapshot, rema.is_sequence_in_progress);
+    const restbed::Bytes bytes(frame.begin(), frame.end());
+    for (const auto &client : due) {
+        client->socket->send(bytes, [this, client](const std::shared_ptr<restbed::WebSocket>) {
+            std::lock_guard<std::mutex> lock(mtx);
+            client->sending = false;
+        });
+    }
+}
@@ -0,0 +1,114 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "tube_index.hpp"
+
+TubeIndex::TubeIndex(Key key, TubeTable tubes_) : key_(std::move(key)), tubes(std::move(tubes_)) {
+    nodes.reserve(tubes.size());
+    for (TubeTable::TubeId tube = 0; tube < tubes.size(); tube++) {
+        nodes.push_back({ tubes.x()[tube], tubes.y()[tube], tube });
+    }
+    build(0, nodes.size(), 0);
+}
+
+void TubeIndex::build(size_t begin, size_t end, int axis) {
+    if (end - begin < 2) {
+        return;
+    }
+    size_t mid = begin + (end - begin) / 2;
+    auto less = [axis](const Node &a, const Node &b) { return axis == 0 ? a.x < b.x : a.y < b.y; };
+    std::nth_element(nodes.begin() + begin, nodes.begin() + mid, nodes.begin() + end, less);
+    build(begin, mid, 1 - axis);
+    build(mid + 1, end, 1 - axis);
+}
+
+std::optional<TubeIndex::Hit> TubeIndex::nearest(const Point3D &point) const {
+    if (nodes.empty()) {
+        return std::nullopt;
+    }
+    size_t best = 0;
+    double best_d2 = std::numeric_limits<double>::infinity();
+    nearest(0, nodes.size(), 0, point.x, point.y, best, best_d2);
+    return make_hit(best, std::sqrt(best_d2));
+}
+
+void TubeIndex::nearest(size_t begin, size_t end, int axis, double x, double y, size_t &best, double &best_d2) const {
+    if (begin >= end) {
+        return;
+    }
+    size_t mid = begin + (end - begin) / 2;
+    const Node &node = nodes[mid];
+    double dx = node.x - x;
+    double dy = node.y - y;
+    if (double d2 = dx * dx + dy * dy; d2 < best_d2) {
+        best_d2 = d2;
+        best = mid;
+    }
+
+    // The side of the split holding the point first, the other one only if it can hold something closer
+    double split_distance = axis == 0 ? x - node.x : y - node.y;
+    if (split_distance < 0) {
+        nearest(begin, mid, 1 - axis, x, y, best, best_d2);
+        if (split_distance * split_distance < best_d2) {
+            nearest(mid + 1, end, 1 - axis, x, y, best, best_d2);
+        }
+    } else {
+        nearest(mid + 1, end, 1 - axis, x, y, best, best_d2);
+        if (split_distance * split_distance < best_d2) {
+            nearest(begin, mid, 1 - axis, x, y, best, best_d2);
+        }
+    }
+}
+
+template <typename Visit>
+void TubeIndex::range(size_t begin, size_t end, int axis, const double lo[2], const double hi[2], Visit &visit) const {
+    if (begin >= end) {
+        return;
+    }
+    size_t mid = begin + (end - begin) / 2;
+    const Node &node = nodes[mid];
+    if (node.x >= lo[0] && node.x <= hi[0] && node.y >= lo[1] && node.y <= hi[1]) {
+        visit(mid);
+    }
+    double split = axis == 0 ? node.x : node.y;
+    if (lo[axis] <= split) {
+        range(begin, mid, 1 - axis, lo, hi, visit);
+    }
+    if (hi[axis] >= split) {
+        range(mid + 1, end, 1 - axis, lo, hi, visit);
+    }
+}
+
+std::vector<TubeIndex::Hit> TubeIndex::within_radius(const Point3D &point, double radius) const {
+    std::vector<Hit> hits;
+    const double lo[2] = { point.x - radius, point.y - radius };
+    const double hi[2] = { point.x + radius, point.y + radius };
+    auto visit = [&](size_t node) {
+        double distance = std::hypot(nodes[node].x - point.x, nodes[node].y - point.y);
+        if (distance <= radius) {
+            hits.push_back(make_hit(node, distance));
+        }
+    };
+    range(0, nodes.size(), 0, lo, hi, visit);
+    std::sort(hits.begin(), hits.end(), [](const Hit &a, const Hit &b) { return a.distance < b.distance; });
+    return hits;
+}
+
+std::vector<TubeIndex::Hit> TubeIndex::within_box(const Point3D &min, const Point3D &max) const {
+    std::vector<Hit> hits;
+    const double lo[2] = { std::min(min.x, max.x), std::min(min.y, max.y) };
+    const double hi[2] = { std::max(min.x, max.x), std::max(min.y, max.y) };
+    double center_x = (lo[0] + hi[0]) / 2;
+    double center_y = (lo[1] + hi[1]) / 2;
+    auto visit = [&](size_t node) {
+        hits.push_back(make_hit(node, std::hypot(nodes[node].x - center_x, nodes[node].y - center_y)));
+    };
+    range(0, nodes.size(), 0, lo, hi, visit);
+    return hits;
+}
+
+TubeIndex::Hit TubeIndex::make_hit(size_t node, double distance) const {
+    TubeTable::TubeId tube = nodes[node].tube;
+    return { tubes.id(tube), tubes.coords(tube), distance };
+}
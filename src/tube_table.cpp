@@ -0,0 +1,56 @@
+#include "tube_table.hpp"
+
+TubeTable::TubeId TubeTable::add(
+    const std::string &id, const std::string &x_label, const std::string &y_label, const Point3D &coords) {
+    auto [iter, inserted] = by_id.try_emplace(id, static_cast<TubeId>(ids.size()));
+    if (!inserted) {
+        return iter->second;
+    }
+    ids.push_back(id);
+    xs.push_back(coords.x);
+    ys.push_back(coords.y);
+    zs.push_back(coords.z);
+    x_labels.push_back(intern(x_label));
+    y_labels.push_back(intern(y_label));
+    return iter->second;
+}
+
+void TubeTable::clear() {
+    *this = TubeTable();
+}
+
+void TubeTable::reserve(size_t tubes) {
+    ids.reserve(tubes);
+    xs.reserve(tubes);
+    ys.reserve(tubes);
+    zs.reserve(tubes);
+    x_labels.reserve(tubes);
+    y_labels.reserve(tubes);
+    by_id.reserve(tubes);
+}
+
+TubeTable::LabelId TubeTable::intern(const std::string &label) {
+    auto [iter, inserted] = label_ids.try_emplace(label, static_cast<LabelId>(labels.size()));
+    if (inserted) {
+        labels.push_back(label);
+    }
+    return iter->second;
+}
+
+void to_json(nlohmann::json &j, const TubeTable &tubes) {
+    j = nlohmann::json::object();
+    for (TubeTable::TubeId tube = 0; tube < tubes.size(); tube++) {
+        j[tubes.id(tube)] = { { "x_label", tubes.x_label(tube) },
+                              { "y_label", tubes.y_label(tube) },
+                              { "coords", tubes.coords(tube) } };
+    }
+}
+
+void from_json(const nlohmann::json &j, TubeTable &tubes) {
+    tubes.clear();
+    tubes.reserve(j.size());
+    for (const auto &[id, value] : j.items()) {
+        auto entry = value.get<TubeEntry>();
+        tubes.add(id, entry.x_label, entry.y_label, entry.coords);
+    }
+}
@@ -3,6 +3,7 @@
 #include "HX.hpp"
 #include "multipart.hpp"
 #include "session.hpp"
+#include "session_cache.hpp"
 #include "upload.hpp"
 
 void extract_plans_from_multipart_form_data(multipart::message &multipart_msg) {
@@ -12,11 +13,12 @@ void extract_plans_from_multipart_form_data(multipart::message &multipart_msg) {
                 if (key == "filename" && !value.empty()) {
                     std::filesystem::path filename(value);
                     std::istringstream istream(part.body); // this is an input stream
-                    if (current_session.is_loaded) {
+                    auto session = session_cache.current();
+                    if (session->is_loaded) {
                         std::string plan_name = filename.replace_extension().string().substr(0, 25);
-                        current_session.load_plan(plan_name, istream);
+                        session->load_plan(plan_name, istream);
                         std::cout << "Added: " << plan_name << "\n";
-                        current_session.save_to_disk();
+                        session->plan_changed(plan_name);
                     }
                 }
             }
@@ -0,0 +1,231 @@
+#include <gtest/gtest.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "command_net_client.hpp"
+
+using namespace std::chrono_literals;
+
+namespace {
+// Stands in for the RTU command port: accepts one connection and answers only what the test tells it to
+class FakeRtu {
+  public:
+    FakeRtu() {
+        listener = ::socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t len = sizeof(addr);
+        if (::bind(listener, reinterpret_cast<sockaddr *>(&addr), len) < 0 || ::listen(listener, 1) < 0 ||
+            ::getsockname(listener, reinterpret_cast<sockaddr *>(&addr), &len) < 0) {
+            throw std::runtime_error("Unable to listen on the loopback interface");
+        }
+        port = ntohs(addr.sin_port);
+        accepted = std::async(std::launch::async, [this] { return ::accept(listener, nullptr, nullptr); });
+    }
+
+    ~FakeRtu() {
+        disconnect();
+        ::close(listener);
+    }
+
+    int connection() {
+        if (peer < 0) {
+            peer = accepted.get();
+        }
+        return peer;
+    }
+
+    // Responses end with '\0' like every RTU message
+    void reply(const std::vector<std::string> &responses) {
+        std::string bytes;
+        for (const auto &response : responses) {
+            bytes += response;
+            bytes += '\0';
+        }
+        ASSERT_EQ(::send(connection(), bytes.data(), bytes.size(), MSG_NOSIGNAL), static_cast<ssize_t>(bytes.size()));
+    }
+
+    void disconnect() {
+        if (!disconnected && connection() >= 0) {
+            ::close(peer);
+        }
+        disconnected = true;
+    }
+
+    int port;
+
+  private:
+    int listener;
+    int peer = -1;
+    bool disconnected = false;
+    std::future<int> accepted;
+};
+
+class CommandNetClientTest : public ::testing::Test {
+  protected:
+    void SetUp() override {
+        ASSERT_EQ(client.connect("127.0.0.1", rtu.port, 1), 0);
+        ASSERT_GE(rtu.connection(), 0);
+    }
+
+    // The clients of the proxy live as long as it does, these ones are destroyed after every test: the removal of
+    // their fd, posted to the reactor, must have run before the next client takes the same memory
+    void TearDown() override {
+        client.close();
+        std::promise<void> drained;
+        io_reactor.post([&drained] { drained.set_value(); });
+        drained.get_future().wait();
+    }
+
+    // The error the future was failed with, empty when it got a response
+    static std::string error_of(std::future<std::string> &future) {
+        if (future.wait_for(2s) != std::future_status::ready) {
+            return "no response";
+        }
+        try {
+            future.get();
+            return "";
+        } catch (const std::runtime_error &e) {
+            return e.what();
+        }
+    }
+
+    static bool wait_until(const std::function<bool()> &condition) {
+        for (auto deadline = std::chrono::steady_clock::now() + 2s; std::chrono::steady_clock::now() < deadline;) {
+            if (condition()) {
+                return true;
+            }
+            std::this_thread::sleep_for(1ms);
+        }
+        return condition();
+    }
+
+    FakeRtu rtu;
+    CommandNetClient client;
+};
+} // namespace
+
+TEST_F(CommandNetClientTest, ResponsesMatchTheOldestPendingRequest) {
+    auto first = client.send_command("{\"command\":\"first\"}");
+    auto second = client.send_command("{\"command\":\"second\"}");
+    auto third = client.send_command("{\"command\":\"third\"}");
+    EXPECT_EQ(client.pending_count(), 3U);
+
+    rtu.reply({ "1", "2" });
+    ASSERT_EQ(first.wait_for(2s), std::future_status::ready);
+    ASSERT_EQ(second.wait_for(2s), std::future_status::ready);
+    EXPECT_EQ(first.get(), "1");
+    EXPECT_EQ(second.get(), "2");
+
+    rtu.reply({ "3" });
+    ASSERT_EQ(third.wait_for(2s), std::future_status::ready);
+    EXPECT_EQ(third.get(), "3");
+    EXPECT_EQ(client.pending_count(), 0U);
+    EXPECT_TRUE(client.is_connected);
+}
+
+TEST_F(CommandNetClientTest, CallbackGetsItsResponseOnce) {
+    std::promise<CommandNetClient::Response> promise;
+    std::atomic<int> calls = 0; // Callbacks run on the reactor thread
+    client.send_command("{}", [&](CommandNetClient::Response response) {
+        if (calls++ == 0) {
+            promise.set_value(std::move(response));
+        }
+    });
+    rtu.reply({ "ok", "unsolicited" });
+
+    auto future = promise.get_future();
+    ASSERT_EQ(future.wait_for(2s), std::future_status::ready);
+    auto response = future.get();
+    ASSERT_TRUE(response);
+    EXPECT_EQ(*response, "ok");
+
+    client.close();
+    EXPECT_EQ(calls, 1);
+}
+
+TEST_F(CommandNetClientTest, TimeoutFailsTheRequestAndClosesTheLink) {
+    auto waiting = client.send_command("{\"command\":\"slow\"}", 10s);
+    auto expiring = client.send_command("{\"command\":\"lost\"}", 50ms);
+
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_EQ(error_of(expiring), "Timeout waiting for REMA response");
+    EXPECT_GE(std::chrono::steady_clock::now() - start, 40ms);
+
+    // The responses can no longer be matched: every other request fails and the link is closed to start over
+    EXPECT_EQ(error_of(waiting), "Connection to REMA closed");
+    EXPECT_TRUE(wait_until([&] { return !client.is_connected; }));
+    EXPECT_EQ(client.pending_count(), 0U);
+}
+
+TEST_F(CommandNetClientTest, EarliestDeadlineExpiresFirst) {
+    auto later = client.send_command("{}", 400ms);
+    auto sooner = client.send_command("{}", 30ms);
+    EXPECT_EQ(error_of(sooner), "Timeout waiting for REMA response");
+    EXPECT_EQ(error_of(later), "Connection to REMA closed");
+}
+
+TEST_F(CommandNetClientTest, CloseFailsAllPending) {
+    std::vector<std::future<std::string>> futures;
+    for (int i = 0; i < 5; i++) {
+        futures.push_back(client.send_command("{}"));
+    }
+    rtu.reply({ "0" });
+    ASSERT_EQ(futures[0].wait_for(2s), std::future_status::ready);
+    EXPECT_EQ(futures[0].get(), "0");
+
+    client.close();
+    EXPECT_FALSE(client.is_connected);
+    EXPECT_EQ(client.pending_count(), 0U);
+    for (size_t i = 1; i < futures.size(); i++) {
+        EXPECT_EQ(error_of(futures[i]), "Connection to REMA closed");
+    }
+}
+
+TEST_F(CommandNetClientTest, PeerDisconnectFailsAllPending) {
+    auto first = client.send_command("{}");
+    auto second = client.send_command("{}");
+    rtu.disconnect();
+
+    EXPECT_EQ(error_of(first), "Connection to REMA closed");
+    EXPECT_EQ(error_of(second), "Connection to REMA closed");
+    EXPECT_TRUE(wait_until([&] { return !client.is_connected; }));
+}
+
+TEST_F(CommandNetClientTest, SendWithoutConnection) {
+    client.close();
+    auto future = client.send_command("{}");
+    EXPECT_EQ(error_of(future), "Unable to send command to REMA");
+    EXPECT_EQ(client.pending_count(), 0U);
+}
+
+TEST_F(CommandNetClientTest, ReconnectStartsWithAnEmptyQueue) {
+    auto lost = client.send_command("{}");
+    client.close();
+    EXPECT_EQ(error_of(lost), "Connection to REMA closed");
+
+    FakeRtu restarted;
+    ASSERT_EQ(client.connect("127.0.0.1", restarted.port, 1), 0);
+    auto fresh = client.send_command("{}");
+    restarted.reply({ "fresh" });
+    ASSERT_EQ(fresh.wait_for(2s), std::future_status::ready);
+    EXPECT_EQ(fresh.get(), "fresh");
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,163 @@
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+
+#include "hx_cache.hpp"
+
+namespace {
+const std::string Config = R"({
+    "leg" : "both",
+    "tube_od" : 0.75,
+    "min_x" : -2, "width" : 12,
+    "min_y" : -10, "height" : 20,
+    "font_size" : "0.25",
+    "x_labels" : "-8 8",
+    "y_labels" : "-1 11",
+    "unit" : "inch"
+})";
+
+std::string tubesheet_csv(int rows, int cols) {
+    std::string csv = "x_label;y_label;cl_x;cl_y;hl_x;hl_y;tube_id\n";
+    int tube = 1;
+    for (int row = 1; row <= rows; row++) {
+        for (int col = 1; col <= cols; col++, tube++) {
+            std::string x = std::to_string(col * 0.8125);
+            std::string y = std::to_string(row * 0.704);
+            csv += std::to_string(col) + ";" + std::to_string(row) + ";" + x + ";-" + y + ";" + x + ";" + y +
+                   ";TUBE." + std::to_string(tube) + "\n";
+        }
+    }
+    return csv;
+}
+
+// HX::hxs_path is relative to the working directory: every test runs in a directory of its own
+class HxCacheTest : public ::testing::Test {
+  protected:
+    void SetUp() override {
+        previous_dir = std::filesystem::current_path();
+        dir = std::filesystem::temp_directory_path() / ("hx_cache_test_" + std::to_string(std::random_device()()));
+        std::filesystem::create_directories(dir / "HXs");
+        std::filesystem::current_path(dir);
+        ASSERT_TRUE(HX::create(Name, tubesheet_csv(12, 15), Config));
+    }
+
+    void TearDown() override {
+        std::filesystem::current_path(previous_dir);
+        std::filesystem::remove_all(dir);
+    }
+
+    static HX compiled() {
+        HX hx;
+        hx.load_config_from_disk(Name);
+        hx.process_csv_from_disk(Name);
+        hx.generate_svg();
+        return hx;
+    }
+
+    static HX with_config() {
+        HX hx;
+        hx.load_config_from_disk(Name);
+        return hx;
+    }
+
+    static std::filesystem::path cache_file() {
+        return HX::hxs_path / Name / "tubesheet.cache";
+    }
+
+    static void expect_same(const HX &a, const HX &b) {
+        EXPECT_EQ(nlohmann::json(a.tubes), nlohmann::json(b.tubes));
+        EXPECT_EQ(a.tubesheet_svg, b.tubesheet_svg);
+        EXPECT_EQ(a.svg.x_labels, b.svg.x_labels);
+        EXPECT_EQ(a.svg.y_labels, b.svg.y_labels);
+    }
+
+    static constexpr const char *Name = "test_hx";
+    std::filesystem::path previous_dir;
+    std::filesystem::path dir;
+};
+} // namespace
+
+TEST_F(HxCacheTest, RoundTrip) {
+    HX hx = compiled();
+    ASSERT_EQ(hx.tubes.size(), 12U * 15 * 2);
+    store_hx_cache(hx, Name);
+    ASSERT_TRUE(std::filesystem::exists(cache_file()));
+
+    HX cached = with_config();
+    ASSERT_TRUE(load_hx_cache(cached, Name));
+    expect_same(cached, hx);
+    EXPECT_EQ(cached.tubes.x_label(0), hx.tubes.x_label(0));
+    EXPECT_EQ(cached.tubes.coords(*cached.tubes.find("HL_7")).y, hx.tubes.coords(*hx.tubes.find("HL_7")).y);
+}
+
+TEST_F(HxCacheTest, LoadFromDiskWritesAndUsesTheCache) {
+    HX first;
+    first.load_from_disk(Name);
+    ASSERT_TRUE(std::filesystem::exists(cache_file()));
+
+    HX second;
+    second.load_from_disk(Name);
+    expect_same(second, first);
+    expect_same(second, compiled());
+    EXPECT_EQ(second.tube_od, 0.75F);
+}
+
+TEST_F(HxCacheTest, MissingCache) {
+    HX hx = with_config();
+    EXPECT_FALSE(load_hx_cache(hx, Name));
+    EXPECT_TRUE(hx.tubes.empty());
+}
+
+TEST_F(HxCacheTest, ChangedCsvInvalidates) {
+    store_hx_cache(compiled(), Name);
+    std::ofstream(HX::hxs_path / Name / "tubesheet.csv") << tubesheet_csv(12, 16);
+
+    HX hx = with_config();
+    EXPECT_FALSE(load_hx_cache(hx, Name));
+    EXPECT_TRUE(hx.tubes.empty());
+
+    HX reloaded;
+    reloaded.load_from_disk(Name);
+    EXPECT_EQ(reloaded.tubes.size(), 12U * 16 * 2);
+}
+
+TEST_F(HxCacheTest, ChangedConfigInvalidates) {
+    store_hx_cache(compiled(), Name);
+    std::string cold_only = Config;
+    cold_only.replace(cold_only.find("both"), 4, "cold");
+    cold_only += "\n"; // A different size too, whatever the resolution of the write times
+    std::ofstream(HX::hxs_path / Name / "config.json") << cold_only;
+
+    HX hx = with_config();
+    EXPECT_FALSE(load_hx_cache(hx, Name));
+
+    HX reloaded;
+    reloaded.load_from_disk(Name);
+    EXPECT_EQ(reloaded.tubes.size(), 12U * 15);
+    EXPECT_FALSE(reloaded.tubes.contains("HL_1"));
+}
+
+TEST_F(HxCacheTest, CorruptCacheIsIgnored) {
+    store_hx_cache(compiled(), Name);
+    auto size = std::filesystem::file_size(cache_file());
+
+    std::filesystem::resize_file(cache_file(), size / 2);
+    HX truncated = with_config();
+    EXPECT_FALSE(load_hx_cache(truncated, Name));
+
+    std::ofstream(cache_file(), std::ios::binary) << std::string(size, 'x');
+    HX garbage = with_config();
+    EXPECT_FALSE(load_hx_cache(garbage, Name));
+
+    HX reloaded;
+    reloaded.load_from_disk(Name);
+    expect_same(reloaded, compiled());
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
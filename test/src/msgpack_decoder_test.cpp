@@ -0,0 +1,131 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#include "msgpack_decoder.hpp"
+#include "telemetry.hpp"
+
+namespace {
+nlohmann::json sample_telemetry() {
+    return {
+        { "coords", { { "x", 1.5 }, { "y", -2.25 }, { "z", 100 } } },
+        { "targets", { { "x", 0 }, { "y", 0 }, { "z", -70000 } } },
+        { "on_condition", { { "x_y", true }, { "z", false } } },
+        { "probe", { { "x_y", false }, { "z", true } } },
+        { "stalled", { { "x", false }, { "y", true }, { "z", false } } },
+        { "limits",
+          { { "left", true },
+            { "right", false },
+            { "up", false },
+            { "down", true },
+            { "in", false },
+            { "out", false },
+            { "probe", true } } },
+        { "control_enabled", true },
+        { "stall_control", false },
+        { "brakes_mode", 2 },
+        { "probe_protected", true },
+    };
+}
+
+template <typename T> T decode(const std::vector<uint8_t> &bytes) {
+    MsgpackReader reader(bytes.data(), bytes.size());
+    T value{};
+    msgpack_decode(reader, value);
+    EXPECT_EQ(reader.remaining(), 0U);
+    return value;
+}
+} // namespace
+
+TEST(MsgpackReaderTest, DecodesLikeFromMsgpack) {
+    std::vector<uint8_t> bytes = nlohmann::json::to_msgpack(sample_telemetry());
+    auto decoded = decode<telemetry>(bytes);
+    auto expected = nlohmann::json::from_msgpack(bytes).get<telemetry>();
+
+    EXPECT_EQ(decoded.coords.x, expected.coords.x);
+    EXPECT_EQ(decoded.coords.y, expected.coords.y);
+    EXPECT_EQ(decoded.coords.z, expected.coords.z);
+    EXPECT_EQ(decoded.targets.z, -70000);
+    EXPECT_TRUE(decoded.on_condition.x_y);
+    EXPECT_TRUE(decoded.probe.z);
+    EXPECT_TRUE(decoded.stalled.y);
+    EXPECT_TRUE(decoded.limits.left);
+    EXPECT_TRUE(decoded.limits.down);
+    EXPECT_TRUE(decoded.limits.probe);
+    EXPECT_FALSE(decoded.limits.out);
+    EXPECT_EQ(decoded.control_enabled, expected.control_enabled);
+    EXPECT_EQ(decoded.stall_control, expected.stall_control);
+    EXPECT_EQ(decoded.brakes_mode, 2);
+    EXPECT_TRUE(decoded.probe_protected);
+}
+
+TEST(MsgpackReaderTest, NumbersOfEveryWidth) {
+    for (double value : { 0.0, 5.0, -3.0, 200.0, -200.0, 70000.0, -70000.0, 5e9, -5e9, 0.5, 1e300 }) {
+        std::vector<uint8_t> bytes = nlohmann::json::to_msgpack(value);
+        MsgpackReader reader(bytes.data(), bytes.size());
+        EXPECT_EQ(reader.read_number(), value);
+    }
+
+    // float32 as some senders use for coordinates
+    std::vector<uint8_t> float32 = { 0xca, 0x3f, 0xc0, 0x00, 0x00 };
+    MsgpackReader reader(float32.data(), float32.size());
+    EXPECT_EQ(reader.read_number(), 1.5);
+
+    std::vector<uint8_t> int64 = nlohmann::json::to_msgpack(std::numeric_limits<int64_t>::min());
+    MsgpackReader int_reader(int64.data(), int64.size());
+    EXPECT_EQ(int_reader.read_integer(), std::numeric_limits<int64_t>::min());
+}
+
+TEST(MsgpackReaderTest, SkipsUnknownKeys) {
+    nlohmann::json point = { { "x", 1 }, { "extra", { 1, "two", { { "three", nullptr } } } }, { "y", 2 }, { "z", 3 } };
+    point["blob"] = nlohmann::json::binary({ 1, 2, 3 });
+    auto decoded = decode<Point3D>(nlohmann::json::to_msgpack(point));
+    EXPECT_EQ(decoded.x, 1);
+    EXPECT_EQ(decoded.y, 2);
+    EXPECT_EQ(decoded.z, 3);
+}
+
+TEST(MsgpackReaderTest, MissingFieldThrows) {
+    nlohmann::json axes = { { "x_y", true } };
+    EXPECT_THROW(decode<compound_axes>(nlohmann::json::to_msgpack(axes)), std::runtime_error);
+
+    nlohmann::json telemetry_without_limits = sample_telemetry();
+    telemetry_without_limits.erase("limits");
+    EXPECT_THROW(decode<telemetry>(nlohmann::json::to_msgpack(telemetry_without_limits)), std::runtime_error);
+}
+
+TEST(MsgpackReaderTest, NilFieldCountsAsMissing) {
+    nlohmann::json axes = { { "x_y", true }, { "z", nullptr } };
+    EXPECT_THROW(decode<compound_axes>(nlohmann::json::to_msgpack(axes)), std::runtime_error);
+
+    // Same as the json decoder, which does not take null for a bool either
+    EXPECT_THROW(nlohmann::json::from_msgpack(nlohmann::json::to_msgpack(axes)).get<compound_axes>(),
+        nlohmann::json::exception);
+}
+
+TEST(MsgpackReaderTest, WrongTypeThrows) {
+    nlohmann::json axes = { { "x_y", true }, { "z", "yes" } };
+    EXPECT_THROW(decode<compound_axes>(nlohmann::json::to_msgpack(axes)), std::runtime_error);
+
+    std::vector<uint8_t> array = nlohmann::json::to_msgpack(nlohmann::json::array({ 1, 2 }));
+    MsgpackReader reader(array.data(), array.size());
+    EXPECT_THROW(reader.read_map_header(), std::runtime_error);
+}
+
+TEST(MsgpackReaderTest, TruncatedInputIsIncomplete) {
+    std::vector<uint8_t> bytes = nlohmann::json::to_msgpack(sample_telemetry());
+    for (size_t size : { size_t(0), size_t(1), bytes.size() / 2, bytes.size() - 1 }) {
+        std::vector<uint8_t> truncated(bytes.begin(), bytes.begin() + static_cast<std::ptrdiff_t>(size));
+        MsgpackReader reader(truncated.data(), truncated.size());
+        telemetry value{};
+        EXPECT_THROW(msgpack_decode(reader, value), MsgpackIncompleteError) << size << " bytes";
+    }
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
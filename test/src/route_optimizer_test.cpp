@@ -0,0 +1,143 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "route_optimizer.hpp"
+
+namespace {
+// Tubesheet-like grid, rows and columns labelled like the CSVs, visited in a shuffled order
+std::vector<RouteStop> grid_stops(int rows, int cols, unsigned seed) {
+    std::vector<RouteStop> stops;
+    for (int row = 0; row < rows; row++) {
+        for (int col = 0; col < cols; col++) {
+            stops.push_back({ Point3D(col * 1.25, row * 1.1, 0), std::to_string(row), std::to_string(col) });
+        }
+    }
+    std::shuffle(stops.begin(), stops.end(), std::mt19937(seed));
+    return stops;
+}
+
+std::vector<RouteStop> random_stops(size_t count, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> coord(-300, 300);
+    std::vector<RouteStop> stops;
+    for (size_t i = 0; i < count; i++) {
+        stops.push_back({ Point3D(coord(rng), coord(rng), 0), "", "" });
+    }
+    return stops;
+}
+
+std::vector<size_t> identity(size_t size) {
+    std::vector<size_t> order(size);
+    std::iota(order.begin(), order.end(), 0);
+    return order;
+}
+
+// Greedy route from the first stop, where the improvement starts from
+double nearest_neighbour_length(const std::vector<RouteStop> &stops) {
+    std::vector<bool> visited(stops.size());
+    size_t current = 0;
+    visited[0] = true;
+    double length = 0;
+    for (size_t step = 1; step < stops.size(); step++) {
+        size_t best = 0;
+        double best_distance = std::numeric_limits<double>::infinity();
+        for (size_t i = 0; i < stops.size(); i++) {
+            if (double d = stops[current].coords.distance_xy(stops[i].coords); !visited[i] && d < best_distance) {
+                best_distance = d;
+                best = i;
+            }
+        }
+        visited[best] = true;
+        length += best_distance;
+        current = best;
+    }
+    return length;
+}
+
+void expect_permutation(std::vector<size_t> order, size_t size) {
+    std::sort(order.begin(), order.end());
+    EXPECT_EQ(order, identity(size));
+}
+} // namespace
+
+TEST(RouteOptimizerTest, RouteLength) {
+    std::vector<RouteStop> stops = { { Point3D(0, 0, 0), "", "" },
+                                     { Point3D(3, 4, 7), "", "" },
+                                     { Point3D(3, 0, 0), "", "" } };
+    EXPECT_DOUBLE_EQ(route_length(stops, { 0, 1, 2 }), 9);
+    EXPECT_DOUBLE_EQ(route_length(stops, { 0, 2, 1 }), 7);
+    EXPECT_DOUBLE_EQ(route_length(stops, { 1 }), 0);
+}
+
+TEST(RouteOptimizerTest, SmallPlansKeepTheirOrder) {
+    for (size_t size : { 0, 1, 2 }) {
+        EXPECT_EQ(optimize_route(random_stops(size, 1)), identity(size));
+    }
+}
+
+TEST(RouteOptimizerTest, ImprovementIsAPermutationNoLongerThanGreedyRoute) {
+    for (unsigned seed = 1; seed <= 5; seed++) {
+        for (size_t size : { 3, 10, 50, 400 }) {
+            std::vector<RouteStop> stops = random_stops(size, seed);
+            std::vector<size_t> order = optimize_route(stops);
+            ASSERT_EQ(order.size(), size);
+            expect_permutation(order, size);
+            EXPECT_LE(route_length(stops, order), nearest_neighbour_length(stops) + 1e-9) << size << " stops";
+        }
+    }
+}
+
+TEST(RouteOptimizerTest, GridIsTravelledWithoutDetours) {
+    std::vector<RouteStop> stops = grid_stops(20, 30, 7);
+    std::vector<size_t> order = optimize_route(stops);
+    expect_permutation(order, stops.size());
+
+    // Every stop has a neighbour 1.1 or 1.25 away: a good route is close to stops x 1.1
+    EXPECT_LT(route_length(stops, order), stops.size() * 1.1 * 1.2);
+    EXPECT_LT(route_length(stops, order), route_length(stops, identity(stops.size())) / 10);
+}
+
+TEST(RouteOptimizerTest, StartsAtTheEndClosestToTheFirstStop) {
+    std::vector<RouteStop> stops = random_stops(100, 3);
+    std::vector<size_t> order = optimize_route(stops);
+    EXPECT_LE(stops[order.front()].coords.distance_xy(stops[0].coords),
+        stops[order.back()].coords.distance_xy(stops[0].coords));
+}
+
+TEST(RouteOptimizerTest, SweepsAreSerpentines) {
+    std::vector<RouteStop> stops = grid_stops(4, 5, 11);
+    for (RouteSweep sweep : { RouteSweep::ROWS, RouteSweep::COLS }) {
+        std::vector<size_t> order = optimize_route(stops, { sweep });
+        expect_permutation(order, stops.size());
+
+        // One line after the other, each one complete before the next starts
+        bool rows = sweep == RouteSweep::ROWS;
+        size_t line_size = rows ? 5 : 4;
+        for (size_t i = 0; i < order.size(); i++) {
+            const RouteStop &stop = stops[order[i]];
+            const RouteStop &first = stops[order[i - i % line_size]];
+            EXPECT_EQ(rows ? stop.row : stop.col, rows ? first.row : first.col);
+        }
+        // Consecutive stops within a line, and between lines, are always neighbours
+        for (size_t i = 1; i < order.size(); i++) {
+            EXPECT_LE(stops[order[i - 1]].coords.distance_xy(stops[order[i]].coords), 1.25 + 1e-9);
+        }
+    }
+}
+
+TEST(RouteOptimizerTest, TimeLimitStillReturnsAPermutation) {
+    std::vector<RouteStop> stops = random_stops(3000, 5);
+    std::vector<size_t> order = optimize_route(stops, { RouteSweep::NONE, std::chrono::milliseconds(0) });
+    expect_permutation(order, stops.size());
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
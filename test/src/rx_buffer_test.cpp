@@ -0,0 +1,84 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "rx_buffer.hpp"
+
+namespace {
+void receive(RxBuffer &buffer, const std::string &bytes) {
+    char *tail = buffer.prepare(bytes.size());
+    bytes.copy(tail, bytes.size());
+    buffer.commit(bytes.size());
+}
+
+std::vector<std::string> frames(RxBuffer &buffer) {
+    std::vector<std::string> res;
+    while (auto frame = buffer.next_frame()) {
+        res.emplace_back(*frame);
+    }
+    return res;
+}
+} // namespace
+
+TEST(RxBufferTest, SplitsDelimitedFrames) {
+    RxBuffer buffer(64);
+    receive(buffer, std::string("{\"a\":1}\0{\"b\":2}\0", 16));
+    EXPECT_EQ(frames(buffer), (std::vector<std::string>{ "{\"a\":1}", "{\"b\":2}" }));
+    EXPECT_EQ(buffer.pending_bytes(), 0U);
+}
+
+TEST(RxBufferTest, KeepsPartialFrameUntilDelimiterArrives) {
+    RxBuffer buffer(64);
+    receive(buffer, "{\"telemetry\":");
+    EXPECT_TRUE(frames(buffer).empty());
+    receive(buffer, "42}");
+    EXPECT_TRUE(frames(buffer).empty());
+    receive(buffer, std::string("\0{\"next\"", 8));
+    EXPECT_EQ(frames(buffer), (std::vector<std::string>{ "{\"telemetry\":42}" }));
+    EXPECT_EQ(buffer.pending(), "{\"next\"");
+}
+
+TEST(RxBufferTest, EmptyFrames) {
+    RxBuffer buffer(16);
+    receive(buffer, std::string("\0\0x\0", 4));
+    EXPECT_EQ(frames(buffer), (std::vector<std::string>{ "", "", "x" }));
+}
+
+TEST(RxBufferTest, CompactsBeforeGrowing) {
+    RxBuffer buffer(16);
+    receive(buffer, std::string("0123456789\0abc", 14));
+    EXPECT_EQ(frames(buffer), (std::vector<std::string>{ "0123456789" }));
+
+    // The consumed frame makes room for the new bytes, the partial one moves to the head
+    receive(buffer, std::string("defghij\0", 8));
+    EXPECT_EQ(buffer.capacity(), 16U);
+    EXPECT_EQ(frames(buffer), (std::vector<std::string>{ "abcdefghij" }));
+}
+
+TEST(RxBufferTest, GrowsForFramesLargerThanCapacity) {
+    RxBuffer buffer(8);
+    std::string large(100, 'x');
+    for (size_t i = 0; i < large.size(); i += 10) {
+        receive(buffer, large.substr(i, 10));
+        EXPECT_TRUE(frames(buffer).empty());
+    }
+    receive(buffer, std::string(1, '\0'));
+    EXPECT_GE(buffer.capacity(), large.size() + 1);
+    EXPECT_EQ(frames(buffer), (std::vector<std::string>{ large }));
+}
+
+TEST(RxBufferTest, CustomDelimiterAndConsume) {
+    RxBuffer buffer(32, '\n');
+    receive(buffer, "line 1\nline 2\npartial");
+    EXPECT_EQ(frames(buffer), (std::vector<std::string>{ "line 1", "line 2" }));
+    buffer.consume(4);
+    EXPECT_EQ(buffer.pending(), "ial");
+    buffer.clear();
+    EXPECT_EQ(buffer.pending_bytes(), 0U);
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,158 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <thread>
+
+#include "telemetry_stream.hpp"
+
+using namespace std::chrono_literals;
+
+namespace {
+nlohmann::json sample_telemetry() {
+    return {
+        { "coords", { { "x", 1.5 }, { "y", -2.25 }, { "z", 100 } } },
+        { "limits", { { "left", false }, { "right", false }, { "probe", true } } },
+        { "control_enabled", true },
+        { "brakes_mode", 2 },
+    };
+}
+
+// What a client does with the stream: keyframes replace its copy, deltas are applied as merge patches
+class Client {
+  public:
+    void receive(const nlohmann::json &message) {
+        if (message.contains("TELEMETRY")) {
+            telemetry = message["TELEMETRY"];
+            keyframes++;
+        }
+        if (message.contains("TELEMETRY_DELTA")) {
+            telemetry.merge_patch(message["TELEMETRY_DELTA"]);
+            deltas++;
+        }
+    }
+
+    nlohmann::json telemetry;
+    int keyframes = 0;
+    int deltas = 0;
+};
+} // namespace
+
+TEST(JsonMergeDiffTest, OnlyChangedMembers) {
+    nlohmann::json from = sample_telemetry();
+    nlohmann::json to = from;
+    to["coords"]["x"] = 2;
+    to["brakes_mode"] = 0;
+
+    nlohmann::json patch = json_merge_diff(from, to);
+    EXPECT_EQ(patch, (nlohmann::json{ { "coords", { { "x", 2 } } }, { "brakes_mode", 0 } }));
+    EXPECT_TRUE(json_merge_diff(to, to).empty());
+}
+
+TEST(JsonMergeDiffTest, RemovedMembersAreNull) {
+    nlohmann::json from = sample_telemetry();
+    nlohmann::json to = from;
+    to["limits"].erase("probe");
+    to.erase("control_enabled");
+
+    nlohmann::json patch = json_merge_diff(from, to);
+    EXPECT_EQ(patch, (nlohmann::json{ { "limits", { { "probe", nullptr } } }, { "control_enabled", nullptr } }));
+}
+
+TEST(JsonMergeDiffTest, RoundTrip) {
+    nlohmann::json from = sample_telemetry();
+    std::vector<nlohmann::json> targets;
+
+    nlohmann::json moved = from;
+    moved["coords"] = { { "x", 3 }, { "y", 4 }, { "z", 5 } };
+    targets.push_back(moved);
+
+    nlohmann::json reshaped = from;
+    reshaped["limits"] = 7;                           // Object replaced by a value
+    reshaped["coords"]["extra"] = { { "deep", 1 } }; // New nested object
+    reshaped["list"] = { 1, 2, 3 };                  // Arrays are replaced whole
+    targets.push_back(reshaped);
+
+    nlohmann::json shortened = reshaped;
+    shortened["list"] = { 1 };
+    shortened["limits"] = { { "left", true } }; // Value replaced by an object
+    targets.push_back(shortened);
+
+    targets.push_back(nlohmann::json::object());
+
+    for (const auto &to : targets) {
+        nlohmann::json patched = from;
+        patched.merge_patch(json_merge_diff(from, to));
+        EXPECT_EQ(patched, to);
+        from = to;
+    }
+}
+
+TEST(TelemetryDeltaEncoderTest, KeyframeThenDeltas) {
+    TelemetryDeltaEncoder encoder(1h);
+    Client client;
+    nlohmann::json telemetry = sample_telemetry();
+
+    for (int i = 0; i < 20; i++) {
+        telemetry["coords"]["x"] = i * 0.5;
+        if (i % 3 == 0) {
+            telemetry["limits"]["left"] = !telemetry["limits"]["left"].get<bool>();
+        }
+        if (i == 10) {
+            telemetry.erase("brakes_mode");
+        }
+
+        nlohmann::json message;
+        encoder.encode(message, telemetry);
+        client.receive(message);
+        EXPECT_EQ(client.telemetry, telemetry) << "message " << i;
+    }
+    EXPECT_EQ(client.keyframes, 1);
+    EXPECT_EQ(client.deltas, 19);
+}
+
+TEST(TelemetryDeltaEncoderTest, NothingSentWhenNothingChanged) {
+    TelemetryDeltaEncoder encoder(1h);
+    nlohmann::json message;
+    encoder.encode(message, sample_telemetry());
+    EXPECT_TRUE(message.contains("TELEMETRY"));
+
+    message = nlohmann::json::object();
+    encoder.encode(message, sample_telemetry());
+    EXPECT_TRUE(message.empty());
+}
+
+TEST(TelemetryDeltaEncoderTest, RequestedKeyframe) {
+    TelemetryDeltaEncoder encoder(1h);
+    nlohmann::json message;
+    encoder.encode(message, sample_telemetry());
+
+    encoder.request_keyframe();
+    message = nlohmann::json::object();
+    encoder.encode(message, sample_telemetry());
+    EXPECT_EQ(message, (nlohmann::json{ { "TELEMETRY", sample_telemetry() } }));
+}
+
+TEST(TelemetryDeltaEncoderTest, PeriodicKeyframes) {
+    TelemetryDeltaEncoder encoder(20ms);
+    Client client;
+    nlohmann::json telemetry = sample_telemetry();
+
+    nlohmann::json message;
+    encoder.encode(message, telemetry);
+    client.receive(message);
+
+    std::this_thread::sleep_for(30ms);
+    telemetry["brakes_mode"] = 1;
+    message = nlohmann::json::object();
+    encoder.encode(message, telemetry);
+    EXPECT_TRUE(message.contains("TELEMETRY"));
+    EXPECT_FALSE(message.contains("TELEMETRY_DELTA"));
+    client.receive(message);
+    EXPECT_EQ(client.telemetry, telemetry);
+    EXPECT_EQ(client.keyframes, 2);
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,167 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "tube_index.hpp"
+
+namespace {
+// Staggered tubesheet with a few tubes on the same X or Y, as split planes meet them
+TubeTable tubesheet(int rows, int cols) {
+    TubeTable tubes;
+    for (int row = 0; row < rows; row++) {
+        for (int col = 0; col < cols; col++) {
+            double x = col * 1.25 + (row % 2) * 0.625;
+            double y = row * 1.08;
+            tubes.add("CL_" + std::to_string(row * cols + col), std::to_string(col), std::to_string(row),
+                { x, y, 0 });
+        }
+    }
+    return tubes;
+}
+
+TubeIndex make_index(const TubeTable &tubes) {
+    TubeIndex::Key key;
+    key.hx_dir = "test";
+    key.tubes = tubes.size();
+    return TubeIndex(key, tubes);
+}
+
+double distance_xy(const TubeTable &tubes, TubeTable::TubeId tube, const Point3D &point) {
+    return std::hypot(tubes.x()[tube] - point.x, tubes.y()[tube] - point.y);
+}
+
+std::set<std::string> ids(const std::vector<TubeIndex::Hit> &hits) {
+    std::set<std::string> res;
+    for (const auto &hit : hits) {
+        res.insert(hit.tube_id);
+    }
+    return res;
+}
+
+std::vector<Point3D> random_points(size_t count, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> x(-5, 45), y(-5, 35);
+    std::vector<Point3D> points;
+    for (size_t i = 0; i < count; i++) {
+        points.emplace_back(x(rng), y(rng), 0);
+    }
+    return points;
+}
+} // namespace
+
+TEST(TubeIndexTest, EmptyIndex) {
+    TubeIndex index = make_index({});
+    EXPECT_FALSE(index.nearest(Point3D(0, 0, 0)));
+    EXPECT_TRUE(index.within_radius(Point3D(0, 0, 0), 10).empty());
+    EXPECT_TRUE(index.within_box(Point3D(-10, -10, 0), Point3D(10, 10, 0)).empty());
+}
+
+TEST(TubeIndexTest, NearestMatchesBruteForce) {
+    TubeTable tubes = tubesheet(30, 32);
+    TubeIndex index = make_index(tubes);
+    ASSERT_EQ(index.size(), tubes.size());
+
+    for (const Point3D &point : random_points(500, 1)) {
+        double best = std::numeric_limits<double>::infinity();
+        for (TubeTable::TubeId tube = 0; tube < tubes.size(); tube++) {
+            best = std::min(best, distance_xy(tubes, tube, point));
+        }
+
+        auto hit = index.nearest(point);
+        ASSERT_TRUE(hit);
+        EXPECT_DOUBLE_EQ(hit->distance, best); // Ties may return either tube, at the same distance
+        auto tube = tubes.find(hit->tube_id);
+        ASSERT_TRUE(tube);
+        EXPECT_DOUBLE_EQ(distance_xy(tubes, *tube, point), best);
+        EXPECT_EQ(hit->coords.x, tubes.coords(*tube).x);
+        EXPECT_EQ(hit->coords.y, tubes.coords(*tube).y);
+    }
+}
+
+TEST(TubeIndexTest, NearestOnATubeIsThatTube) {
+    TubeTable tubes = tubesheet(10, 10);
+    TubeIndex index = make_index(tubes);
+    for (TubeTable::TubeId tube = 0; tube < tubes.size(); tube++) {
+        auto hit = index.nearest(tubes.coords(tube));
+        ASSERT_TRUE(hit);
+        EXPECT_EQ(hit->tube_id, tubes.id(tube));
+        EXPECT_EQ(hit->distance, 0);
+    }
+}
+
+TEST(TubeIndexTest, WithinRadiusMatchesBruteForce) {
+    TubeTable tubes = tubesheet(30, 32);
+    TubeIndex index = make_index(tubes);
+
+    for (double radius : { 0.3, 0.7, 1.25, 4.0 }) {
+        for (const Point3D &point : random_points(100, 2)) {
+            std::set<std::string> expected;
+            for (TubeTable::TubeId tube = 0; tube < tubes.size(); tube++) {
+                if (distance_xy(tubes, tube, point) <= radius) {
+                    expected.insert(tubes.id(tube));
+                }
+            }
+
+            auto hits = index.within_radius(point, radius);
+            EXPECT_EQ(ids(hits), expected);
+            EXPECT_TRUE(std::is_sorted(hits.begin(), hits.end(),
+                [](const TubeIndex::Hit &a, const TubeIndex::Hit &b) { return a.distance < b.distance; }));
+        }
+    }
+}
+
+TEST(TubeIndexTest, WithinBoxMatchesBruteForce) {
+    TubeTable tubes = tubesheet(30, 32);
+    TubeIndex index = make_index(tubes);
+
+    std::vector<Point3D> corners = random_points(200, 3);
+    for (size_t i = 0; i + 1 < corners.size(); i += 2) {
+        // Corners in any order, the box is the same
+        const Point3D &a = corners[i];
+        const Point3D &b = corners[i + 1];
+        std::set<std::string> expected;
+        for (TubeTable::TubeId tube = 0; tube < tubes.size(); tube++) {
+            double x = tubes.x()[tube];
+            double y = tubes.y()[tube];
+            if (x >= std::min(a.x, b.x) && x <= std::max(a.x, b.x) && y >= std::min(a.y, b.y) &&
+                y <= std::max(a.y, b.y)) {
+                expected.insert(tubes.id(tube));
+            }
+        }
+        EXPECT_EQ(ids(index.within_box(a, b)), expected);
+        EXPECT_EQ(ids(index.within_box(b, a)), expected);
+    }
+}
+
+TEST(TubeIndexTest, BoxEdgesAreInclusive) {
+    TubeTable tubes = tubesheet(4, 4);
+    TubeIndex index = make_index(tubes);
+    auto hits = index.within_box(tubes.coords(0), tubes.coords(*tubes.find("CL_15")));
+    EXPECT_TRUE(ids(hits).contains("CL_0"));
+    EXPECT_TRUE(ids(hits).contains("CL_15"));
+}
+
+TEST(TubeIndexTest, KeyTellsWhenTheIndexIsStale) {
+    TubeIndex::Key key{ "hx", 10, false };
+    TubeIndex::Key other = key;
+    other.transformation(0, 3) = 5; // Ignored while not aligned
+    EXPECT_EQ(key, other);
+
+    key.aligned = other.aligned = true;
+    EXPECT_FALSE(key == other);
+
+    other = key;
+    other.tubes = 11;
+    EXPECT_FALSE(key == other);
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}